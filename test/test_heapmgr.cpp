@@ -1,7 +1,12 @@
 #include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstring>
 #include <pthread.h>
 #include <unistd.h>
 #include "../vm/heapmgr/HeapMgr.h"
+#include "../vm/config.h"
 
 /*
  * Author: kayo
@@ -13,7 +18,7 @@ void initJVM(int argc, char* argv[]);
 
 void test_get_and_back()
 {
-    HeapMgr mgr;
+    HeapMgr mgr(VM_HEAP_SIZE);
 
     cout << mgr.toString().c_str() << endl;
 
@@ -35,7 +40,7 @@ void *thread_func(void *arg)
     auto hm = (HeapMgr *) arg;
     for (int k = 0; k < 1000; k++) {
         void *p = hm->get(10);
-        sleep(3);
+        usleep(3);
         hm->back(p, 10);
     }
     return nullptr;
@@ -46,25 +51,184 @@ void *thread_func(void *arg)
  */
 void test_multi_access()
 {
-    HeapMgr mgr;
+    HeapMgr mgr(VM_HEAP_SIZE);
 
-    for (int i = 0; i < 100; i++) {
-        pthread_t tid;
+    pthread_t tids[100];
+    for (auto &tid : tids) {
         pthread_create(&tid, nullptr, thread_func, &mgr);
     }
+    for (auto &tid : tids) {
+        pthread_join(tid, nullptr);
+    }
+    cout << mgr.toString().c_str() << endl;
+}
+
+void test_heap_exhausted()
+{
+    HeapMgr mgr(VM_HEAP_SIZE);
+
+    size_t count = 0;
+    while (mgr.get(10240) != nullptr) {
+        count++;
+    }
+    cout << "heap exhausted after " << count << " gets." << endl;
 }
 
-void test_stack_overflow_error()
+/*
+ * 测试按需提交和归还内存
+ */
+void test_expand_and_shrink()
 {
-    HeapMgr mgr;
+    HeapMgr mgr(4*1024*1024, 32*1024*1024);
+
+    vector<void *> v;
+    void *p;
+    while ((p = mgr.get(10240)) != nullptr || (mgr.expand(10240) && (p = mgr.get(10240)) != nullptr)) {
+        v.push_back(p);
+    }
+    cout << "heap exhausted after " << v.size() << " gets, committed " << mgr.capacity() << " bytes." << endl;
+
+    for (void *q : v)
+        mgr.back(q, 10240);
+    mgr.shrink(0);
+    cout << "shrunk to " << mgr.capacity() << " bytes, free " << mgr.freeBytes << " bytes." << endl;
+}
+
+/*
+ * 原来的 first-fit 单链表实现，留作 benchmark 的对照。
+ */
+class FirstFitHeapMgr {
+    struct Node {
+        uintptr_t head;
+        size_t len;
+        Node *next;
+        Node(uintptr_t head, size_t len, Node *next): head(head), len(len), next(next) { }
+    } *freelist;
+
+    void *heap;
+
+public:
+    explicit FirstFitHeapMgr(size_t size)
+    {
+        heap = malloc(size);
+        freelist = new Node((uintptr_t) heap, size, nullptr);
+    }
+
+    ~FirstFitHeapMgr()
+    {
+        for (auto p = freelist; p != nullptr;) {
+            auto t = p->next;
+            delete p;
+            p = t;
+        }
+        free(heap);
+    }
 
-    while (true) {
-        void *p = mgr.get(10240);
-        if (p == nullptr) {
-            cout << "never goes here." << endl;
-            return;
+    void *get(size_t len)
+    {
+        Node *prev = nullptr;
+        for (Node *curr = freelist; curr != nullptr; prev = curr, curr = curr->next) {
+            if (curr->len == len) {
+                if (prev != nullptr)
+                    prev->next = curr->next;
+                else
+                    freelist = curr->next;
+                auto t = (void *) curr->head;
+                delete curr;
+                memset(t, 0, len);
+                return t;
+            }
+            if (curr->len > len) {
+                auto t = (void *) (curr->head);
+                curr->head += len;
+                curr->len -= len;
+                memset(t, 0, len);
+                return t;
+            }
         }
+        return nullptr;
     }
+
+    void back(void *p, size_t len)
+    {
+        auto mem = (uintptr_t) p;
+        Node *prev = nullptr;
+        Node *curr = freelist;
+        for (; curr != nullptr && mem > curr->head; prev = curr, curr = curr->next);
+
+        bool leftJoin = prev != nullptr && prev->head + prev->len == mem;
+        bool rightJoin = curr != nullptr && mem + len == curr->head;
+        if (leftJoin && rightJoin) {
+            prev->len += len + curr->len;
+            prev->next = curr->next;
+            delete curr;
+        } else if (leftJoin) {
+            prev->len += len;
+        } else if (rightJoin) {
+            curr->head = mem;
+            curr->len += len;
+        } else if (prev == nullptr) {
+            freelist = new Node(mem, len, curr);
+        } else {
+            prev->next = new Node(mem, len, curr);
+        }
+    }
+};
+
+/*
+ * 碎片化负载：维持 LIVE_COUNT 个存活对象，每次随机释放一个再分配一个新的，
+ * 尺寸 90% 为 16~256 字节的小对象，10% 为 1K~16K 的大对象。
+ */
+template <typename Mgr>
+double bench_fragmented(Mgr &mgr, const char *name)
+{
+    const int LIVE_COUNT = 20000;
+    const int ROUNDS = 50000;
+
+    mt19937 rand(12345);
+    auto next_size = [&rand]() -> size_t {
+        if (rand() % 10 != 0)
+            return (16 + rand() % 241 + 7) & ~(size_t) 7;
+        return (1024 + rand() % (15 * 1024) + 7) & ~(size_t) 7;
+    };
+
+    vector<pair<void *, size_t>> live(LIVE_COUNT, make_pair(nullptr, 0));
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) {
+        auto &slot = live[rand() % LIVE_COUNT];
+        if (slot.first != nullptr)
+            mgr.back(slot.first, slot.second);
+        slot.second = next_size();
+        slot.first = mgr.get(slot.second);
+        if (slot.first == nullptr) {
+            cout << name << ": out of memory at round " << i << endl;
+            break;
+        }
+    }
+    for (auto &slot : live) {
+        if (slot.first != nullptr)
+            mgr.back(slot.first, slot.second);
+    }
+    auto end = chrono::steady_clock::now();
+
+    double ms = chrono::duration<double, milli>(end - start).count();
+    cout << name << ": " << ROUNDS << " get/back rounds in " << ms << " ms" << endl;
+    return ms;
+}
+
+void bench_first_fit_vs_segregated()
+{
+    const size_t HEAP_SIZE = 64*1024*1024;
+
+    FirstFitHeapMgr firstFit(HEAP_SIZE);
+    double t1 = bench_fragmented(firstFit, "first-fit freelist");
+
+    HeapMgr segregated(HEAP_SIZE);
+    double t2 = bench_fragmented(segregated, "segregated size classes");
+
+    cout << "speedup: " << t1 / t2 << "x" << endl;
+    cout << segregated.toString() << endl;
 }
 
 int main()
@@ -76,7 +240,11 @@ int main()
     //test_get_and_back();
 
     cout << "------------------------------------------------------" << endl;
-    //test_stack_overflow_error();
+    //test_heap_exhausted();
+    test_expand_and_shrink();
+
+    cout << "------------------------------------------------------" << endl;
+    bench_first_fit_vs_segregated();
 
     return 0;
 }
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <ctime>
 #include <climits>
+#include <cstdint>
 
 /*
  * 测试 top of stack cache
@@ -53,8 +54,181 @@ void test()
          << ", assembly :" << time4 - time3 << endl;
 }
 
+/*
+ * 用一个小的解释器比较操作数栈的三种实现，指令和 exec 中的一样是直接线索化的，执行的是
+ *     for (int i = 0; i < n; i++) sum += i;
+ * 1. frame: 每条指令都通过栈桢读写内存中的 pc 和栈顶指针（exec 原来的做法）；
+ * 2. register: pc, sp, locals 放在局部变量（寄存器）中，现在 exec 的做法；
+ * 3. tos: 在 2 的基础上，栈顶的值也缓存在寄存器中，其余的值在内存中。
+ *    栈底之下多留一个 slot，栈为空时缓存的无效值写到这里，压栈时就不必判断栈是否为空。
+ * sum 会超出 int 的范围，局部变量和操作数栈都用 64 位的 slot_t，避免有符号整数溢出（未定义行为）。
+ */
+typedef int64_t slot_t;
+
+union Cell {
+    void *handler;
+    intptr_t i;
+    Cell *target;
+};
+
+struct Frame {
+    slot_t *volatile stack;
+    Cell *volatile pc;
+    slot_t *locals;
+};
+
+enum { ILOAD, IADD, ISTORE, IINC, IF_ICMPLT, RETURN };
+
+// 翻译后的线索码，locals: 0 是 i, 1 是 sum, 2 是 n
+static void translate(Cell *code, void *const *handlers)
+{
+    int i = 0;
+    auto op = [&](int opcode) { code[i++].handler = handlers[opcode]; };
+    auto arg = [&](intptr_t v) { code[i++].i = v; };
+
+    op(ILOAD); arg(1);
+    op(ILOAD); arg(0);
+    op(IADD);
+    op(ISTORE); arg(1);
+    op(IINC); arg(0); arg(1);
+    op(ILOAD); arg(0);
+    op(ILOAD); arg(2);
+    op(IF_ICMPLT); code[i++].target = code;
+    op(RETURN);
+}
+
+static slot_t run_frame(int n)
+{
+    static void *handlers[] = { &&iload, &&iadd, &&istore, &&iinc, &&if_icmplt, &&ret };
+    Cell code[20];
+    translate(code, handlers);
+    slot_t locals[3] = { 0, 0, n };
+    slot_t stack[4];
+    Frame frame = { stack, code, locals };
+    Frame *f = &frame;
+
+#define F_DISPATCH { Cell *c = f->pc; f->pc = c + 1; goto *c->handler; }
+#define F_OPERAND() ({ Cell *c = f->pc; f->pc = c + 1; c->i; })
+    F_DISPATCH
+iload:
+    *f->stack = f->locals[F_OPERAND()];
+    f->stack = f->stack + 1;
+    F_DISPATCH
+iadd:
+    f->stack = f->stack - 1;
+    f->stack[-1] += *f->stack;
+    F_DISPATCH
+istore:
+    f->stack = f->stack - 1;
+    f->locals[F_OPERAND()] = *f->stack;
+    F_DISPATCH
+iinc:
+    f->locals[f->pc[0].i] += f->pc[1].i;
+    f->pc = f->pc + 2;
+    F_DISPATCH
+if_icmplt:
+    f->stack = f->stack - 2;
+    if (f->stack[0] < f->stack[1])
+        f->pc = f->pc->target;
+    else
+        f->pc = f->pc + 1;
+    F_DISPATCH
+ret:
+    return locals[1];
+}
+
+static slot_t run_register(int n)
+{
+    static void *handlers[] = { &&iload, &&iadd, &&istore, &&iinc, &&if_icmplt, &&ret };
+    Cell code[20];
+    translate(code, handlers);
+    slot_t locals_[3] = { 0, 0, n };
+    slot_t stack[4];
+    Cell *ip = code;
+    slot_t *sp = stack;
+    slot_t *locals = locals_;
+
+#define R_DISPATCH goto *(ip++)->handler;
+    R_DISPATCH
+iload:
+    *sp++ = locals[(ip++)->i];
+    R_DISPATCH
+iadd:
+    sp--;
+    sp[-1] += *sp;
+    R_DISPATCH
+istore:
+    locals[(ip++)->i] = *--sp;
+    R_DISPATCH
+iinc:
+    locals[ip[0].i] += ip[1].i;
+    ip += 2;
+    R_DISPATCH
+if_icmplt:
+    sp -= 2;
+    ip = sp[0] < sp[1] ? ip->target : ip + 1;
+    R_DISPATCH
+ret:
+    return locals[1];
+}
+
+static slot_t run_tos(int n)
+{
+    static void *handlers[] = { &&iload, &&iadd, &&istore, &&iinc, &&if_icmplt, &&ret };
+    Cell code[20];
+    translate(code, handlers);
+    slot_t locals_[3] = { 0, 0, n };
+    slot_t stack[5];
+    Cell *ip = code;
+    slot_t *sp = stack; // 栈为空，stack[0] 是栈底之下的 slot
+    slot_t *locals = locals_;
+    slot_t tos = 0;
+
+    R_DISPATCH
+iload:
+    *sp++ = tos;
+    tos = locals[(ip++)->i];
+    R_DISPATCH
+iadd:
+    tos += *--sp;
+    R_DISPATCH
+istore:
+    locals[(ip++)->i] = tos;
+    tos = *--sp;
+    R_DISPATCH
+iinc:
+    locals[ip[0].i] += ip[1].i;
+    ip += 2;
+    R_DISPATCH
+if_icmplt: {
+    slot_t v1 = *--sp;
+    slot_t v2 = tos;
+    tos = *--sp;
+    ip = v1 < v2 ? ip->target : ip + 1;
+    R_DISPATCH
+}
+ret:
+    return locals[1];
+}
+
+void test_interpreter()
+{
+    const int n = 200000000;
+    const char *names[] = { "frame", "register", "tos" };
+    slot_t (*runs[])(int) = { run_frame, run_register, run_tos };
+
+    for (int i = 0; i < 3; i++) {
+        clock_t start = clock();
+        slot_t sum = runs[i](n);
+        clock_t end = clock();
+        cout << names[i] << ": " << (end - start) * 1000 / CLOCKS_PER_SEC << " ms"
+             << " (sum = " << sum << ")" << endl;
+    }
+}
+
 int main()
 {
+    test_interpreter();
     test();
     return 0;
 }
@@ -0,0 +1,57 @@
+package array;
+
+public class ArrayStoreTest {
+
+    public static void main(String[] args) {
+        // 多维数组的元素是数组
+        int[][] a1 = new int[3][];
+        a1[0] = new int[5]; // aastore
+        int[][] a2 = new int[][]{{1}, {2}};
+        Object[] a3 = new int[2][3];
+        a3[1] = new int[4];
+        long[][][] a4 = new long[2][][];
+        a4[0] = new long[3][];
+        a4[0][1] = new long[7];
+
+        // 协变
+        Object[] a5 = new String[2];
+        a5[0] = "abc";
+        Object[][] a6 = new String[2][];
+        a6[1] = new String[]{"x", "y"};
+        Object[] a7 = new Object[2][];
+        a7[0] = new String[1];
+        Cloneable[] a8 = new int[1][];
+        a8[0] = new int[2];
+
+        System.out.println(a1[0].length == 5 && a2[1][0] == 2 && ((int[]) a3[1]).length == 4
+                && a4[0][1].length == 7 && a5[0] == "abc" && a6[1][1] == "y" && a7[0] != null && a8[0] != null);
+
+        // 子类型检查与 aastore 使用同样的判断
+        Object o1 = new int[1][];
+        Object o2 = new String[1];
+        System.out.println(o1 instanceof Object[]);        // true
+        System.out.println(o1 instanceof int[][]);         // true
+        System.out.println(o1 instanceof long[][]);        // false
+        System.out.println(o1 instanceof Object[][]);      // false
+        System.out.println(o2 instanceof Object[][]);      // false
+        System.out.println(new int[1] instanceof Object[]); // false
+
+        // 以下的存入都应抛出 ArrayStoreException
+        storeFail(new String[1], new Object());
+        storeFail(new int[1][], new long[1]);
+        storeFail(new int[1][], new int[1][]);
+        storeFail(new Object[1][], "abc");
+        storeFail(new String[1][], new Object[1]);
+        System.out.println("OK!");
+    }
+
+    private static void storeFail(Object[] arr, Object value) {
+        try {
+            arr[0] = value;
+            System.out.println("store of " + value.getClass().getName()
+                    + " into " + arr.getClass().getName() + " failed!");
+        } catch (ArrayStoreException e) {
+            // expected
+        }
+    }
+}
@@ -5,7 +5,61 @@
 #ifndef JVM_CONFIG_H
 #define JVM_CONFIG_H
 
+// 老年代初始提交的大小和最大的大小，可以通过 -Xms 和 -Xmx 选项修改
 #define VM_HEAP_SIZE  (64*1024*1024) // 64Mb
+#define VM_HEAP_MAX_SIZE (256*1024*1024) // 256Mb
+// 老年代空间不够时每次至少扩展这么多
+#define VM_HEAP_EXPAND_SIZE (8*1024*1024) // 8Mb
+// GC 之后老年代的空闲空间超过此百分比时，归还末尾未使用的内存
+#define VM_HEAP_MAX_FREE_RATIO 70
+
+// thread local allocation buffer
+#define VM_TLAB_SIZE  (32*1024)      // 32Kb
+// 大于此值的对象不在 TLAB 中分配
+#define VM_TLAB_MAX_OBJ_SIZE (VM_TLAB_SIZE/8)
+
+// 新生代的默认大小，可以通过 -Xmn 选项修改
+#define VM_NURSERY_SIZE (8*1024*1024) // 8Mb
+// 对象经历这么多次 minor GC 后晋升到老年代
+#define VM_TENURE_AGE 2
+// 类对象中为 java/lang/Class 的实例变量预留的 slot 数
+#define VM_CLASS_MIRROR_SLOTS 16
+
+// 不小于此大小的基本类型数组在大对象空间中分配
+#define VM_LARGE_OBJECT_SIZE (64*1024) // 64Kb
+// 老年代的占用率达到此百分比时开始并发标记
+#define VM_CONCURRENT_GC_OCCUPANCY 70
+// full GC 后最大的空闲块小于全部空闲空间的 (100 - 此值)% 时整理老年代，为 100 时只在大对象分配失败时整理
+#define VM_COMPACT_FRAGMENTATION 50
+// 没有指定 -XX:ParallelGCThreads 时，并行标记的线程数为 CPU 的个数，但不超过此值
+#define VM_MAX_PARALLEL_GC_THREADS 8
+
+// invokevirtual 和 invokeinterface 的内联缓存最多缓存的接收者类型数，超过后调用点成为 megamorphic
+#define VM_INLINE_CACHE_SIZE 4
+
+// 子类型检查的主父类显示表（display）的大小，继承深度不小于此值的类按次父类检查，见 Class::superDisplay
+#define VM_PRIMARY_SUPERS_DISPLAY 8
+
+// 类实现的接口超过这个数目时，为其 itable 建立哈希表，见 Class::ITable
+#define VM_ITABLE_HASH_THRESHOLD 8
+
+// lookupswitch 的 key 的范围不超过 key 的个数的此倍数时，翻译为直接索引的 tableswitch，见 ThreadedCode
+#define VM_LOOKUPSWITCH_DENSITY 2
+
+// -XX:+PrintHotMethods 打印的方法个数
+#define VM_PRINT_HOT_METHODS_TOP 20
+
+// 方法解释执行的调用次数和向后跳转的次数之和达到此值时由 JIT 编译，见 jit.h
+#define VM_JIT_THRESHOLD 10000
+// 字节码长于此值的方法不编译
+#define VM_JIT_MAX_CODE_LENGTH 8000
+// 存放编译后的代码的代码缓存的大小
+#define VM_CODE_CACHE_SIZE (4*1024*1024) // 4Mb
+// 代码缓存的占用率达到此百分比时，GC 暂停期间回收最近没有执行过的方法的代码
+#define VM_CODE_CACHE_SWEEP_OCCUPANCY 75
+
+// PROFILE_NGRAMS 打开时，每种长度打印执行最多的指令序列的个数，见 debug.h
+#define VM_PROFILE_NGRAMS_TOP 30
 
 // every thread has a vm stack
 #define VM_STACK_SIZE (64*1024)      // 64Kb
@@ -15,4 +15,10 @@
 
 #define PRINT_TRACE printvm
 
+/*
+ * 统计解释器顺序执行的指令序列（n-gram），虚拟机退出时打印执行最多的，用于挑选超级指令（见 interpreter.h）。
+ * 打开后每次分派都要计数，并且不再生成超级指令，只用于离线分析。
+ */
+#define PROFILE_NGRAMS 0
+
 #endif //JVM_DEBUG_H
@@ -11,7 +11,7 @@
 
 #define EXCEPTION_EXIT (-1)
 
-[[noreturn]] void raiseException(const char *exceptionName, const char *msg)
+Object *newException(const char *exceptionName, const char *msg)
 {
     assert(exceptionName != nullptr);
     Class *c = bootClassLoader->loadClass(exceptionName);
@@ -23,10 +23,21 @@
     } else {
         execJavaFunc(c->getConstructor("(Ljava/lang/String;)V"), { (slot_t) o, (slot_t) StringObject::newInst(msg) });
     }
+    return o;
+}
+
+[[noreturn]] void raiseException(Object *exception)
+{
+    assert(exception != nullptr);
 
     // public void printStackTrace()
-    auto printStackTrace = c->lookupInstMethod("printStackTrace", "()V");
-    execJavaFunc(printStackTrace, o);
+    auto printStackTrace = exception->clazz->lookupInstMethod("printStackTrace", "()V");
+    execJavaFunc(printStackTrace, exception);
 
     exit(EXCEPTION_EXIT);
 }
+
+[[noreturn]] void raiseException(const char *exceptionName, const char *msg)
+{
+    raiseException(newException(exceptionName, msg));
+}
@@ -60,10 +60,16 @@
 #define CLASS_FORMAT_ERROR "java/lang/ClassFormatError"
 
 #define INDEX_OUT_OF_BOUNDS_EXCEPTION "java/lang/IndexOutOfBoundsException"
+#define ARRAY_STORE_EXCEPTION "java/lang/ArrayStoreException"
 #define CLONE_NOT_SUPPORTED_EXCEPTION "java/lang/CloneNotSupportedException"
 #define CLASS_NOT_FOUND_EXCEPTION "java/lang/ClassNotFoundException"
 
+class Object;
 
+// 创建异常 @exceptionName 的实例，@msg 为 nullptr 时调用无参数的构造函数
+Object *newException(const char *exceptionName, const char *msg = nullptr);
+
+[[noreturn]] void raiseException(Object *exception);
 [[noreturn]] void raiseException(const char *exceptionName, const char *msg = nullptr);
 
 #endif //KAYOVM_THROWABLES_H
@@ -0,0 +1,49 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_CARDTABLE_H
+#define KAYOVM_CARDTABLE_H
+
+#include <cstddef>
+#include <cstring>
+#include "../jtypes.h"
+
+/*
+ * 卡表（card table），记录老年代中哪些对象可能引用了新生代的对象。
+ *
+ * 老年代（HeapMgr 的堆）按 CARD_SIZE 字节分为一张张卡，每张卡用一个字节表示。
+ * 向老年代的对象中写入新生代对象的引用时（write_barrier），把对象头所在的卡标记为脏，
+ * minor GC 时只需扫描起始于脏卡中的对象，而不用扫描整个老年代。
+ */
+class CardTable {
+    u1 *cards = nullptr;
+    u1 *base = nullptr;
+    size_t count = 0;
+
+public:
+    static const int CARD_SHIFT = 9;
+    static const size_t CARD_SIZE = 1 << CARD_SHIFT;
+
+    enum: u1 { CLEAN = 0, DIRTY = 1 };
+
+    void init(u1 *begin, u1 *end)
+    {
+        base = begin;
+        count = (end - begin + CARD_SIZE - 1) >> CARD_SHIFT;
+        cards = new u1[count];
+        memset(cards, CLEAN, count);
+    }
+
+    size_t size() const { return count; }
+
+    // 多个线程可能同时标记同一张卡，写入的都是 DIRTY，所以无需同步
+    void mark(const void *p) { cards[((const u1 *) p - base) >> CARD_SHIFT] = DIRTY; }
+
+    bool isDirty(size_t i) const { return cards[i] == DIRTY; }
+    void clear(size_t i) { cards[i] = CLEAN; }
+
+    u1 *cardStart(size_t i) const { return base + (i << CARD_SHIFT); }
+};
+
+#endif //KAYOVM_CARDTABLE_H
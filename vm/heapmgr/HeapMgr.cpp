@@ -5,47 +5,290 @@
 #include <cstring>
 #include <cassert>
 #include <sstream>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
 #include "HeapMgr.h"
 #include "../kayo.h"
 #include "../config.h"
 
 using namespace std;
 
-HeapMgr::HeapMgr()
+#define CTZ64(x) __builtin_ctzll(x)
+#define LOG2(x)  (63 - __builtin_clzll((unsigned long long) (x)))
+
+/*
+ * 保留、提交和释放内存
+ */
+#ifdef _WIN32
+
+static void *reserveMemory(size_t len)
 {
-    heap = malloc(VM_HEAP_SIZE);
-    freelist = new Node((uintptr_t) heap, VM_HEAP_SIZE, nullptr);
+    return VirtualAlloc(nullptr, len, MEM_RESERVE, PAGE_NOACCESS);
 }
 
-void *HeapMgr::get(size_t len)
+static bool commitMemory(void *p, size_t len)
 {
-    Node *prev = nullptr;
-    Node *curr = freelist;
-    for (; curr != nullptr; prev = curr, curr = curr->next) {
-        if (curr->len == len) {
-            if (prev != nullptr) {
-                prev->next = curr->next;
-            } else {
-                assert(curr == freelist);
-                freelist = curr->next;
-            }
-            auto t = (void *) curr->head;
-            delete curr;
+    return VirtualAlloc(p, len, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+}
 
-            memset(t, 0, len);
-            return t;
-        }
-        if (curr->len > len) {
-            auto t = (void *) (curr->head);
-            curr->head += len;
-            curr->len -= len;
+static void uncommitMemory(void *p, size_t len)
+{
+    VirtualFree(p, len, MEM_DECOMMIT);
+}
+
+static void releaseMemory(void *p, size_t len)
+{
+    VirtualFree(p, 0, MEM_RELEASE);
+}
+
+static void adviseHugePages(void *p, size_t len)
+{
+    // Windows 的大页需要 SeLockMemoryPrivilege 权限，不支持
+}
+
+#else
+
+static void *reserveMemory(size_t len)
+{
+    void *p = mmap(nullptr, len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+static bool commitMemory(void *p, size_t len)
+{
+    return mprotect(p, len, PROT_READ | PROT_WRITE) == 0;
+}
+
+static void uncommitMemory(void *p, size_t len)
+{
+    madvise(p, len, MADV_DONTNEED);
+    mprotect(p, len, PROT_NONE);
+}
+
+static void releaseMemory(void *p, size_t len)
+{
+    munmap(p, len);
+}
+
+static void adviseHugePages(void *p, size_t len)
+{
+#ifdef MADV_HUGEPAGE
+    madvise(p, len, MADV_HUGEPAGE);
+#endif
+}
+
+#endif
+
+static size_t alignUp(size_t n, size_t align)
+{
+    return (n + align - 1) / align * align;
+}
+
+HeapMgr::HeapMgr(size_t size)
+{
+    init(size, size);
+}
+
+HeapMgr::HeapMgr(size_t initialSize, size_t maxSize, bool hugePages)
+{
+    init(initialSize, maxSize, hugePages);
+}
+
+void HeapMgr::init(size_t initialSize0, size_t maxSize0, bool hugePages)
+{
+    assert(heap == nullptr);
+    assert(0 < initialSize0 && initialSize0 <= maxSize0);
+
+    maxSize = alignUp(maxSize0, COMMIT_GRANULE);
+    initialSize = alignUp(initialSize0, COMMIT_GRANULE);
+
+    // 多保留一个 COMMIT_GRANULE，使堆的起始地址按大页对齐
+    reservationSize = hugePages ? maxSize + COMMIT_GRANULE : maxSize;
+    reservation = reserveMemory(reservationSize);
+    if (reservation == nullptr) {
+        jvm_abort("reserve %zu bytes of address space for the heap failed\n", maxSize);
+    }
+    heap = (u1 *) (hugePages ? alignUp((uintptr_t) reservation, COMMIT_GRANULE) : (uintptr_t) reservation);
+    if (hugePages)
+        adviseHugePages(heap, maxSize);
+
+    // bitmap 按最大的堆分配，calloc 的内存在用到之前不占用物理内存
+    size_t words = (maxSize / HEAP_ALIGN + 31) / 32;
+    startBits = (u4 *) calloc(words, sizeof(u4));
+    endBits = (u4 *) calloc(words, sizeof(u4));
+    if (startBits == nullptr || endBits == nullptr) {
+        jvm_abort("malloc failed\n");
+    }
+
+    memset(smallLists, 0, sizeof(smallLists));
+    memset(bins, 0, sizeof(bins));
+    memset(slBitmap, 0, sizeof(slBitmap));
+    smallBitmap = flBitmap = 0;
+
+    if (!commitMemory(heap, initialSize)) {
+        jvm_abort("commit %zu bytes for the heap failed\n", initialSize);
+    }
+    committed = initialSize;
+    freeBytes = committed;
+    insert(heap, committed);
+}
+
+/*
+ * 大块所在的 bin，@len 向下取整到 bin 的边界。
+ */
+void HeapMgr::mapping(size_t len, int &fl, int &sl)
+{
+    assert(len > SMALL_MAX);
+    int l = LOG2(len);
+    fl = l - FL_MIN;
+    sl = (int) (len >> (l - SL_LOG2)) & (SL_COUNT - 1);
+    assert(0 <= fl && fl < FL_COUNT);
+}
+
+/*
+ * 查找一个不小于 @len 的空闲块，找不到返回 nullptr。
+ */
+HeapMgr::FreeBlock *HeapMgr::find(size_t len)
+{
+    if (len <= SMALL_MAX) {
+        // 恰好相等，或者切分后剩下的部分还能挂到链表上（避免产生太多无法链接的碎片）
+        u8 mask = (1ULL << (len / HEAP_ALIGN)) | (~0ULL << ((len + MIN_BLOCK) / HEAP_ALIGN));
+        u8 m = smallBitmap & mask;
+        if (m != 0)
+            return smallLists[CTZ64(m)];
+    }
+
+    int fl = 0, sl = 0;
+    if (len > SMALL_MAX) {
+        // 向上取整到下一个 bin 的边界，这样 bin 中的任何一块都够用
+        size_t round = ((size_t) 1 << (LOG2(len) - SL_LOG2)) - 1;
+        if (len + round < len || LOG2(len + round) >= FL_MAX) // too large
+            return nullptr;
+        mapping(len + round, fl, sl);
+    }
+
+    u4 m = slBitmap[fl] & (~0u << sl);
+    if (m == 0) {
+        if (fl + 1 >= FL_COUNT)
+            return nullptr;
+        u8 flm = flBitmap & (~0ULL << (fl + 1));
+        if (flm == 0)
+            return nullptr;
+        fl = CTZ64(flm);
+        m = slBitmap[fl];
+        assert(m != 0);
+    }
+    sl = CTZ64(m);
+    return bins[fl][sl];
+}
+
+void HeapMgr::link(FreeBlock *b)
+{
+    assert(b->len >= MIN_BLOCK);
 
-            memset(t, 0, len);
-            return t;
+    FreeBlock **head;
+    if (b->len <= SMALL_MAX) {
+        size_t i = b->len / HEAP_ALIGN;
+        head = smallLists + i;
+        smallBitmap |= (1ULL << i);
+    } else {
+        int fl, sl;
+        mapping(b->len, fl, sl);
+        head = &bins[fl][sl];
+        slBitmap[fl] |= (1u << sl);
+        flBitmap |= (1ULL << fl);
+    }
+
+    b->prev = nullptr;
+    b->next = *head;
+    if (*head != nullptr)
+        (*head)->prev = b;
+    *head = b;
+}
+
+void HeapMgr::unlink(FreeBlock *b)
+{
+    if (b->prev != nullptr) {
+        b->prev->next = b->next;
+        if (b->next != nullptr)
+            b->next->prev = b->prev;
+        return;
+    }
+
+    // b is the head of its list
+    if (b->next != nullptr)
+        b->next->prev = nullptr;
+
+    if (b->len <= SMALL_MAX) {
+        size_t i = b->len / HEAP_ALIGN;
+        assert(smallLists[i] == b);
+        smallLists[i] = b->next;
+        if (b->next == nullptr)
+            smallBitmap &= ~(1ULL << i);
+    } else {
+        int fl, sl;
+        mapping(b->len, fl, sl);
+        assert(bins[fl][sl] == b);
+        bins[fl][sl] = b->next;
+        if (b->next == nullptr) {
+            slBitmap[fl] &= ~(1u << sl);
+            if (slBitmap[fl] == 0)
+                flBitmap &= ~(1ULL << fl);
         }
     }
+}
+
+void HeapMgr::insert(u1 *p, size_t len)
+{
+    assert(len > 0 && len % HEAP_ALIGN == 0);
 
-    raiseException(STACK_OVERFLOW_ERROR); // todo 堆可以扩张
+    auto b = (FreeBlock *) p;
+    b->len = len;
+    *(size_t *) (p + len - sizeof(size_t)) = len; // footer
+    setBit(startBits, granule(p));
+    setBit(endBits, granule(p + len - HEAP_ALIGN));
+
+    if (len >= MIN_BLOCK)
+        link(b);
+}
+
+void HeapMgr::remove(FreeBlock *b)
+{
+    auto p = (u1 *) b;
+    if (b->len >= MIN_BLOCK)
+        unlink(b);
+    clearBit(startBits, granule(p));
+    clearBit(endBits, granule(p + b->len - HEAP_ALIGN));
+}
+
+void *HeapMgr::get(size_t len)
+{
+    len = len == 0 ? HEAP_ALIGN : HEAP_ALIGN_UP(len);
+
+    pthread_mutex_lock(&mutex);
+    stats.gets++;
+    stats.getBytes += len;
+
+    FreeBlock *b = find(len);
+    if (b == nullptr) {
+        pthread_mutex_unlock(&mutex);
+        return nullptr;
+    }
+
+    size_t blockLen = b->len;
+    assert(blockLen >= len);
+    remove(b);
+    if (blockLen > len) {
+        insert((u1 *) b + len, blockLen - len);
+    }
+    freeBytes -= len;
+    pthread_mutex_unlock(&mutex);
+
+    memset(b, 0, len);
+    return b;
 }
 
 void HeapMgr::back(void *p, size_t len)
@@ -53,66 +296,163 @@ void HeapMgr::back(void *p, size_t len)
     if (p == nullptr || len == 0)
         return;
 
-    auto mem = (uintptr_t)(p);
+    len = HEAP_ALIGN_UP(len);
+    pthread_mutex_lock(&mutex);
+    stats.backs++;
+    stats.backBytes += len;
+    back0((u1 *) p, len);
+    pthread_mutex_unlock(&mutex);
+}
 
-    Node *prev = nullptr;
-    Node *curr = freelist;
-    for (; curr != nullptr; prev = curr, curr = curr->next) {
-        if (mem > curr->head)
-            continue;
+void HeapMgr::back0(u1 *p, size_t len)
+{
+    assert(heap <= p && p + len <= heap + committed);
+    assert(!testBit(startBits, granule(p)));
+    freeBytes += len;
 
-        assert(mem + len <= curr->head);
-        if (prev == nullptr) {
-            assert(curr == freelist);
-            if (mem + len == curr->head) { // 空间右连续
-                curr->head = mem;
-                curr->len += len;
-                return;
-            } else { // 右不连续
-                freelist = new Node(mem, len, curr);
-                return;
-            }
-        }
+    // 右边相邻的是空闲块，合并
+    u1 *right = p + len;
+    if (right < heap + committed && testBit(startBits, granule(right))) {
+        auto r = (FreeBlock *) right;
+        len += r->len;
+        remove(r);
+    }
 
-        assert(prev != nullptr);
-        assert(prev->head + prev->len <= mem);
-        if (prev->head + prev->len == mem) {
-            if (mem + len == curr->head) {
-                // 左右都连续
-                prev->len += (len + curr->len);
-                prev->next = curr->next;
-                delete curr;
-                return;
-            } else {
-                // 左连续，右不连续
-                prev->len += len;
-                return;
-            }
-        } else {
-            if (mem + len == curr->head) {
-                // 左不连续，右连续
-                curr->len += len;
-                curr->head = mem;
-                return;
-            } else {
-                // 左右都不连续
-                prev->next = new Node(mem, len, curr);
-                return;
-            }
+    // 左边相邻的是空闲块，通过它的 footer 找到它的起始地址，合并
+    if (p > heap && testBit(endBits, granule(p - HEAP_ALIGN))) {
+        size_t leftLen = *(size_t *) (p - sizeof(size_t));
+        auto l = (FreeBlock *) (p - leftLen);
+        assert(testBit(startBits, granule(l)));
+        remove(l);
+        p = (u1 *) l;
+        len += leftLen;
+    }
+
+    insert(p, len);
+}
+
+bool HeapMgr::expand(size_t len)
+{
+    len = HEAP_ALIGN_UP(len);
+
+    pthread_mutex_lock(&mutex);
+    // 其他线程可能已经扩展过了
+    if (find(len) != nullptr) {
+        pthread_mutex_unlock(&mutex);
+        return true;
+    }
+
+    size_t grow = alignUp(len > VM_HEAP_EXPAND_SIZE ? len : VM_HEAP_EXPAND_SIZE, COMMIT_GRANULE);
+    if (grow > maxSize - committed)
+        grow = maxSize - committed;
+    if (grow == 0 || !commitMemory(heap + committed, grow)) {
+        pthread_mutex_unlock(&mutex);
+        return false;
+    }
+
+    u1 *p = heap + committed;
+    committed += grow;
+    back0(p, grow); // 和末尾的空闲块合并
+    bool ok = find(len) != nullptr;
+    pthread_mutex_unlock(&mutex);
+    return ok;
+}
+
+void HeapMgr::shrink(size_t target)
+{
+    target = alignUp(target > initialSize ? target : initialSize, COMMIT_GRANULE);
+
+    pthread_mutex_lock(&mutex);
+    u1 *end = heap + committed;
+    if (committed <= target || !testBit(endBits, granule(end - HEAP_ALIGN))) {
+        // 末尾不是空闲块
+        pthread_mutex_unlock(&mutex);
+        return;
+    }
+
+    size_t tailLen = *(size_t *) (end - sizeof(size_t));
+    u1 *tail = end - tailLen;
+    size_t newCommitted = alignUp(tail - heap, COMMIT_GRANULE);
+    if (newCommitted < target)
+        newCommitted = target;
+    if (newCommitted >= committed) {
+        pthread_mutex_unlock(&mutex);
+        return;
+    }
+
+    remove((FreeBlock *) tail);
+    u1 *newEnd = heap + newCommitted;
+    if (newEnd > tail)
+        insert(tail, newEnd - tail);
+    uncommitMemory(newEnd, committed - newCommitted);
+    freeBytes -= committed - newCommitted;
+    committed = newCommitted;
+    pthread_mutex_unlock(&mutex);
+}
+
+void HeapMgr::reset()
+{
+    pthread_mutex_lock(&mutex);
+    size_t words = (maxSize / HEAP_ALIGN + 31) / 32;
+    memset(startBits, 0, words * sizeof(u4));
+    memset(endBits, 0, words * sizeof(u4));
+
+    memset(smallLists, 0, sizeof(smallLists));
+    memset(bins, 0, sizeof(bins));
+    memset(slBitmap, 0, sizeof(slBitmap));
+    smallBitmap = flBitmap = 0;
+    freeBytes = 0;
+    pthread_mutex_unlock(&mutex);
+}
+
+size_t HeapMgr::largestFreeBlock()
+{
+    size_t max = 0;
+
+    pthread_mutex_lock(&mutex);
+    if (flBitmap != 0) {
+        // 最高的非空 bin 中的块不一定一样大，遍历一遍
+        int fl = LOG2(flBitmap);
+        int sl = LOG2(slBitmap[fl]);
+        for (auto b = bins[fl][sl]; b != nullptr; b = b->next) {
+            if (b->len > max)
+                max = b->len;
         }
+    } else if (smallBitmap != 0) {
+        max = LOG2(smallBitmap) * HEAP_ALIGN;
     }
+    pthread_mutex_unlock(&mutex);
+
+    return max;
 }
 
 string HeapMgr::toString() const
 {
     stringstream ss;
 
-    ss << "heap: " << heap << endl;
+    ss << "heap: " << (void *) heap << ", size: " << committed << " of " << maxSize << ", free: " << freeBytes << endl;
+    ss << "gets: " << stats.gets << "(" << stats.getBytes << " bytes), ";
+    ss << "backs: " << stats.backs << "(" << stats.backBytes << " bytes)" << endl;
+
+    ss << "small lists: " << endl << '|';
+    for (int i = 0; i < SMALL_CLASSES; i++) {
+        if (smallLists[i] == nullptr)
+            continue;
+        int count = 0;
+        for (auto b = smallLists[i]; b != nullptr; b = b->next)
+            count++;
+        ss << i * HEAP_ALIGN << " bytes: " << count << '|';
+    }
+    ss << endl;
 
-    ss << "freelist: " << endl << '|';
-    for (auto node = freelist; node != nullptr; node = node->next) {
-        ss << (void *) node->head << ',';
-        ss << node->len << "(0x" << hex << node->len << ")|";
+    ss << "bins: " << endl << '|';
+    for (int fl = 0; fl < FL_COUNT; fl++) {
+        for (int sl = 0; sl < SL_COUNT; sl++) {
+            for (auto b = bins[fl][sl]; b != nullptr; b = b->next) {
+                ss << (void *) b << ',';
+                ss << b->len << "(0x" << hex << b->len << dec << ")|";
+            }
+        }
     }
 
     return ss.str();
@@ -120,11 +460,9 @@ string HeapMgr::toString() const
 
 HeapMgr::~HeapMgr()
 {
-    for (auto p = freelist; p != nullptr;) {
-        auto t = p->next;
-        delete p;
-        p = t;
-    }
-
-    free(heap);
+    if (reservation != nullptr)
+        releaseMemory(reservation, reservationSize);
+    free(startBits);
+    free(endBits);
+    pthread_mutex_destroy(&mutex);
 }
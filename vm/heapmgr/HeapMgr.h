@@ -7,25 +7,158 @@
 
 #include <cstddef>
 #include <string>
+#include <pthread.h>
 #include "../jtypes.h"
 
+// 堆中对象的对齐粒度，所有对象的大小都向上对齐到 HEAP_ALIGN
+#define HEAP_ALIGN 8
+#define HEAP_ALIGN_UP(size) (((size) + (HEAP_ALIGN - 1)) & ~((size_t) HEAP_ALIGN - 1))
+
+/*
+ * 按尺寸分级的空闲链表（segregated free lists）
+ *
+ * 1. 小块（<= SMALL_MAX）：每个 HEAP_ALIGN 的倍数一条精确尺寸的链表，
+ *    分配时直接取对应链表的表头，O(1)。
+ * 2. 大块：按 log2(len) 分为一级，每级再等分为 SL_COUNT 个二级 bin（类似 TLSF）。
+ *    查找时把请求尺寸向上取整到 bin 的边界，这样找到的第一个非空 bin 中的任何一块都够用，
+ *    也是 O(1) 的 good fit，不用遍历链表。
+ *
+ * 各链表是否为空记录在 bitmap 中，用 ctz 找到第一个可用的链表。
+ *
+ * 空闲块的元数据（长度和前后指针）直接存放在空闲块内部，尾部再存一份长度（footer），
+ * 另有两张 side bitmap 标记每个空闲块的起始粒度和结束粒度，
+ * 这样归还内存时只看左右相邻的粒度就能 O(1) 的合并，不再需要额外申请 Node。
+ * 小于 MIN_BLOCK 的碎片放不下前后指针，不挂到链表上，只在 bitmap 中标记，等相邻的块归还时合并。
+ *
+ * 堆先保留 maxSize 大小的虚拟地址空间（不占用物理内存），开始时只提交（commit）initialSize，
+ * 提交的部分 [heap, heap + committed) 由空闲链表管理。空间不足时由 expand 向后提交更多的内存，
+ * GC 后由 shrink 把末尾空闲的内存还给操作系统。地址空间一直保留，所以堆的地址范围不会改变。
+ */
 class HeapMgr {
-    struct Node {
-        uintptr_t head;
+    struct FreeBlock {
         size_t len;
-        Node *next;
-        Node(uintptr_t head, size_t len, Node *next): head(head), len(len), next(next) { }
-    } *freelist;
+        FreeBlock *prev;
+        FreeBlock *next;
+    };
+
+    static const size_t MIN_BLOCK = HEAP_ALIGN_UP(sizeof(FreeBlock) + sizeof(size_t));
+
+    static const size_t SMALL_MAX = 256;
+    static const int SMALL_CLASSES = SMALL_MAX / HEAP_ALIGN + 1; // index = len / HEAP_ALIGN
+
+    static const int SL_LOG2 = 3;
+    static const int SL_COUNT = 1 << SL_LOG2;
+    static const int FL_MIN = 8; // log2(SMALL_MAX)
+    static const int FL_MAX = 48;
+    static const int FL_COUNT = FL_MAX - FL_MIN;
+
+    u1 *heap = nullptr;
+    size_t committed = 0;   // 已经提交的大小
+    size_t initialSize = 0; // shrink 不会低于此值
+    size_t maxSize = 0;     // 保留的地址空间的大小
+
+    // 保留的地址空间，使用大页时为了对齐会比 maxSize 多保留一些
+    void *reservation = nullptr;
+    size_t reservationSize = 0;
+
+    // 每个粒度一个 bit，标记空闲块的起始与结束
+    u4 *startBits = nullptr;
+    u4 *endBits = nullptr;
+
+    FreeBlock *smallLists[SMALL_CLASSES];
+    u8 smallBitmap;
+
+    FreeBlock *bins[FL_COUNT][SL_COUNT];
+    u8 flBitmap;
+    u1 slBitmap[FL_COUNT];
+
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    size_t granule(const void *p) const { return ((u1 *) p - heap) / HEAP_ALIGN; }
+    static void setBit(u4 *bits, size_t i) { bits[i >> 5] |= (1u << (i & 31)); }
+    static void clearBit(u4 *bits, size_t i) { bits[i >> 5] &= ~(1u << (i & 31)); }
+    static bool testBit(const u4 *bits, size_t i) { return (bits[i >> 5] & (1u << (i & 31))) != 0; }
+
+    static void mapping(size_t len, int &fl, int &sl);
+    FreeBlock *find(size_t len);
 
-    void *heap;
+    void link(FreeBlock *b);
+    void unlink(FreeBlock *b);
+
+    // 把 [p, p+len) 标记为空闲块，并挂到对应的链表上
+    void insert(u1 *p, size_t len);
+    // 从链表和 bitmap 中移除空闲块 @b
+    void remove(FreeBlock *b);
+
+    void back0(u1 *p, size_t len);
 
 public:
-    HeapMgr();
+    // 分配统计，get and back 时在锁内更新
+    struct Stats {
+        size_t gets = 0;
+        size_t getBytes = 0;
+        size_t backs = 0;
+        size_t backBytes = 0;
+    } stats;
+
+    // 提交和释放内存的粒度，也是透明大页的大小
+    static const size_t COMMIT_GRANULE = 2*1024*1024;
+
+    size_t freeBytes = 0;
+
+    // 需要调用 init 之后才能使用
+    HeapMgr() = default;
+    explicit HeapMgr(size_t size);
+    HeapMgr(size_t initialSize, size_t maxSize, bool hugePages = false);
     ~HeapMgr();
 
+    /*
+     * 保留 @maxSize 的地址空间，并提交其中的 @initialSize，两者都向上取整到 COMMIT_GRANULE.
+     * @hugePages: 建议操作系统用透明大页（MADV_HUGEPAGE）映射堆，减少大堆的 TLB miss.
+     */
+    void init(size_t initialSize, size_t maxSize, bool hugePages = false);
+
+    /*
+     * 提交更多的内存，至少能放下 @len 字节的块，已经达到 maxSize 时返回 false.
+     */
+    bool expand(size_t len);
+
+    /*
+     * 堆的末尾是空闲块时，把已提交的大小缩小到不低于 max(@target, initialSize)，
+     * 释放的内存还给操作系统（MADV_DONTNEED）。
+     */
+    void shrink(size_t target);
+
+    /*
+     * 申请 @len 字节清零的内存，堆中没有足够的空间时返回 nullptr（由调用者决定是否触发 GC）。
+     */
     void *get(size_t len);
     void back(void *p, size_t len);
-    
+
+    /*
+     * 清空所有的空闲块，整个堆都视为已分配，之后由调用者把空闲的部分逐段 back 回来。
+     * GC 整理（compact）堆之后使用，调用时不能有其他线程访问 HeapMgr.
+     */
+    void reset();
+
+    // 最大的空闲块的长度，用于判断堆的碎片化程度
+    size_t largestFreeBlock();
+
+    size_t capacity() const { return committed; }
+    size_t maxCapacity() const { return maxSize; }
+
+    // 整个保留的地址范围，GC 的 bitmap 和卡表按它分配
+    u1 *begin() const { return heap; }
+    u1 *end() const { return heap + maxSize; }
+    bool contains(const void *p) const { return heap <= (u1 *) p && (u1 *) p < heap + maxSize; }
+
+    /*
+     * 以下两个函数供 GC 遍历堆使用：堆中的每一段内存要么是一个对象，要么是一个空闲块。
+     * @p 必须是对象或者空闲块的起始地址。
+     */
+    bool isFreeBlock(const void *p) const { return testBit(startBits, granule(p)); }
+    size_t freeBlockLen(const void *p) const { return ((const FreeBlock *) p)->len; }
+
     std::string toString() const;
 };
 
@@ -0,0 +1,191 @@
+/*
+ * Author: kayo
+ */
+
+#include <sstream>
+#include <cassert>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "LargeObjectSpace.h"
+#include "../rtda/heap/Object.h"
+
+using namespace std;
+
+#ifdef _WIN32
+
+static size_t pageSize()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+}
+
+// MEM_COMMIT 的页已经清零
+static void *mapMemory(size_t len)
+{
+    return VirtualAlloc(nullptr, len, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+static void unmapMemory(void *p, size_t len)
+{
+    VirtualFree(p, 0, MEM_RELEASE);
+}
+
+#else
+
+static size_t pageSize()
+{
+    return (size_t) sysconf(_SC_PAGESIZE);
+}
+
+// 匿名映射的页在第一次访问时由内核清零
+static void *mapMemory(size_t len)
+{
+    void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+static void unmapMemory(void *p, size_t len)
+{
+    munmap(p, len);
+}
+
+#endif
+
+LargeObjectSpace::~LargeObjectSpace()
+{
+    for (auto &e : objects)
+        unmapMemory((void *) e.first, e.second.len);
+    pthread_mutex_destroy(&mutex);
+}
+
+void *LargeObjectSpace::alloc(size_t size, bool marked)
+{
+    static const size_t page = pageSize();
+    assert(page % PAGE_ALIGN == 0);
+
+    size_t len = (size + page - 1) / page * page;
+    auto p = (const u1 *) mapMemory(len);
+    if (p == nullptr)
+        return nullptr;
+
+    pthread_mutex_lock(&mutex);
+    objects.emplace(p, Entry{ len, marked });
+    committedBytes += len;
+    stats.allocs++;
+    stats.allocBytes += len;
+    if (p < low.load(memory_order_relaxed))
+        low.store(p, memory_order_relaxed);
+    if (p + len > high.load(memory_order_relaxed))
+        high.store(p + len, memory_order_relaxed);
+    pthread_mutex_unlock(&mutex);
+
+    return (void *) p;
+}
+
+bool LargeObjectSpace::contains(const void *p)
+{
+    if (!mayContain(p))
+        return false;
+
+    pthread_mutex_lock(&mutex);
+    bool found = objects.find((const u1 *) p) != objects.end();
+    pthread_mutex_unlock(&mutex);
+    return found;
+}
+
+bool LargeObjectSpace::mark(const void *p)
+{
+    if (!mayContain(p))
+        return false;
+
+    bool claimed = false;
+    pthread_mutex_lock(&mutex);
+    auto it = objects.find((const u1 *) p);
+    if (it != objects.end() && !it->second.marked) {
+        it->second.marked = true;
+        claimed = true;
+    }
+    pthread_mutex_unlock(&mutex);
+    return claimed;
+}
+
+const void *LargeObjectSpace::objectContaining(const void *p)
+{
+    auto q = (const u1 *) p;
+    if (q < low.load(memory_order_relaxed) || q >= high.load(memory_order_relaxed))
+        return nullptr;
+
+    const void *o = nullptr;
+    pthread_mutex_lock(&mutex);
+    auto it = objects.upper_bound(q);
+    if (it != objects.begin()) {
+        --it;
+        if (q < it->first + it->second.len)
+            o = it->first;
+    }
+    pthread_mutex_unlock(&mutex);
+    return o;
+}
+
+void LargeObjectSpace::clearMarks()
+{
+    pthread_mutex_lock(&mutex);
+    for (auto &e : objects)
+        e.second.marked = false;
+    pthread_mutex_unlock(&mutex);
+}
+
+size_t LargeObjectSpace::sweep()
+{
+    size_t freed = 0;
+
+    pthread_mutex_lock(&mutex);
+    for (auto it = objects.begin(); it != objects.end();) {
+        if (it->second.marked) {
+            ++it;
+            continue;
+        }
+
+        auto o = (Object *) it->first;
+        size_t len = it->second.len;
+        o->destroy();
+        unmapMemory(o, len);
+        freed += len;
+        stats.frees++;
+        it = objects.erase(it);
+    }
+    committedBytes -= freed;
+    stats.freeBytes += freed;
+
+    // 收紧地址范围
+    low.store(objects.empty() ? (const u1 *) UINTPTR_MAX : objects.begin()->first, memory_order_relaxed);
+    high.store(objects.empty() ? nullptr : objects.rbegin()->first + objects.rbegin()->second.len,
+               memory_order_relaxed);
+    pthread_mutex_unlock(&mutex);
+
+    return freed;
+}
+
+size_t LargeObjectSpace::count()
+{
+    pthread_mutex_lock(&mutex);
+    size_t n = objects.size();
+    pthread_mutex_unlock(&mutex);
+    return n;
+}
+
+string LargeObjectSpace::toString()
+{
+    ostringstream oss;
+    pthread_mutex_lock(&mutex);
+    oss << "large objects: " << objects.size() << "(" << committedBytes << " bytes)"
+        << ", allocs: " << stats.allocs << "(" << stats.allocBytes << " bytes)"
+        << ", frees: " << stats.frees << "(" << stats.freeBytes << " bytes)";
+    pthread_mutex_unlock(&mutex);
+    return oss.str();
+}
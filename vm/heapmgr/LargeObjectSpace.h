@@ -0,0 +1,104 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_LARGEOBJECTSPACE_H
+#define KAYOVM_LARGEOBJECTSPACE_H
+
+#include <map>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <pthread.h>
+#include "../jtypes.h"
+
+class Object;
+
+/*
+ * 大对象空间（large object space）
+ *
+ * 大于 VM_LARGE_OBJECT_SIZE 的基本类型数组不在老年代（HeapMgr）中分配，
+ * 每个对象单独向操作系统申请一段按页对齐的内存（mmap），释放时直接归还（munmap）。
+ * 新映射的页由内核清零，分配时无需 memset，也不会在 HeapMgr 的空闲链表中留下大块的碎片。
+ *
+ * 大对象不含引用，不用扫描，也不需要卡表；大对象从不移动，整理（compact）老年代时跳过它们。
+ * 每个对象的标记位和大小记录在 objects 中，而不是 gc.cpp 的 side bitmaps 中。
+ */
+class LargeObjectSpace {
+    struct Entry {
+        size_t len;  // 映射的字节数，按页对齐
+        bool marked;
+    };
+
+    // 按地址排序，由 mutex 保护
+    std::map<const u1 *, Entry> objects;
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    // 所有大对象所在的地址范围，用于快速排除不是大对象的地址
+    std::atomic<const u1 *> low{(const u1 *) UINTPTR_MAX};
+    std::atomic<const u1 *> high{nullptr};
+
+public:
+    // 大对象都起始于页的边界，小于实际的页大小也不影响判断
+    static const size_t PAGE_ALIGN = 4096;
+
+    size_t committedBytes = 0; // 所有大对象占用的字节数
+
+    struct Stats {
+        size_t allocs = 0;
+        size_t allocBytes = 0;
+        size_t frees = 0;
+        size_t freeBytes = 0;
+    } stats;
+
+    LargeObjectSpace() = default;
+    LargeObjectSpace(const LargeObjectSpace &) = delete;
+    LargeObjectSpace &operator=(const LargeObjectSpace &) = delete;
+    ~LargeObjectSpace();
+
+    /*
+     * 为大小为 @size 的对象映射一段内存，返回的内存已经清零，失败时返回 nullptr.
+     * @marked: 对象的初始标记，并发周期中分配的对象直接标记为存活。
+     */
+    void *alloc(size_t size, bool marked);
+
+    /*
+     * @p 可能是某个大对象的起始地址。不加锁，用在写屏障等频繁调用的地方，
+     * 返回 true 时还需用 contains 或者 mark 确认。
+     */
+    bool mayContain(const void *p) const
+    {
+        auto q = (const u1 *) p;
+        return (uintptr_t) q % PAGE_ALIGN == 0
+               && q >= low.load(std::memory_order_relaxed) && q < high.load(std::memory_order_relaxed);
+    }
+
+    // @p 是否是某个大对象的起始地址
+    bool contains(const void *p);
+
+    /*
+     * 如果 @p 是某个大对象的起始地址并且还没有标记，则标记它并返回 true.
+     * 多个标记线程可以同时调用。
+     */
+    bool mark(const void *p);
+
+    /*
+     * 包含地址 @p 的大对象的起始地址，@p 可以指向对象的内部，不在任何大对象中时返回 nullptr.
+     * 用于保守扫描，栈中可能只留有指向数组元素的指针。
+     */
+    const void *objectContaining(const void *p);
+
+    void clearMarks();
+
+    /*
+     * 释放所有未标记的大对象，返回释放的字节数。
+     * 可以和 alloc 并发执行。
+     */
+    size_t sweep();
+
+    size_t count();
+
+    std::string toString();
+};
+
+#endif //KAYOVM_LARGEOBJECTSPACE_H
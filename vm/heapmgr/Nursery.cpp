@@ -0,0 +1,143 @@
+/*
+ * Author: kayo
+ */
+
+#include <cstring>
+#include <cassert>
+#include "Nursery.h"
+#include "../kayo.h"
+#include "../rtda/heap/Object.h"
+
+using namespace std;
+
+void Nursery::init(size_t size)
+{
+    assert(start == nullptr);
+
+    blockCount = size / BLOCK_SIZE;
+    if (blockCount < 4) {
+        jvm_abort("nursery is too small: %zu bytes, at least %zu bytes\n", size, 4 * BLOCK_SIZE);
+    }
+    size = blockCount * BLOCK_SIZE;
+
+    start = (u1 *) malloc(size);
+    size_t words = blockCount * WORDS_PER_BLOCK;
+    startBits = (u4 *) calloc(words, sizeof(u4));
+    liveBits = (u4 *) calloc(words, sizeof(u4));
+    if (start == nullptr || startBits == nullptr || liveBits == nullptr) {
+        jvm_abort("malloc failed\n");
+    }
+    end = start + size;
+
+    blocks = new Block[blockCount];
+    for (size_t i = blockCount; i > 0; i--)
+        freeBlocks.push_back(i - 1);
+    reserved = blockCount / 8 > 0 ? blockCount / 8 : 1;
+}
+
+u1 *Nursery::takeBlock(size_t keep, BlockState state, u1 age)
+{
+    pthread_mutex_lock(&mutex);
+    if (freeBlocks.size() <= keep) {
+        pthread_mutex_unlock(&mutex);
+        return nullptr;
+    }
+
+    size_t i = freeBlocks.back();
+    freeBlocks.pop_back();
+    assert(blocks[i].state == FREE);
+    blocks[i].state = state;
+    blocks[i].age = age;
+    pthread_mutex_unlock(&mutex);
+
+    return start + i * BLOCK_SIZE;
+}
+
+u1 *Nursery::getEdenBlock()
+{
+    u1 *b = takeBlock(reserved, EDEN, 0);
+    if (b != nullptr)
+        memset(b, 0, BLOCK_SIZE);
+    return b;
+}
+
+u1 *Nursery::getSurvivorBlock(u1 age)
+{
+    return takeBlock(0, SURVIVOR, age);
+}
+
+Object *Nursery::objectContaining(const void *p) const
+{
+    assert(contains(p));
+
+    size_t i = granule(p);
+    size_t first = firstWord(blockIndex(p));
+    size_t w = i >> 5;
+    u4 bits = startBits[w] & (~0u >> (31 - (i & 31)));
+    while (bits == 0) {
+        if (w == first)
+            return nullptr;
+        bits = startBits[--w];
+    }
+
+    auto o = (Object *) (start + (w * 32 + 31 - __builtin_clz(bits)) * HEAP_ALIGN);
+    // @p 可能位于 TLAB 中还没有分配出去的部分
+    if ((const u1 *) p >= (u1 *) o + HEAP_ALIGN_UP(o->size()))
+        return nullptr;
+    return o;
+}
+
+bool Nursery::setLive(const Object *o)
+{
+    size_t i = granule(o);
+    if (testBit(liveBits, i))
+        return false;
+    setBit(liveBits, i);
+    return true;
+}
+
+void Nursery::condemnAll()
+{
+    for (size_t i = 0; i < blockCount; i++) {
+        blocks[i].condemned = blocks[i].state != FREE;
+        blocks[i].pinned = false;
+    }
+}
+
+size_t Nursery::releaseCondemned()
+{
+    size_t pinnedCount = 0;
+
+    for (size_t i = 0; i < blockCount; i++) {
+        Block &b = blocks[i];
+        if (!b.condemned)
+            continue;
+
+        for (size_t w = firstWord(i); w < firstWord(i) + WORDS_PER_BLOCK; w++) {
+            u4 live = b.pinned ? liveBits[w] : 0;
+            for (u4 bits = startBits[w] & ~live; bits != 0; bits &= bits - 1) {
+                auto o = (Object *) (start + (w * 32 + __builtin_ctz(bits)) * HEAP_ALIGN);
+                // 拷贝走的对象的资源已经属于新的对象了
+                if (!isForwarded(o))
+                    o->destroy(); // 释放对象在堆外持有的资源，比如 StringObject 缓存的 utf8 字符串
+            }
+            startBits[w] &= live;
+            liveBits[w] = 0;
+        }
+
+        b.condemned = false;
+        if (b.pinned) {
+            b.pinned = false;
+            b.state = SURVIVOR;
+            if (b.age < 0xff)
+                b.age++;
+            pinnedCount++;
+        } else {
+            b.state = FREE;
+            b.age = 0;
+            freeBlocks.push_back(i);
+        }
+    }
+
+    return pinnedCount;
+}
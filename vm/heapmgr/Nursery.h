@@ -0,0 +1,156 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_NURSERY_H
+#define KAYOVM_NURSERY_H
+
+#include <cstddef>
+#include <vector>
+#include <pthread.h>
+#include "../jtypes.h"
+#include "../config.h"
+#include "HeapMgr.h"
+#include "../rtda/heap/Object.h"
+
+/*
+ * 新生代（nursery）
+ *
+ * 新生代是一段独立于 HeapMgr 的连续内存，按 VM_TLAB_SIZE 分成大小相同的块（block），
+ * 每个 TLAB 就是一个块。小对象都在 TLAB 中创建，大对象直接在老年代（HeapMgr）中创建。
+ *
+ * 块的状态：
+ *   FREE      空闲
+ *   EDEN      作为 TLAB 分配新对象
+ *   SURVIVOR  存放 minor GC 中存活下来、但还没有晋升到老年代的对象
+ *
+ * minor GC 时所有非空闲的块都是 from-space，存活的对象拷贝到新取得的空闲块（to-space）中，
+ * 经历 VM_TENURE_AGE 次 minor GC 后晋升到老年代，之后 from-space 的块全部变为空闲。
+ * 也就是用块代替了固定的两个半区，to-space 可以使用所有的空闲块，
+ * 为此 Eden 不能用完所有的空闲块，要留下 reserved 个块给 minor GC 拷贝存活的对象。
+ *
+ * 栈桢和 C 栈是保守扫描的，被它们引用的对象不能移动，这些对象所在的块被钉住（pinned），
+ * 块中存活的对象原地保留，块在这次 GC 后变为 SURVIVOR.
+ *
+ * 每个 HEAP_ALIGN 粒度一个 bit 记录对象的起始地址，GC 时用来
+ *   1. 找到保守扫描到的（可能指向对象内部的）地址所属的对象；
+ *   2. 回收块时找到其中死掉的对象，调用其析构函数。
+ */
+class Nursery {
+public:
+    static const size_t BLOCK_SIZE = VM_TLAB_SIZE;
+
+    enum BlockState: u1 {
+        FREE, EDEN, SURVIVOR
+    };
+
+    struct Block {
+        BlockState state = FREE;
+        u1 age = 0;             // 块中的对象经历过的 minor GC 的次数
+        // 以下两个只在 minor GC 中有效
+        bool condemned = false; // 属于 from-space
+        bool pinned = false;
+    };
+
+private:
+    u1 *start = nullptr;
+    u1 *end = nullptr;
+    size_t blockCount = 0;
+    Block *blocks = nullptr;
+
+    std::vector<size_t> freeBlocks; // 空闲块的序号
+    size_t reserved = 0;
+
+    // side bitmaps, 每个 HEAP_ALIGN 粒度一个 bit
+    u4 *startBits = nullptr;   // 对象的起始地址
+    u4 *liveBits = nullptr;    // minor GC 中被钉住的块里存活的对象
+
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    size_t granule(const void *p) const { return ((const u1 *) p - start) / HEAP_ALIGN; }
+    static void setBit(u4 *bits, size_t i) { bits[i >> 5] |= (1u << (i & 31)); }
+    static bool testBit(const u4 *bits, size_t i) { return (bits[i >> 5] & (1u << (i & 31))) != 0; }
+
+    // BLOCK_SIZE 是 32 个粒度的整数倍，所以每个块在 bitmap 中占用整数个字
+    static const size_t WORDS_PER_BLOCK = BLOCK_SIZE / HEAP_ALIGN / 32;
+    static size_t firstWord(size_t i) { return i * WORDS_PER_BLOCK; }
+
+    u1 *takeBlock(size_t keep, BlockState state, u1 age);
+
+public:
+    /*
+     * @size 向下取整到 BLOCK_SIZE 的整数倍，至少要有 4 个块。
+     */
+    void init(size_t size);
+
+    bool contains(const void *p) const { return start <= (const u1 *) p && (const u1 *) p < end; }
+
+    size_t capacity() const { return end - start; }
+    size_t freeBytes() const { return freeBlocks.size() * BLOCK_SIZE; }
+
+    size_t blockIndex(const void *p) const { return ((const u1 *) p - start) / BLOCK_SIZE; }
+    Block &blockOf(const void *p) { return blocks[blockIndex(p)]; }
+
+    /*
+     * 为 TLAB 取得一个空闲块，没有可用的块时返回 nullptr（需要 minor GC）。
+     * 块中的内存已经清零。
+     */
+    u1 *getEdenBlock();
+
+    /*
+     * minor GC 中为拷贝存活的对象取得一个空闲块，可以使用预留的块。
+     */
+    u1 *getSurvivorBlock(u1 age);
+
+    /*
+     * 记录一个对象的起始地址，在 TLAB 或者 survivor 块中分配对象后调用。
+     * 每个块同时只被一个线程使用，块在 bitmap 中独占整数个字，所以无需加锁。
+     */
+    void markStart(const void *p) { setBit(startBits, granule(p)); }
+
+    /*
+     * 找到包含地址 @p 的对象，在 @p 所在的块中向前查找最近的对象起始地址。
+     * 找不到返回 nullptr.
+     */
+    Object *objectContaining(const void *p) const;
+
+    // minor GC 中已经被拷贝走的对象，mark word 中存放其新地址
+    static bool isForwarded(const Object *o) { return (o->markWord & Object::FORWARDED) != 0; }
+    static Object *forwardee(const Object *o) { return (Object *) (o->markWord & ~(uintptr_t) (HEAP_ALIGN - 1)); }
+    static void forward(Object *from, Object *to) { from->markWord = (uintptr_t) to | Object::FORWARDED; }
+
+    // 在被钉住的块中标记存活的对象，如果之前没有标记过返回 true
+    bool setLive(const Object *o);
+
+    /*
+     * 以下在 minor GC 的开始和结束时调用。
+     */
+    // 把所有非空闲的块标记为 from-space
+    void condemnAll();
+    /*
+     * 回收 from-space：没有被钉住的块变为空闲，被钉住的块变为 SURVIVOR.
+     * 其中死掉的对象（既没有被拷贝走，也没有被标记为存活）调用其析构函数。
+     * 返回被钉住的块数。
+     */
+    size_t releaseCondemned();
+
+    /*
+     * 遍历新生代中所有的对象。
+     * 只在 minor GC 刚结束时调用，此时新生代中所有的对象都是存活的。
+     */
+    template <typename Visitor>
+    void forEachObject(Visitor visit)
+    {
+        for (size_t i = 0; i < blockCount; i++) {
+            if (blocks[i].state == FREE)
+                continue;
+            for (size_t w = firstWord(i); w < firstWord(i) + WORDS_PER_BLOCK; w++) {
+                for (u4 bits = startBits[w]; bits != 0; bits &= bits - 1) {
+                    visit((Object *) (start + (w * 32 + __builtin_ctz(bits)) * HEAP_ALIGN));
+                }
+            }
+        }
+    }
+};
+
+#endif //KAYOVM_NURSERY_H
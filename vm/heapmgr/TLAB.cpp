@@ -0,0 +1,133 @@
+/*
+ * Author: kayo
+ */
+
+#include <sstream>
+#include <cassert>
+#include "TLAB.h"
+#include "../kayo.h"
+#include "../config.h"
+#include "../rtda/thread/Thread.h"
+#include "gc.h"
+
+using namespace std;
+
+void TLAB::retire()
+{
+    start = top = end = nullptr;
+}
+
+bool TLAB::refill()
+{
+    retire();
+
+    start = top = g_nursery.getEdenBlock();
+    if (start == nullptr)
+        return false;
+    end = start + Nursery::BLOCK_SIZE;
+    refills++;
+    return true;
+}
+
+string TLAB::toString() const
+{
+    ostringstream oss;
+    oss << "refills: " << refills
+        << ", allocs: " << allocs << "(" << allocBytes << " bytes)"
+        << ", large allocs: " << largeAllocs << "(" << largeBytes << " bytes)"
+        << ", los allocs: " << losAllocs << "(" << losBytes << " bytes)";
+    return oss.str();
+}
+
+static void *alloc(TLAB &tlab, size_t size, bool noRefs)
+{
+    if (noRefs && size >= VM_LARGE_OBJECT_SIZE) {
+        void *p = gc_alloc_large(size);
+        if (p != nullptr) {
+            tlab.losAllocs++;
+            tlab.losBytes += size;
+        }
+        return p;
+    }
+
+    if (size > VM_TLAB_MAX_OBJ_SIZE) {
+        // 大对象不在 TLAB 中分配，否则 TLAB 很快就会被用完，拷贝大对象的代价也比较高
+        void *p = gc_alloc_old(size);
+        if (p != nullptr) {
+            tlab.largeAllocs++;
+            tlab.largeBytes += size;
+        }
+        return p;
+    }
+
+    void *p = tlab.alloc(size);
+    if (p == nullptr && tlab.refill()) {
+        p = tlab.alloc(size);
+        assert(p != nullptr);
+    }
+    if (p != nullptr)
+        g_nursery.markStart(p);
+    return p;
+}
+
+static void *allocOrCollect(size_t size, bool noRefs)
+{
+    size = HEAP_ALIGN_UP(size);
+
+    Thread *thread = thread_self();
+    if (thread == nullptr) {
+        // 主线程还没有创建，直接在老年代中分配，此时还无法 GC
+        void *p = noRefs && size >= VM_LARGE_OBJECT_SIZE ? gc_alloc_large(size) : gc_alloc_old(size);
+        if (p == nullptr) {
+            jvm_abort("Java heap space is too small to start the vm\n");
+        }
+        return p;
+    }
+
+    SAFEPOINT_POLL();
+
+    void *p = alloc(thread->tlab, size, noRefs);
+    if (p == nullptr) {
+        gc_collect();
+        p = alloc(thread->tlab, size, noRefs);
+    }
+    if (p == nullptr) {
+        gc_collect(true, size);
+        p = alloc(thread->tlab, size, noRefs);
+        if (p == nullptr) {
+            // 构造 OutOfMemoryError 对象本身也需要分配内存，防止无限递归。
+            // 只在本线程构造它的期间有效，构造好之后再次分配失败仍然抛出 OutOfMemoryError
+            static __thread bool raising = false;
+            if (raising) {
+                jvm_abort("Java heap space\n");
+            }
+            raising = true;
+            Object *error = newException(OUT_OF_MEMORY_ERROR, "Java heap space");
+            raising = false;
+            raiseException(error);
+        }
+    }
+    return p;
+}
+
+void *heap_alloc(size_t size)
+{
+    return allocOrCollect(size, false);
+}
+
+void *heap_alloc_no_refs(size_t size)
+{
+    return allocOrCollect(size, true);
+}
+
+void print_tlab_stats()
+{
+    printf("TLAB statistics (TLAB size: %d bytes, max object size in TLAB: %d bytes)\n",
+           VM_TLAB_SIZE, VM_TLAB_MAX_OBJ_SIZE);
+    for (size_t i = 0; i < g_all_threads.size(); i++) {
+        printf("  thread %zu: %s\n", i, g_all_threads[i]->tlab.toString().c_str());
+    }
+    const HeapMgr::Stats &stats = g_heap_mgr.stats;
+    printf("  heap: gets: %zu(%zu bytes), backs: %zu(%zu bytes)\n",
+           stats.gets, stats.getBytes, stats.backs, stats.backBytes);
+}
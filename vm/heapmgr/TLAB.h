@@ -0,0 +1,79 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_TLAB_H
+#define KAYOVM_TLAB_H
+
+#include <cstddef>
+#include <string>
+#include "../jtypes.h"
+#include "HeapMgr.h"
+
+/*
+ * Thread Local Allocation Buffer
+ *
+ * 每个线程从新生代中整块的取得一段内存（TLAB，新生代的一个块），之后在其中用 bump pointer 分配对象，
+ * 这样分配小对象时无需加锁，也不用遍历 HeapMgr 的 freelist。
+ * 只有 TLAB 用完时（refill）才需要访问新生代，分配大对象时才需要访问老年代（HeapMgr）。
+ *
+ * 新生代的块取得时已经清零了，所以在其中分配的对象不用再清零。
+ */
+struct TLAB {
+    u1 *start = nullptr;
+    u1 *top = nullptr;
+    u1 *end = nullptr;
+
+    // allocation counters of this thread
+    size_t refills = 0;     // 从新生代取得 TLAB 的次数
+    size_t allocs = 0;      // 在 TLAB 中分配的对象数
+    size_t allocBytes = 0;  // 在 TLAB 中分配的字节数
+    size_t largeAllocs = 0; // 绕过 TLAB 直接在老年代中分配的对象数
+    size_t largeBytes = 0;
+    size_t losAllocs = 0;   // 在大对象空间中分配的对象数
+    size_t losBytes = 0;
+
+    /*
+     * @len must be aligned by HEAP_ALIGN.
+     * return nullptr if this TLAB has no enough space.
+     */
+    void *alloc(size_t len)
+    {
+        if ((size_t) (end - top) < len)
+            return nullptr;
+
+        void *p = top;
+        top += len;
+        allocs++;
+        allocBytes += len;
+        return p;
+    }
+
+    // 换一块新的 TLAB，新生代中没有空闲的块时返回 false（需要 minor GC）
+    bool refill();
+
+    // 放弃当前的 TLAB，未用完的部分在下次 minor GC 回收整个块之前不再使用
+    void retire();
+
+    std::string toString() const;
+};
+
+/*
+ * 为对象申请内存，返回的内存已经清零。
+ * 小对象在当前线程的 TLAB 中分配，大对象（或者主线程创建之前）直接在老年代中分配。
+ * 没有足够的空间时先触发一次 minor GC，仍然不够再触发一次 full GC，还是不够则抛出 OutOfMemoryError.
+ */
+void *heap_alloc(size_t size);
+
+/*
+ * 为不含引用的对象（基本类型的数组）申请内存，返回的内存已经清零。
+ * 不小于 VM_LARGE_OBJECT_SIZE 时在大对象空间中分配，否则同 heap_alloc.
+ */
+void *heap_alloc_no_refs(size_t size);
+
+/*
+ * 打印所有线程的 TLAB 分配统计（-XX:+PrintTLAB）
+ */
+void print_tlab_stats();
+
+#endif //KAYOVM_TLAB_H
@@ -0,0 +1,132 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_WORKSTEALINGDEQUE_H
+#define KAYOVM_WORKSTEALINGDEQUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+/*
+ * Chase-Lev work-stealing deque
+ *
+ * 所有者线程在底部 push 和 pop，其他线程从顶部 steal，只有两端争抢最后一个元素时才需要 CAS.
+ * 数组满了时所有者把它扩大一倍，旧的数组可能还在被 steal 读取，所以先保留，等没有线程访问时再释放（releaseRetired）。
+ *
+ * 内存序参考 "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al., PPoPP 2013).
+ * @T 必须是可以原子读写的类型，比如指针。
+ */
+template <typename T>
+class WorkStealingDeque {
+    struct Array {
+        const intptr_t capacity; // 2 的幂
+        std::atomic<T> *items;
+
+        explicit Array(intptr_t capacity): capacity(capacity), items(new std::atomic<T>[capacity]) { }
+        ~Array() { delete[] items; }
+
+        T get(intptr_t i) const { return items[i & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(intptr_t i, T x) { items[i & (capacity - 1)].store(x, std::memory_order_relaxed); }
+
+        Array *grow(intptr_t bottom, intptr_t top) const
+        {
+            auto a = new Array(capacity * 2);
+            for (intptr_t i = top; i < bottom; i++)
+                a->put(i, get(i));
+            return a;
+        }
+    };
+
+    std::atomic<intptr_t> top;
+    std::atomic<intptr_t> bottom;
+    std::atomic<Array *> array;
+    std::vector<Array *> retired;
+
+public:
+    explicit WorkStealingDeque(intptr_t capacity = 1024): top(0), bottom(0), array(new Array(capacity))
+    {
+        assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    }
+
+    ~WorkStealingDeque()
+    {
+        releaseRetired();
+        delete array.load(std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    // 只能由所有者调用
+    void push(T x)
+    {
+        intptr_t b = bottom.load(std::memory_order_relaxed);
+        intptr_t t = top.load(std::memory_order_acquire);
+        Array *a = array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1) {
+            retired.push_back(a);
+            a = a->grow(b, t);
+            array.store(a, std::memory_order_release);
+        }
+        a->put(b, x);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // 只能由所有者调用，为空时返回 false
+    bool pop(T &x)
+    {
+        intptr_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Array *a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        intptr_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) { // empty
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        x = a->get(b);
+        if (t == b) {
+            // 最后一个元素，和 steal 争抢
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // 可以由任何线程调用，为空或者和其他线程争抢失败时返回 false
+    bool steal(T &x)
+    {
+        intptr_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        intptr_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+
+        Array *a = array.load(std::memory_order_acquire);
+        x = a->get(t);
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    // 不精确，只用于判断是否还有可以 steal 的元素
+    bool empty() const
+    {
+        return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+    }
+
+    // 释放扩容前的数组，调用时不能有其他线程正在访问此 deque
+    void releaseRetired()
+    {
+        for (Array *a : retired)
+            delete a;
+        retired.clear();
+    }
+};
+
+#endif //KAYOVM_WORKSTEALINGDEQUE_H
@@ -2,22 +2,1417 @@
  * Author: kayo
  */
 
+#include <vector>
+#include <cstring>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <pthread.h>
 #include "gc.h"
+#include "HeapMgr.h"
+#include "WorkStealingDeque.h"
 #include "../kayo.h"
+#include "../classfile/constant.h"
 #include "../rtda/thread/Thread.h"
 #include "../rtda/thread/Frame.h"
+#include "../rtda/ma/Class.h"
+#include "../rtda/ma/Field.h"
+#include "../rtda/ma/Method.h"
+#include "../rtda/heap/ArrayObject.h"
+#include "../rtda/heap/StrPool.h"
+#include "../jit/jit.h"
 
-bool objectAccessible(jref obj)
+using namespace std;
+
+volatile bool g_gc_requested = false;
+
+// 保护 g_gc_requested, g_all_threads 以及每个线程的 atSafepoint, cstackTop
+static pthread_mutex_t gcMutex = PTHREAD_MUTEX_INITIALIZER;
+// 线程到达 safepoint、GC 开始或结束时 broadcast
+static pthread_cond_t gcCond = PTHREAD_COND_INITIALIZER;
+
+static Thread *gcThread = nullptr; // 执行 gc_loop 的线程
+static bool collecting = false;
+
+static bool fullRequested = false; // 有线程请求了 full GC
+static size_t neededBytes = 0;     // 请求 full GC 的线程要分配的最大的对象，full GC 后放不下时整理老年代
+
+static struct {
+    size_t minorCollections = 0;
+    size_t fullCollections = 0;
+    size_t copiedBytes = 0;   // minor GC 拷贝到 survivor 块中的字节数
+    size_t promotedBytes = 0; // minor GC 晋升到老年代的字节数
+    size_t freedBytes = 0;    // full GC 在老年代中释放的字节数
+    double minorPauseMs = 0;
+    double fullPauseMs = 0;
+    // full GC 暂停时间的组成
+    double rootsMs = 0; // 扫描 GC Roots 和新生代
+    double markMs = 0;  // 并行标记
+    double sweepMs = 0;
+} stats;
+
+// 老年代的 side bitmaps, 每个 HEAP_ALIGN 粒度一个 bit
+static vector<u4> objectBits; // 对象的起始地址，一直保持有效
+static vector<u4> markBits;   // 只在 full GC 中使用
+
+// minor GC 中存放还没有扫描的存活对象，full GC 中存放 GC Roots 直接引用的对象
+static vector<Object *> markStack;
+
+typedef void (*RefVisitor)(jref *ref);
+typedef void (*ValueVisitor)(const void *value);
+
+#define SET_BIT(bits, i)  ((bits)[(i) >> 5] |= (1u << ((i) & 31)))
+#define TEST_BIT(bits, i) (((bits)[(i) >> 5] & (1u << ((i) & 31))) != 0)
+
+static inline size_t granule(const void *p)
+{
+    return ((const u1 *) p - g_heap_mgr.begin()) / HEAP_ALIGN;
+}
+
+static inline bool isObject(const void *p)
+{
+    return g_heap_mgr.contains(p)
+           && (uintptr_t) p % HEAP_ALIGN == 0
+           && TEST_BIT(objectBits, granule(p));
+}
+
+// 找到包含地址 @p 的老年代对象，向前查找最近的对象起始地址，找不到返回 nullptr
+static Object *oldObjectContaining(const void *p)
+{
+    size_t i = granule(p);
+    size_t w = i >> 5;
+    u4 bits = objectBits[w] & (~0u >> (31 - (i & 31)));
+    while (bits == 0) {
+        if (w == 0)
+            return nullptr;
+        bits = objectBits[--w];
+    }
+
+    auto o = (Object *) (g_heap_mgr.begin() + (w * 32 + 31 - __builtin_clz(bits)) * HEAP_ALIGN);
+    if ((const u1 *) p >= (u1 *) o + HEAP_ALIGN_UP(o->size()))
+        return nullptr; // @p 在空闲块中
+    return o;
+}
+
+/*
+ * 保守扫描时碰到的值 @p 所指的老年代对象或大对象，@p 可以指向对象的内部，不指向任何对象时返回 nullptr.
+ * 标记和整理时的 pin 用同样的方式解析保守的 GC Roots，被 pin 住的对象一定也被标记过。
+ */
+static const void *conservativeObject(const void *p)
+{
+    if (g_heap_mgr.contains(p))
+        return oldObjectContaining(p);
+    return g_large_objects.objectContaining(p);
+}
+
+/*
+ * 原子的设置 @p 的标记位，多个标记线程同时遇到同一个对象时只有一个能认领成功。
+ * 不在堆中的引用（null, 类对象）和不是对象起始地址的值（保守扫描时碰到的整数等）都忽略掉。
+ * 返回 @p 是否是之前没有标记过的对象。
+ */
+static inline bool claim(const void *p)
+{
+    if (!g_heap_mgr.contains(p))
+        return g_large_objects.mark(p);
+    if (!isObject(p))
+        return false;
+
+    size_t i = granule(p);
+    u4 bit = 1u << (i & 31);
+    return (__atomic_fetch_or(&markBits[i >> 5], bit, __ATOMIC_RELAXED) & bit) == 0;
+}
+
+// 保守的扫描 [begin, end) 中的每一个字
+static void scanRange(const void *begin, const void *end, ValueVisitor visit)
+{
+    auto p = (void *const *) (((uintptr_t) begin + sizeof(void *) - 1) & ~(sizeof(void *) - 1));
+    for (; (const void *) (p + 1) <= end; p++) {
+        visit(*p);
+    }
+}
+
+/*
+ * 遍历对象 @o 中所有引用类型的实例变量，或者引用数组的所有元素
+ */
+template <typename Visitor>
+static void forEachRef(Object *o, Visitor visit)
+{
+    Class *c = o->clazz;
+    if (c->isArray()) {
+        // 除了基本类型的数组外，其他都是引用类型的数组（包括多维数组）
+        if (c->className[1] == 'L' || c->className[1] == '[') {
+            auto arr = (ArrayObject *) o;
+            for (jint i = 0; i < arr->len; i++)
+                visit((jref *) arr->index(i));
+        }
+        return;
+    }
+
+    for (int off : c->refFieldOffsets) {
+        visit((jref *) ((u1 *) o->data() + off));
+    }
+}
+
+/*
+ * 栈桢和 C 栈中没有类型信息，保守的扫描其中的每一个字
+ */
+static void visitConservativeRoots(ValueVisitor visit)
+{
+    for (Thread *t : g_all_threads) {
+        // 整个局部变量表和操作数栈
+        for (Frame *f = t->topFrame; f != nullptr; f = f->prev) {
+            scanRange(f->locals, f->locals + f->method->maxLocals + f->method->maxStack, visit);
+        }
+
+        // 本地方法、虚拟机代码中的局部变量
+        if (t->atSafepoint && t->cstackBase != nullptr) {
+            assert(t->cstackTop != nullptr);
+            scanRange(t->cstackTop, t->cstackBase, visit);
+        }
+    }
+}
+
+// 供 Method 的 friend 声明使用
+void gc_visit_method(Method *m, RefVisitor visit)
 {
-    // 虚拟机栈(栈桢中的本地变量表)中的引用的对象
-    for (Thread *thread : g_all_threads) {
-        for (Frame *frame = thread->topFrame; frame != nullptr; frame = frame->prev) {
-            if (frame->objectAccessible(obj))
-                return true;
+    visit((jref *) &m->parameterTypes);
+    visit((jref *) &m->exceptionTypes);
+}
+
+static void visitClass(Class *c, RefVisitor visit)
+{
+    // 类对象（java/lang/Class）的实例变量
+    if (c->clazz != nullptr) {
+        for (int off : java_lang_Class->refFieldOffsets)
+            visit((jref *) ((u1 *) c->data() + off));
+    }
+
+    // 类正在被创建时，fields 和 methods 中可能还有 nullptr
+    for (Field *f : c->fields) {
+        if (f != nullptr && f->isStatic() && (f->descriptor[0] == 'L' || f->descriptor[0] == '['))
+            visit(&f->staticValue.r);
+    }
+
+    for (int i = 1; i < c->cp.count; i++) {
+        if (CP_TYPE(c->cp, i) == CONSTANT_ResolvedString)
+            visit(&RSLOT(c->cp.info + i));
+    }
+
+    visit(&c->enclosing.name);
+    visit(&c->enclosing.descriptor);
+
+    for (Method *m : c->methods) {
+        if (m != nullptr)
+            gc_visit_method(m, visit);
+    }
+}
+
+/*
+ * 精确的 GC Roots，GC 移动了对象后通过 @visit 更新其中的引用
+ */
+static void visitPreciseRoots(RefVisitor visit)
+{
+    for (Thread *t : g_all_threads)
+        visit(&t->jThread);
+
+    pthread_mutex_lock(&g_all_classes_mutex);
+    for (Class *c : g_all_classes)
+        visitClass(c, visit);
+    pthread_mutex_unlock(&g_all_classes_mutex);
+
+    if (g_str_pool != nullptr)
+        g_str_pool->visitRefs(visit);
+
+    visit(&sysThreadGroup);
+}
+
+/**************************************    minor GC    **************************************/
+
+static_assert(VM_TENURE_AGE >= 2, "objects must survive in the nursery at least once");
+
+// 每个年龄当前用于拷贝存活对象的 survivor 块
+static u1 *survivorTop[VM_TENURE_AGE];
+static u1 *survivorEnd[VM_TENURE_AGE];
+
+static size_t copiedBytes;
+static size_t promotedBytes;
+
+static void *allocSurvivor(size_t size, int age)
+{
+    assert(0 < age && age < VM_TENURE_AGE);
+
+    if ((size_t) (survivorEnd[age] - survivorTop[age]) < size) {
+        u1 *b = g_nursery.getSurvivorBlock((u1) age);
+        if (b == nullptr)
+            return nullptr;
+        survivorTop[age] = b;
+        survivorEnd[age] = b + Nursery::BLOCK_SIZE;
+    }
+
+    void *p = survivorTop[age];
+    survivorTop[age] += size;
+    g_nursery.markStart(p);
+    return p;
+}
+
+/*
+ * 返回新生代对象 @o 在这次 minor GC 后的地址。
+ * 第一次遇到时拷贝到 survivor 块中，或者晋升到老年代，
+ * 两者都没有空间时钉住其所在的块，原地保留。
+ */
+static Object *evacuate(Object *o)
+{
+    if (!g_nursery.contains(o))
+        return o; // null, 老年代的对象，类对象
+
+    Nursery::Block &b = g_nursery.blockOf(o);
+    if (!b.condemned)
+        return o; // 已经在 to-space 中了
+    if (g_nursery.isForwarded(o))
+        return g_nursery.forwardee(o);
+
+    if (!b.pinned) {
+        size_t size = HEAP_ALIGN_UP(o->size());
+        int age = b.age + 1;
+        void *p = nullptr;
+        bool promoted = false;
+
+        if (age < VM_TENURE_AGE)
+            p = allocSurvivor(size, age);
+        if (p == nullptr) {
+            p = gc_alloc_old(size);
+            promoted = p != nullptr;
+        }
+        if (p == nullptr && age >= VM_TENURE_AGE)
+            p = allocSurvivor(size, VM_TENURE_AGE - 1);
+
+        if (p != nullptr) {
+            auto n = (Object *) memcpy(p, o, size);
+            g_nursery.forward(o, n);
+            (promoted ? promotedBytes : copiedBytes) += size;
+            markStack.push_back(n);
+            return n;
         }
+
+        // 之前已经拷贝走的对象仍然从 mark word 中找到其新地址，
+        // 以后遇到的此块中的对象都原地保留
+        b.pinned = true;
     }
 
-    // todo
+    if (g_nursery.setLive(o))
+        markStack.push_back(o);
+    return o;
+}
+
+static void evacuateRef(jref *ref)
+{
+    *ref = evacuate(*ref);
+}
 
+/*
+ * 保守扫描到的值 @p 如果指向新生代的某个对象（包括其内部），则钉住此对象所在的块。
+ * 在拷贝任何对象之前调用。
+ */
+static void pinRef(const void *p)
+{
+    if (!g_nursery.contains(p))
+        return;
+
+    Object *o = g_nursery.objectContaining(p);
+    if (o == nullptr)
+        return;
+
+    Nursery::Block &b = g_nursery.blockOf(o);
+    assert(b.condemned);
+    b.pinned = true;
+    if (g_nursery.setLive(o))
+        markStack.push_back(o);
+}
+
+/*
+ * 更新存活对象 @o 中的引用。
+ * @o 在老年代中并且仍然引用了新生代的对象时（比如引用了钉住的块中的对象，
+ * 或者其引用的对象被拷贝到了 survivor 块），标记其所在的卡，下次 minor GC 时继续扫描。
+ */
+static void scanYoungRefs(Object *o)
+{
+    bool young = false;
+    forEachRef(o, [&young](jref *ref) {
+        *ref = evacuate(*ref);
+        young = young || g_nursery.contains(*ref);
+    });
+
+    if (young && g_heap_mgr.contains(o))
+        g_card_table.mark(o);
+}
+
+static void scanDirtyCards()
+{
+    const size_t wordsPerCard = CardTable::CARD_SIZE / HEAP_ALIGN / 32;
+    u1 *base = g_heap_mgr.begin();
+
+    for (size_t i = 0; i < g_card_table.size(); i++) {
+        if (!g_card_table.isDirty(i))
+            continue;
+
+        g_card_table.clear(i);
+        // 起始于此卡中的老年代对象
+        for (size_t w = i * wordsPerCard; w < (i + 1) * wordsPerCard && w < objectBits.size(); w++) {
+            for (u4 bits = objectBits[w]; bits != 0; bits &= bits - 1) {
+                scanYoungRefs((Object *) (base + (w * 32 + __builtin_ctz(bits)) * HEAP_ALIGN));
+            }
+        }
+    }
+}
+
+/*
+ * 返回被钉住的块数。
+ */
+static size_t minorCollect()
+{
+    copiedBytes = promotedBytes = 0;
+    for (int i = 0; i < VM_TENURE_AGE; i++)
+        survivorTop[i] = survivorEnd[i] = nullptr;
+
+    g_nursery.condemnAll();
+
+    // 先找出所有不能移动的对象，之后再开始拷贝
+    visitConservativeRoots(pinRef);
+
+    visitPreciseRoots(evacuateRef);
+    scanDirtyCards();
+
+    while (!markStack.empty()) {
+        Object *o = markStack.back();
+        markStack.pop_back();
+        scanYoungRefs(o);
+    }
+
+    return g_nursery.releaseCondemned();
+}
+
+/**************************************    full GC    **************************************/
+
+/*
+ * 并行标记
+ *
+ * 标记由执行 GC 的线程（0 号）和 gc_start_workers 创建的 GC 工作线程一起完成，
+ * 每个标记线程（Marker）有一个 Chase-Lev work-stealing deque.
+ * 1. 执行 GC 的线程扫描 GC Roots，把直接引用的对象平均分到各个 deque 中。
+ * 2. 所有标记线程从自己的 deque 中取出对象扫描，新认领（claim）的对象放进自己的 deque，
+ *    自己的 deque 空了就随机从其他线程的 deque 中窃取。
+ * 3. 所有标记线程都空闲，并且所有 deque 都为空时标记结束。
+ */
+struct Marker {
+    WorkStealingDeque<Object *> deque;
+    u4 seed = 1; // 随机选择窃取的对象
+
+    // 本次 full GC 的统计
+    size_t marked = 0; // 扫描的对象数
+    size_t steals = 0;
+    double ms = 0;
+
+    // 累计的统计
+    size_t totalMarked = 0;
+    size_t totalSteals = 0;
+    double totalMs = 0;
+};
+
+static int markerCount = 1; // 包括执行 GC 的线程
+static Marker *markers = nullptr;
+static int activeMarkers = 1; // 参与本次标记的线程数，等于 1 + 已经启动的工作线程数
+static atomic<int> idleMarkers(0);
+
+// GC 工作线程等待标记任务，执行 GC 的线程等待工作线程完成标记
+static pthread_mutex_t workerMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workerCond = PTHREAD_COND_INITIALIZER;
+static int readyWorkers = 0;
+static u4 markEpoch = 0; // 每次开始并行标记时加一
+static int finishedWorkers = 0;
+
+static void markValue(const void *p)
+{
+    if (claim(p))
+        markStack.push_back((Object *) p);
+}
+
+static void markRefAt(jref *ref)
+{
+    markValue(*ref);
+}
+
+static void markConservative(const void *p)
+{
+    const void *o = conservativeObject(p);
+    if (o != nullptr)
+        markValue(o);
+}
+
+static bool stealWork(Marker &m, Object *&o)
+{
+    for (int k = 0; k < 2 * activeMarkers; k++) {
+        m.seed = m.seed * 1103515245 + 12345;
+        Marker &victim = markers[(m.seed >> 16) % activeMarkers];
+        if (&victim != &m && victim.deque.steal(o)) {
+            m.steals++;
+            return true;
+        }
+    }
     return false;
-}
\ No newline at end of file
+}
+
+/*
+ * 当前标记线程没有任务了，等待其他线程。
+ * 所有线程都空闲时返回 true（此时只有忙碌的线程才会向 deque 中放入对象，所以所有 deque 都为空）；
+ * 发现有 deque 不为空时返回 false，继续去窃取。
+ */
+static bool offerTermination()
+{
+    idleMarkers.fetch_add(1);
+    while (true) {
+        if (idleMarkers.load() == activeMarkers)
+            return true;
+        for (int i = 0; i < activeMarkers; i++) {
+            if (!markers[i].deque.empty()) {
+                idleMarkers.fetch_sub(1);
+                return false;
+            }
+        }
+        this_thread::yield();
+    }
+}
+
+static void drain(Marker &m)
+{
+    auto start = chrono::steady_clock::now();
+    auto visit = [&m](jref *ref) {
+        if (claim(*ref))
+            m.deque.push(*ref);
+    };
+
+    Object *o;
+    do {
+        while (m.deque.pop(o) || stealWork(m, o)) {
+            forEachRef(o, visit);
+            m.marked++;
+        }
+    } while (!offerTermination());
+
+    m.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static void workerLoop(void *)
+{
+    pthread_mutex_lock(&workerMutex);
+    int id = ++readyWorkers;
+    assert(id < markerCount);
+    u4 epoch = markEpoch;
+
+    while (true) {
+        while (markEpoch == epoch)
+            pthread_cond_wait(&workerCond, &workerMutex);
+        epoch = markEpoch;
+        if (id >= activeMarkers)
+            continue; // 在这次标记开始之后才启动
+
+        pthread_mutex_unlock(&workerMutex);
+        drain(markers[id]);
+        pthread_mutex_lock(&workerMutex);
+        finishedWorkers++;
+        pthread_cond_broadcast(&workerCond);
+    }
+}
+
+static void *gcWorker(void *)
+{
+    // 工作线程只在其他线程都停止时访问堆，GC 不用等它到达 safepoint，也不用扫描它的 C 栈
+    thread_self()->cstackBase = nullptr;
+    gc_do_blocking(workerLoop, nullptr);
+    return nullptr;
+}
+
+// 从 markStack 中的对象出发，并行标记所有可达的对象
+static void parallelMark()
+{
+    pthread_mutex_lock(&workerMutex);
+    activeMarkers = 1 + readyWorkers;
+    pthread_mutex_unlock(&workerMutex);
+
+    for (int i = 0; i < activeMarkers; i++) {
+        markers[i].marked = markers[i].steals = 0;
+        markers[i].ms = 0;
+    }
+
+    // 工作线程还没有开始，可以直接放入它们的 deque
+    for (size_t i = 0; i < markStack.size(); i++)
+        markers[i % activeMarkers].deque.push(markStack[i]);
+    markStack.clear();
+    idleMarkers = 0;
+
+    pthread_mutex_lock(&workerMutex);
+    finishedWorkers = 0;
+    markEpoch++;
+    pthread_cond_broadcast(&workerCond);
+    pthread_mutex_unlock(&workerMutex);
+
+    drain(markers[0]);
+
+    pthread_mutex_lock(&workerMutex);
+    while (finishedWorkers < activeMarkers - 1)
+        pthread_cond_wait(&workerCond, &workerMutex);
+    pthread_mutex_unlock(&workerMutex);
+
+    for (int i = 0; i < activeMarkers; i++) {
+        Marker &m = markers[i];
+        m.deque.releaseRetired();
+        m.totalMarked += m.marked;
+        m.totalSteals += m.steals;
+        m.totalMs += m.ms;
+    }
+}
+
+/*
+ * 按地址顺序遍历 objectBits 中 [from, to) 这些字记录的对象，把连续的死对象合并后一次还给 HeapMgr.
+ * 返回释放的字节数。
+ *
+ * 并发清除时 Java 线程可能同时在老年代中分配对象，所以用原子操作访问 bitmap：
+ * 新对象的标记位先于起始地址设置（见 gc_alloc_old），先读起始地址再读标记位，就不会把新对象当成死对象；
+ * 死对象的起始地址在其内存归还之前清除，不会清除掉之后在这块内存中分配的对象的起始地址。
+ */
+static size_t sweepWords(size_t from, size_t to)
+{
+    size_t freed = 0;
+    u1 *base = g_heap_mgr.begin();
+    u1 *runStart = nullptr;
+    u1 *runEnd = nullptr;
+
+    auto flush = [&]() {
+        if (runStart != nullptr) {
+            g_heap_mgr.back(runStart, runEnd - runStart);
+            freed += runEnd - runStart;
+        }
+    };
+
+    for (size_t w = from; w < to; w++) {
+        u4 objects = __atomic_load_n(&objectBits[w], __ATOMIC_ACQUIRE);
+        u4 dead = objects & ~__atomic_load_n(&markBits[w], __ATOMIC_RELAXED);
+        if (dead == 0)
+            continue;
+
+        __atomic_fetch_and(&objectBits[w], ~dead, __ATOMIC_RELAXED);
+        for (u4 bits = dead; bits != 0; bits &= bits - 1) {
+            u1 *p = base + (w * 32 + __builtin_ctz(bits)) * HEAP_ALIGN;
+            auto o = (Object *) p;
+            size_t size = HEAP_ALIGN_UP(o->size());
+            o->destroy(); // 释放对象在堆外持有的资源，比如 StringObject 缓存的 utf8 字符串
+
+            if (p != runEnd) {
+                flush();
+                runStart = p;
+            }
+            runEnd = p + size;
+        }
+    }
+
+    flush();
+    return freed;
+}
+
+/**************************************    compaction    **************************************/
+
+/*
+ * 滑动整理（sliding compaction）老年代，在 full GC 清除之后执行，此时 objectBits 中的对象都是存活的。
+ *
+ * 1. 栈桢和 C 栈是保守扫描的，其中的值无法更新，它们指向（包括指向内部）的对象被钉住，不能移动。
+ * 2. 按地址顺序为其余的对象计算新地址：依次向低地址滑动，遇到被钉住的对象时跳过它，
+ *    它前面没有填满的空隙作为空闲块。地址连续并且移动距离相同的对象组成一段（Relocation），
+ *    所有的段按地址排序组成 break table，用二分查找得到旧地址对应的新地址。
+ * 3. 按地址顺序移动对象，重建 objectBits.
+ * 4. 更新所有精确的引用：老年代中的对象，新生代中的对象，GC Roots（包括常量池中的字符串），
+ *    同时重建卡表。
+ * 5. HeapMgr 中只剩下被钉住的对象前面的空隙和末尾的一整块空闲内存。
+ *
+ * 大对象空间中的对象不在老年代中，从不移动。
+ *
+ * 对象的 identity hash 保存在对象中（Object::identityHashCode），随对象一起移动。
+ */
+struct Relocation {
+    u1 *begin;    // 段中第一个对象的旧地址
+    u1 *end;
+    size_t delta; // 新地址 = 旧地址 - delta
+};
+
+static vector<Relocation> breakTable; // 只记录移动了的段
+static vector<u4> pinBits;
+
+static struct {
+    size_t compactions = 0;
+    size_t movedBytes = 0;
+    double ms = 0;
+} compactStats;
+
+/*
+ * 按地址顺序遍历老年代中的对象
+ */
+template <typename Visitor>
+static void forEachOldObject(Visitor visit)
+{
+    u1 *base = g_heap_mgr.begin();
+    for (size_t w = 0; w < objectBits.size(); w++) {
+        for (u4 bits = objectBits[w]; bits != 0; bits &= bits - 1)
+            visit((Object *) (base + (w * 32 + __builtin_ctz(bits)) * HEAP_ALIGN));
+    }
+}
+
+static void pinValue(const void *p)
+{
+    if (!g_heap_mgr.contains(p))
+        return;
+
+    Object *o = oldObjectContaining(p);
+    if (o != nullptr)
+        SET_BIT(pinBits, granule(o));
+}
+
+static Object *relocated(Object *o)
+{
+    auto it = upper_bound(breakTable.begin(), breakTable.end(), (u1 *) o,
+                          [](u1 *p, const Relocation &r) { return p < r.begin; });
+    if (it == breakTable.begin())
+        return o;
+    --it;
+    return (u1 *) o < it->end ? (Object *) ((u1 *) o - it->delta) : o;
+}
+
+// 精确的引用都指向对象的起始地址
+static void relocateRef(jref *ref)
+{
+    if (g_heap_mgr.contains(*ref))
+        *ref = relocated(*ref);
+}
+
+/*
+ * 返回移动的字节数。
+ */
+static size_t compact()
+{
+    pinBits.assign(objectBits.size(), 0);
+    visitConservativeRoots(pinValue);
+
+    // 计算新地址
+    vector<pair<u1 *, u1 *>> gaps;
+    u1 *cursor = g_heap_mgr.begin();
+    size_t moved = 0;
+    breakTable.clear();
+
+    forEachOldObject([&](Object *o) {
+        auto p = (u1 *) o;
+        size_t size = HEAP_ALIGN_UP(o->size());
+        if (TEST_BIT(pinBits, granule(p))) {
+            if (cursor < p)
+                gaps.emplace_back(cursor, p);
+            cursor = p + size;
+            return;
+        }
+
+        auto delta = (size_t) (p - cursor);
+        if (delta > 0) {
+            if (!breakTable.empty() && breakTable.back().end == p && breakTable.back().delta == delta)
+                breakTable.back().end = p + size;
+            else
+                breakTable.push_back({ p, p + size, delta });
+            moved += size;
+        }
+        cursor += size;
+    });
+
+    if (breakTable.empty())
+        return 0; // 已经是紧凑的了
+
+    // 移动对象，新地址都不高于旧地址，按地址顺序移动不会覆盖还没有移动的对象
+    vector<u4> newBits(objectBits.size(), 0);
+    forEachOldObject([&newBits](Object *o) {
+        Object *n = relocated(o);
+        if (n != o) {
+            memmove(n, o, HEAP_ALIGN_UP(o->size()));
+        }
+        size_t i = granule(n);
+        SET_BIT(newBits, i);
+    });
+    objectBits.swap(newBits);
+
+    // 更新引用。在移动之后进行，因为字符串池重建时要读取字符串（已经移动了的）的内容
+    for (size_t i = 0; i < g_card_table.size(); i++)
+        g_card_table.clear(i);
+
+    forEachOldObject([](Object *o) {
+        bool young = false;
+        forEachRef(o, [&young](jref *ref) {
+            relocateRef(ref);
+            young = young || g_nursery.contains(*ref);
+        });
+        if (young)
+            g_card_table.mark(o);
+    });
+    g_nursery.forEachObject([](Object *o) { forEachRef(o, relocateRef); });
+    visitPreciseRoots(relocateRef);
+
+    g_heap_mgr.reset();
+    for (auto &gap : gaps)
+        g_heap_mgr.back(gap.first, gap.second - gap.first);
+    g_heap_mgr.back(cursor, g_heap_mgr.begin() + g_heap_mgr.capacity() - cursor);
+
+    breakTable.clear();
+    return moved;
+}
+
+// full GC 清除之后判断是否需要整理
+static bool shouldCompact()
+{
+    size_t largest = g_heap_mgr.largestFreeBlock();
+    if (neededBytes > 0 && largest < neededBytes)
+        return g_heap_mgr.freeBytes >= neededBytes;
+    // 剩余空间很少时整理也没有多大用处
+    return g_heap_mgr.freeBytes >= g_nursery.capacity()
+           && largest * 100 < g_heap_mgr.freeBytes * (100 - VM_COMPACT_FRAGMENTATION);
+}
+
+static void timedCompact()
+{
+    auto start = chrono::steady_clock::now();
+    size_t moved = compact();
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    compactStats.compactions++;
+    compactStats.movedBytes += moved;
+    compactStats.ms += ms;
+    if (g_print_gc) {
+        printf("[GC (compact) #%zu: %zu bytes moved, largest free block: %zu of %zu bytes free, %.3f ms]\n",
+               compactStats.compactions, moved, g_heap_mgr.largestFreeBlock(), g_heap_mgr.freeBytes, ms);
+    }
+}
+
+// 最近一次 full GC 各阶段的时间
+static double lastRootsMs;
+static double lastMarkMs;
+static double lastSweepMs;
+
+/*
+ * 返回老年代中释放的字节数。
+ * 在 minor GC 之后调用，此时新生代中的对象都是存活的，作为老年代的 GC Roots.
+ */
+static size_t fullCollect()
+{
+    auto t0 = chrono::steady_clock::now();
+    // 可能有被放弃的并发周期留下的标记
+    fill(markBits.begin(), markBits.end(), 0);
+    g_large_objects.clearMarks();
+
+    visitConservativeRoots(markConservative);
+    visitPreciseRoots(markRefAt);
+    g_nursery.forEachObject([](Object *o) { forEachRef(o, markRefAt); });
+
+    auto t1 = chrono::steady_clock::now();
+    parallelMark();
+
+    auto t2 = chrono::steady_clock::now();
+    size_t freed = sweepWords(0, objectBits.size()) + g_large_objects.sweep();
+
+    auto t3 = chrono::steady_clock::now();
+    lastRootsMs = chrono::duration<double, milli>(t1 - t0).count();
+    lastMarkMs = chrono::duration<double, milli>(t2 - t1).count();
+    lastSweepMs = chrono::duration<double, milli>(t3 - t2).count();
+
+    if (shouldCompact())
+        timedCompact();
+    neededBytes = 0;
+    return freed;
+}
+
+/**************************************    concurrent mark-sweep    **************************************/
+
+/*
+ * 并发周期的各个阶段，只由 GC 线程访问。
+ * 初始标记和重新标记在暂停中执行，并发标记和并发清除由 GC 线程在 gc_loop 中分段执行，
+ * 每段之间检查是否有线程请求了 GC，所以 minor GC 可以穿插在其中。
+ */
+enum CyclePhase {
+    IDLE, MARKING, SWEEPING
+};
+
+static CyclePhase phase = IDLE;
+
+volatile bool g_satb_active = false;
+// 并发周期中在老年代分配的对象直接标记为存活
+static volatile bool allocateBlack = false;
+
+// 没有 Thread 的线程和已经退出的线程记录的旧值
+static vector<Object *> orphanSatb;
+static pthread_mutex_t satbMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// 并发标记的灰色对象（已标记，还没有扫描），和 minor GC 使用的 markStack 分开
+static vector<Object *> greyStack;
+static size_t sweepCursor; // 并发清除下一个要处理的 objectBits 中的字
+
+// 每段并发工作的大小
+static const int MARK_STEP_OBJECTS = 1024;
+static const size_t SWEEP_STEP_WORDS = 1024;
+
+static struct {
+    size_t cycles = 0;
+    size_t aborted = 0;  // 被 stop-the-world full GC 放弃的周期
+    size_t freedBytes = 0;
+    double initialMarkMs = 0;
+    double remarkMs = 0;
+    double markMs = 0;   // 并发标记
+    double sweepMs = 0;  // 并发清除
+    size_t cycleFreedBytes = 0; // 当前周期
+} concStats;
+
+void satb_enqueue(Object *old)
+{
+    Thread *self = thread_self();
+    if (self != nullptr) {
+        self->satbBuffer.push_back(old);
+        return;
+    }
+
+    pthread_mutex_lock(&satbMutex);
+    orphanSatb.push_back(old);
+    pthread_mutex_unlock(&satbMutex);
+}
+
+static void greyValue(const void *p)
+{
+    if (claim(p))
+        greyStack.push_back((Object *) p);
+}
+
+static void greyRefAt(jref *ref)
+{
+    greyValue(*ref);
+}
+
+static void greyConservative(const void *p)
+{
+    const void *o = conservativeObject(p);
+    if (o != nullptr)
+        greyValue(o);
+}
+
+// 在暂停中调用
+static void drainSatbBuffers()
+{
+    for (Thread *t : g_all_threads) {
+        for (Object *o : t->satbBuffer)
+            greyValue(o);
+        t->satbBuffer.clear();
+    }
+
+    pthread_mutex_lock(&satbMutex);
+    for (Object *o : orphanSatb)
+        greyValue(o);
+    orphanSatb.clear();
+    pthread_mutex_unlock(&satbMutex);
+}
+
+/*
+ * 在 minor GC 之后的暂停中调用，此时新生代中的对象都是存活的。
+ */
+static void initialMark()
+{
+    fill(markBits.begin(), markBits.end(), 0);
+    g_large_objects.clearMarks();
+    visitConservativeRoots(greyConservative);
+    visitPreciseRoots(greyRefAt);
+    g_nursery.forEachObject([](Object *o) { forEachRef(o, greyRefAt); });
+
+    concStats.cycleFreedBytes = 0;
+    g_satb_active = true;
+    allocateBlack = true;
+    phase = MARKING;
+}
+
+/*
+ * 扫描一段灰色对象，有线程请求了 GC 时提前返回。
+ * 返回 true 表示所有的灰色对象都已处理完。
+ */
+static bool concurrentMarkStep()
+{
+    for (int n = 0; n < MARK_STEP_OBJECTS && !greyStack.empty() && !g_gc_requested; n++) {
+        Object *o = greyStack.back();
+        greyStack.pop_back();
+        forEachRef(o, greyRefAt);
+    }
+    return greyStack.empty();
+}
+
+// 在暂停中调用
+static void remark()
+{
+    drainSatbBuffers();
+    while (!greyStack.empty()) {
+        Object *o = greyStack.back();
+        greyStack.pop_back();
+        forEachRef(o, greyRefAt);
+    }
+
+    g_satb_active = false;
+    sweepCursor = 0;
+    phase = SWEEPING;
+}
+
+/*
+ * 清除一段 objectBits, 返回 true 表示已经全部清除完。
+ */
+static bool concurrentSweepStep()
+{
+    size_t end = min(sweepCursor + SWEEP_STEP_WORDS, objectBits.size());
+    concStats.cycleFreedBytes += sweepWords(sweepCursor, end);
+    sweepCursor = end;
+    if (sweepCursor < objectBits.size())
+        return false;
+
+    concStats.cycleFreedBytes += g_large_objects.sweep();
+    // 标记位在下次周期的初始标记时清除
+    allocateBlack = false;
+    phase = IDLE;
+    return true;
+}
+
+// 在暂停中调用，放弃正在进行的并发周期，已经清除的部分仍然有效
+static void abortConcurrentCycle()
+{
+    if (phase == IDLE)
+        return;
+
+    g_satb_active = false;
+    allocateBlack = false;
+    greyStack.clear();
+    for (Thread *t : g_all_threads)
+        t->satbBuffer.clear();
+    pthread_mutex_lock(&satbMutex);
+    orphanSatb.clear();
+    pthread_mutex_unlock(&satbMutex);
+
+    phase = IDLE;
+    concStats.aborted++;
+}
+
+static bool shouldStartCycle()
+{
+    // 按最大的堆计算占用率，老年代还可以扩展时不必急于开始并发周期
+    size_t capacity = g_heap_mgr.maxCapacity();
+    size_t free = g_heap_mgr.freeBytes + capacity - g_heap_mgr.capacity();
+    free = free > g_large_objects.committedBytes ? free - g_large_objects.committedBytes : 0;
+    return free < g_nursery.capacity() || (capacity - free) * 100 >= capacity * VM_CONCURRENT_GC_OCCUPANCY;
+}
+
+/*
+ * GC 之后老年代的空闲空间太多（见 VM_HEAP_MAX_FREE_RATIO）时，把末尾未使用的内存还给操作系统，
+ * 至少保留能再容纳一次 minor GC 晋升的空间。末尾之前的空闲内存归还不了，整理（compact）之后才能归还。
+ */
+static void shrinkHeap()
+{
+    size_t capacity = g_heap_mgr.capacity();
+    size_t used = capacity - g_heap_mgr.freeBytes;
+    if (g_heap_mgr.freeBytes * 100 <= capacity * VM_HEAP_MAX_FREE_RATIO)
+        return;
+
+    size_t target = used * 100 / (100 - VM_HEAP_MAX_FREE_RATIO);
+    if (target < used + g_nursery.capacity())
+        target = used + g_nursery.capacity();
+    g_heap_mgr.shrink(target);
+    if (g_print_gc && g_heap_mgr.capacity() < capacity) {
+        printf("[GC (shrink): heap %zu -> %zu bytes]\n", capacity, g_heap_mgr.capacity());
+    }
+}
+
+/*
+ * 所有线程都已经停在了 safepoint.
+ */
+static void collect()
+{
+    auto start = chrono::steady_clock::now();
+
+    // TLAB 所在的块都要被回收，未用完的部分不再使用
+    for (Thread *t : g_all_threads)
+        t->tlab.retire();
+
+    // 线程不会停在编译后的代码中，此时可以回收代码缓存
+    jit_sweep_code_cache();
+
+    size_t pinned = minorCollect();
+
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    stats.minorCollections++;
+    stats.copiedBytes += copiedBytes;
+    stats.promotedBytes += promotedBytes;
+    stats.minorPauseMs += ms;
+
+    if (g_print_gc) {
+        printf("[GC (minor) #%zu: %zu bytes copied, %zu bytes promoted, %zu blocks pinned, %.3f ms]\n",
+               stats.minorCollections, copiedBytes, promotedBytes, pinned, ms);
+    }
+
+    if (!fullRequested) {
+        if (phase == MARKING)
+            drainSatbBuffers(); // 减少重新标记时的工作
+        if (phase != IDLE || !shouldStartCycle())
+            return;
+
+        if (gcThread != nullptr) {
+            start = chrono::steady_clock::now();
+            initialMark();
+            ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            concStats.cycles++;
+            concStats.initialMarkMs += ms;
+            if (g_print_gc)
+                printf("[GC (initial mark) #%zu: %.3f ms]\n", concStats.cycles, ms);
+            return;
+        }
+
+        // GC 线程还没有启动，没有线程来完成并发周期。
+        // 老年代的剩余空间可能不足以容纳下次 minor GC 晋升的对象
+        if (g_heap_mgr.freeBytes + g_heap_mgr.maxCapacity() - g_heap_mgr.capacity()
+            >= g_nursery.capacity() + g_large_objects.committedBytes)
+            return;
+    }
+    fullRequested = false;
+    abortConcurrentCycle();
+
+    start = chrono::steady_clock::now();
+    size_t freed = fullCollect();
+    shrinkHeap();
+
+    ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    stats.fullCollections++;
+    stats.freedBytes += freed;
+    stats.fullPauseMs += ms;
+    stats.rootsMs += lastRootsMs;
+    stats.markMs += lastMarkMs;
+    stats.sweepMs += lastSweepMs;
+
+    if (g_print_gc) {
+        printf("[GC (full) #%zu: %zu bytes freed, %zu of %zu bytes free, %.3f ms "
+               "(roots %.3f ms, mark %.3f ms, sweep %.3f ms)]\n",
+               stats.fullCollections, freed, g_heap_mgr.freeBytes, g_heap_mgr.capacity(), ms, lastRootsMs, lastMarkMs, lastSweepMs);
+        for (int i = 0; i < activeMarkers; i++) {
+            printf("  marker %d: %zu objects, %zu steals, %.3f ms\n",
+                   i, markers[i].marked, markers[i].steals, markers[i].ms);
+        }
+    }
+}
+
+// 在锁内调用，等待除 @self 和 GC 线程之外的所有线程到达 safepoint
+static void waitForSafepoints(Thread *self)
+{
+    while (true) {
+        bool stopped = true;
+        for (Thread *t : g_all_threads) {
+            if (t != self && t != gcThread && !t->atSafepoint) {
+                stopped = false;
+                break;
+            }
+        }
+        if (stopped)
+            return;
+        pthread_cond_wait(&gcCond, &gcMutex);
+    }
+}
+
+/*
+ * 以下几个函数记录 C 栈的栈顶，保守扫描从这里开始。
+ * 调用者需先执行 __builtin_unwind_init() 把寄存器都保存到自己的栈桢中，
+ * 这些函数不能被内联，保证其局部变量位于调用者栈桢的下方。
+ */
+
+// 在锁内调用，当前线程暂停，直到 GC 结束
+static void __attribute__((noinline)) park(Thread *self)
+{
+    volatile int marker = 0;
+    self->cstackTop = (void *) &marker;
+    self->atSafepoint = true;
+    pthread_cond_broadcast(&gcCond);
+
+    while (g_gc_requested)
+        pthread_cond_wait(&gcCond, &gcMutex);
+    self->atSafepoint = false;
+}
+
+// 在锁内调用，GC 线程还没有启动，在当前线程中执行 GC
+static void __attribute__((noinline)) collectInline(Thread *self)
+{
+    volatile int marker = 0;
+    self->cstackTop = (void *) &marker;
+    self->atSafepoint = true;
+    collecting = true;
+
+    waitForSafepoints(self);
+    collect();
+
+    collecting = false;
+    g_gc_requested = false;
+    self->atSafepoint = false;
+    pthread_cond_broadcast(&gcCond);
+}
+
+static void __attribute__((noinline)) doBlocking(Thread *self, void (*fn)(void *), void *arg)
+{
+    volatile int marker = 0;
+    pthread_mutex_lock(&gcMutex);
+    self->cstackTop = (void *) &marker;
+    self->atSafepoint = true;
+    pthread_cond_broadcast(&gcCond);
+    pthread_mutex_unlock(&gcMutex);
+
+    fn(arg);
+
+    pthread_mutex_lock(&gcMutex);
+    while (g_gc_requested)
+        pthread_cond_wait(&gcCond, &gcMutex);
+    self->atSafepoint = false;
+    pthread_mutex_unlock(&gcMutex);
+}
+
+void gc_safepoint()
+{
+    Thread *self = thread_self();
+    if (self == nullptr || self == gcThread)
+        return;
+
+    __builtin_unwind_init();
+    pthread_mutex_lock(&gcMutex);
+    park(self);
+    pthread_mutex_unlock(&gcMutex);
+}
+
+void gc_collect(bool full, size_t needed)
+{
+    Thread *self = thread_self();
+    assert(self != nullptr && self != gcThread);
+
+    __builtin_unwind_init();
+    pthread_mutex_lock(&gcMutex);
+    fullRequested = fullRequested || full;
+    if (full && needed > neededBytes)
+        neededBytes = needed;
+    if (g_gc_requested) {
+        // 其他线程已经请求了 GC，等它结束就可以了
+        park(self);
+    } else {
+        g_gc_requested = true;
+        if (gcThread != nullptr) {
+            park(self); // 唤醒 GC 线程并等待其结束
+        } else {
+            collectInline(self);
+        }
+    }
+    pthread_mutex_unlock(&gcMutex);
+}
+
+// 在锁内由 GC 线程调用，等所有线程都停在 safepoint 后执行 @op
+static void stopTheWorld(void (*op)())
+{
+    g_gc_requested = true;
+    collecting = true;
+    waitForSafepoints(gcThread);
+    op();
+    collecting = false;
+    g_gc_requested = false;
+    pthread_cond_broadcast(&gcCond);
+}
+
+static void timedRemark()
+{
+    auto start = chrono::steady_clock::now();
+    remark();
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    concStats.remarkMs += ms;
+    if (g_print_gc)
+        printf("[GC (remark) #%zu: %.3f ms]\n", concStats.cycles, ms);
+}
+
+void gc_loop()
+{
+    pthread_mutex_lock(&gcMutex);
+    gcThread = thread_self();
+    pthread_cond_broadcast(&gcCond);
+
+    while (true) {
+        if (g_gc_requested) {
+            // 正在进行的 GC 可能是 GC 线程启动前由其他线程发起的
+            if (collecting)
+                pthread_cond_wait(&gcCond, &gcMutex);
+            else
+                stopTheWorld(collect);
+            continue;
+        }
+
+        if (phase == IDLE) {
+            pthread_cond_wait(&gcCond, &gcMutex);
+            continue;
+        }
+
+        // 并发周期中不需要暂停的工作，执行时不持有锁，其他线程可以随时请求 GC
+        CyclePhase current = phase;
+        pthread_mutex_unlock(&gcMutex);
+        auto start = chrono::steady_clock::now();
+        bool done = current == MARKING ? concurrentMarkStep() : concurrentSweepStep();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        pthread_mutex_lock(&gcMutex);
+
+        if (current == MARKING) {
+            concStats.markMs += ms;
+            if (done && !g_gc_requested)
+                stopTheWorld(timedRemark);
+        } else {
+            concStats.sweepMs += ms;
+            if (done) {
+                concStats.freedBytes += concStats.cycleFreedBytes;
+                if (g_print_gc) {
+                    printf("[GC (concurrent sweep) #%zu: %zu bytes freed, %zu of %zu bytes free]\n",
+                           concStats.cycles, concStats.cycleFreedBytes, g_heap_mgr.freeBytes,
+                           g_heap_mgr.capacity());
+                }
+                shrinkHeap();
+            }
+        }
+    }
+}
+
+void gc_do_blocking(void (*fn)(void *), void *arg)
+{
+    assert(fn != nullptr);
+
+    Thread *self = thread_self();
+    if (self == nullptr) {
+        fn(arg);
+        return;
+    }
+
+    __builtin_unwind_init();
+    doBlocking(self, fn, arg);
+}
+
+void gc_register_thread(Thread *thread)
+{
+    assert(thread != nullptr);
+
+    pthread_mutex_lock(&gcMutex);
+    while (g_gc_requested)
+        pthread_cond_wait(&gcCond, &gcMutex);
+    g_all_threads.push_back(thread);
+    pthread_mutex_unlock(&gcMutex);
+}
+
+void gc_unregister_thread(Thread *thread)
+{
+    assert(thread != nullptr);
+
+    pthread_mutex_lock(&gcMutex);
+    // 线程已经不再访问 Java 堆了，GC 不用等它，也不用扫描它的 C 栈
+    thread->cstackBase = nullptr;
+    thread->atSafepoint = true;
+    pthread_cond_broadcast(&gcCond);
+    while (g_gc_requested)
+        pthread_cond_wait(&gcCond, &gcMutex);
+    thread->tlab.retire();
+    if (!thread->satbBuffer.empty()) {
+        pthread_mutex_lock(&satbMutex);
+        orphanSatb.insert(orphanSatb.end(), thread->satbBuffer.begin(), thread->satbBuffer.end());
+        pthread_mutex_unlock(&satbMutex);
+        thread->satbBuffer.clear();
+    }
+    for (auto iter = g_all_threads.begin(); iter != g_all_threads.end(); iter++) {
+        if (*iter == thread) {
+            g_all_threads.erase(iter);
+            break;
+        }
+    }
+    pthread_cond_broadcast(&gcCond);
+    pthread_mutex_unlock(&gcMutex);
+}
+
+void gc_init(size_t nurserySize, int parallelThreads)
+{
+    if (parallelThreads <= 0) {
+        parallelThreads = (int) thread::hardware_concurrency();
+        if (parallelThreads <= 0)
+            parallelThreads = 1;
+        if (parallelThreads > VM_MAX_PARALLEL_GC_THREADS)
+            parallelThreads = VM_MAX_PARALLEL_GC_THREADS;
+    }
+    markerCount = parallelThreads;
+    markers = new Marker[markerCount];
+    for (int i = 0; i < markerCount; i++)
+        markers[i].seed = (u4) i + 1;
+
+    g_nursery.init(nurserySize);
+    // 卡表和 bitmap 按保留的最大的堆分配，老年代扩展时不用重新分配
+    g_card_table.init(g_heap_mgr.begin(), g_heap_mgr.end());
+
+    size_t words = ((g_heap_mgr.end() - g_heap_mgr.begin()) / HEAP_ALIGN + 31) / 32;
+    objectBits.assign(words, 0);
+    markBits.assign(words, 0);
+}
+
+void gc_start_workers()
+{
+    for (int i = 1; i < markerCount; i++)
+        createVMThread(gcWorker);
+}
+
+// 老年代和大对象空间再增加 @size 字节后是否仍然不超过最大的堆
+static bool withinHeapLimit(size_t size)
+{
+    return g_heap_mgr.capacity() + g_large_objects.committedBytes + size <= g_heap_mgr.maxCapacity();
+}
+
+void *gc_alloc_old(size_t size)
+{
+    assert(!objectBits.empty());
+
+    void *p = g_heap_mgr.get(size);
+    if (p == nullptr && withinHeapLimit(size) && g_heap_mgr.expand(size))
+        p = g_heap_mgr.get(size);
+    if (p != nullptr) {
+        // 多个线程可能同时在老年代中分配相邻的对象。
+        // 并发周期中先设置标记位再记录起始地址，见 sweepWords
+        size_t i = granule(p);
+        u4 bit = 1u << (i & 31);
+        if (allocateBlack)
+            __atomic_fetch_or(&markBits[i >> 5], bit, __ATOMIC_RELAXED);
+        __atomic_fetch_or(&objectBits[i >> 5], bit, __ATOMIC_RELEASE);
+    }
+    return p;
+}
+
+void *gc_alloc_large(size_t size)
+{
+    if (!withinHeapLimit(size))
+        return nullptr;
+    return g_large_objects.alloc(size, allocateBlack);
+}
+
+void print_gc_stats()
+{
+    printf("GC statistics (nursery: %zu bytes, tenure age: %d)\n", g_nursery.capacity(), VM_TENURE_AGE);
+    printf("  minor: collections: %zu, copied: %zu bytes, promoted: %zu bytes, total pause: %.3f ms\n",
+           stats.minorCollections, stats.copiedBytes, stats.promotedBytes, stats.minorPauseMs);
+    printf("  full: collections: %zu, freed: %zu bytes, total pause: %.3f ms "
+           "(roots %.3f ms, mark %.3f ms, sweep %.3f ms)\n",
+           stats.fullCollections, stats.freedBytes, stats.fullPauseMs, stats.rootsMs, stats.markMs, stats.sweepMs);
+    for (int i = 0; i < markerCount; i++) {
+        printf("  marker %d: %zu objects, %zu steals, %.3f ms\n",
+               i, markers[i].totalMarked, markers[i].totalSteals, markers[i].totalMs);
+    }
+    printf("  %s\n", g_large_objects.toString().c_str());
+    printf("  compaction: %zu, moved: %zu bytes, total pause: %.3f ms\n",
+           compactStats.compactions, compactStats.movedBytes, compactStats.ms);
+    printf("  concurrent: cycles: %zu (%zu aborted), freed: %zu bytes, "
+           "pause: initial mark %.3f ms, remark %.3f ms, concurrent: mark %.3f ms, sweep %.3f ms\n",
+           concStats.cycles, concStats.aborted, concStats.freedBytes,
+           concStats.initialMarkMs, concStats.remarkMs, concStats.markMs, concStats.sweepMs);
+}
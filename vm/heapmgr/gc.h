@@ -6,16 +6,145 @@
 #define JVM_GC_H
 
 #include "../jtypes.h"
+#include "../kayo.h"
+#include "Nursery.h"
+#include "CardTable.h"
+#include "LargeObjectSpace.h"
+
+struct Thread;
+class Object;
 
 /*
- * 判断对象是否可达(GC Roots Analysis)
+ * Generational collector, the old generation is collected mostly concurrently
+ *
+ * 堆分为新生代（Nursery）和老年代（HeapMgr），大的基本类型数组单独放在大对象空间（LargeObjectSpace）中，
+ * 大对象空间和老年代一起回收。
+ * 所有 Java 线程停在 safepoint（方法调用、向后跳转和分配对象时检查 g_gc_requested），
+ * 或者处于不访问 Java 堆的阻塞区域（gc_do_blocking）后才开始 GC.
+ *
+ * minor GC 只回收新生代：
+ * 1. 保守的扫描栈桢和 C 栈，钉住它们引用的新生代对象所在的块。
+ * 2. 从精确的 GC Roots（见下）和卡表中的脏卡出发，把可达的新生代对象拷贝到 to-space 或者晋升到老年代，
+ *    并更新指向它们的引用。老年代的对象都认为是存活的。
+ * 3. 回收 from-space 的块。
  *
- * 可作为GC Roots对象的包括如下几种：
-    a.虚拟机栈(栈桢中的本地变量表)中的引用的对象
-    b.方法区中的类静态属性引用的对象
-    c.方法区中的常量引用的对象
-    d.本地方法栈中JNI的引用的对象
+ * 老年代通常由并发的 mark-sweep 周期回收，只有两次短暂停，其余工作由 GC 线程（gcLoop）在 Java 线程运行时完成：
+ * 1. 初始标记（暂停）：老年代的占用率达到 VM_CONCURRENT_GC_OCCUPANCY 后，在某次 minor GC 的暂停中
+ *    标记 GC Roots 和新生代中所有（刚刚存活下来的）对象直接引用的老年代对象，作为此刻对象图的快照
+ *    （snapshot-at-the-beginning, SATB）的起点。
+ *    GC Roots 包括：
+ *    a.虚拟机栈(栈桢中的本地变量表和操作数栈)中的引用的对象
+ *    b.方法区中的类静态属性引用的对象，类对象（java/lang/Class）的实例变量
+ *    c.方法区中的常量引用的对象（已解析的字符串常量），字符串池
+ *    d.本地方法栈（C 栈）中引用的对象
+ *    栈桢和 C 栈中没有类型信息，所以保守的扫描：只要一个值恰好是某个对象的起始地址，就认为它是引用。
+ *    老年代的对象不会移动，所以保守扫描是安全的。
+ *    堆中对象之间的引用是精确的：按类的引用类型实例变量（Class::refFieldOffsets）和引用数组的元素遍历。
+ * 2. 并发标记：GC 线程沿着引用标记快照中所有可达的老年代对象。
+ *    Java 线程覆盖对象中的引用前通过前写屏障（pre_write_barrier）记录旧值，保证快照中的对象不会漏标；
+ *    此期间在老年代中分配的对象（包括晋升的对象）直接标记为存活（allocate black）。
+ * 3. 重新标记（暂停）：处理所有线程记录的旧值，完成标记。
+ * 4. 并发清除：GC 线程分段把未标记的对象还给 HeapMgr，相邻的死对象合并后一起归还。
+ *
+ * 老年代的空间在并发周期完成之前就耗尽了，或者调用了 System.gc() 时，放弃正在进行的并发周期，
+ * 做一次 stop-the-world 的 full GC：先做一次 minor GC，然后对老年代做 mark-sweep，
+ * 标记由多个线程并行完成（-XX:ParallelGCThreads），每个线程有一个 work-stealing deque，
+ * 用原子操作设置标记位来认领对象，见 gc.cpp 中的 parallelMark.
+ * 清除之后如果老年代的碎片太多，把存活的对象向低地址滑动整理，见 gc.cpp 中的 compact.
+ */
+
+extern volatile bool g_gc_requested;
+
+// 检查是否有线程请求了 GC，如有，则当前线程在此暂停，直到 GC 结束
+#define SAFEPOINT_POLL() \
+    do { \
+        if (g_gc_requested) \
+            gc_safepoint(); \
+    } while (false)
+
+void gc_safepoint();
+
+/*
+ * 初始化新生代和卡表，在创建主线程之前调用。
+ * @parallelThreads: full GC 中并行标记的线程数（包括执行 GC 的线程），
+ *                   不大于 0 时使用 CPU 的个数（最多 VM_MAX_PARALLEL_GC_THREADS 个）。
+ */
+void gc_init(size_t nurserySize, int parallelThreads);
+
+/*
+ * 创建并行标记的 GC 工作线程，在主线程创建之后调用。
+ * 工作线程启动之前的 full GC 只由执行 GC 的线程标记。
+ */
+void gc_start_workers();
+
+/*
+ * 在老年代中为对象申请内存，并记录对象的起始地址。
+ * 返回的内存已经清零，老年代中没有足够的空间时返回 nullptr.
+ */
+void *gc_alloc_old(size_t size);
+
+/*
+ * 在大对象空间中为不含引用的对象申请内存，返回的内存已经清零。
+ * 老年代和大对象空间一共超过了最大的堆（-Xmx）时返回 nullptr.
+ */
+void *gc_alloc_large(size_t size);
+
+/*
+ * 写屏障，向对象 @holder 中写入引用 @value 后调用。
+ * 老年代的对象引用了新生代的对象时，把 @holder 所在的卡标记为脏。
+ * 新生代的对象和类对象（静态变量、java/lang/Class 的实例变量）每次 minor GC 都会整个扫描，无需记录。
+ */
+static inline void write_barrier(const Object *holder, const void *value)
+{
+    if (g_nursery.contains(value) && g_heap_mgr.contains(holder))
+        g_card_table.mark(holder);
+}
+
+// 并发标记期间为 true，只在暂停时修改
+extern volatile bool g_satb_active;
+
+void satb_enqueue(Object *old);
+
+/*
+ * SATB 前写屏障，覆盖对象中的引用之前用旧值 @old 调用，新生代和老年代的对象都需要。
+ * 静态变量、栈桢等 GC Roots 在初始标记时已经整个标记过了，不需要。
+ * 调用者不区分基本类型和引用类型时，碰巧等于对象地址的基本类型的值只会让这个对象多存活一个周期。
+ */
+static inline void pre_write_barrier(const void *old)
+{
+    if (g_satb_active && (g_heap_mgr.contains(old) || g_large_objects.mayContain(old)))
+        satb_enqueue((Object *) old);
+}
+
+/*
+ * 请求一次 GC 并等待其完成。
+ * 如果 GC 线程（gcLoop）已经启动则由其执行，否则在当前线程中执行。
+ *
+ * @full: 为 false 时做 minor GC，必要时开始一个并发周期（GC 线程还没有启动时做 full GC）；
+ *        为 true 时做 stop-the-world 的 full GC.
+ * @needed: 触发 full GC 的分配请求的大小。清除之后最大的空闲块仍然放不下时整理（compact）老年代，
+ *          老年代碎片太多（见 VM_COMPACT_FRAGMENTATION）时也会整理。
+ */
+void gc_collect(bool full = false, size_t needed = 0);
+
+/*
+ * GC 线程的主循环，执行其他线程请求的 GC，以及并发周期中不需要暂停的工作，不会返回。
+ */
+void gc_loop();
+
+/*
+ * 执行 @fn 期间当前线程不会访问 Java 堆（比如阻塞在锁或者 IO 上），
+ * GC 不必等待此线程到达 safepoint。
+ */
+void gc_do_blocking(void (*fn)(void *), void *arg);
+
+// 线程开始和结束时调用
+void gc_register_thread(Thread *thread);
+void gc_unregister_thread(Thread *thread);
+
+/*
+ * 打印 GC 统计（-XX:+PrintGC）
  */
-bool objectAccessible(jref obj);
+void print_gc_stats();
 
 #endif //JVM_GC_H
@@ -0,0 +1,53 @@
+/*
+ * Author: kayo
+ */
+
+#include <sstream>
+#include "InlineCache.h"
+#include "../kayo.h"
+#include "../rtda/ma/Class.h"
+#include "../rtda/ma/Method.h"
+
+using namespace std;
+
+string InlineCache::toString() const
+{
+    int n = size.load(memory_order_relaxed);
+    ostringstream oss;
+    oss << (n > VM_INLINE_CACHE_SIZE ? "megamorphic" : (n > 1 ? "polymorphic" : "monomorphic"))
+        << ", hits: " << hits << ", misses: " << misses;
+    if (n > VM_INLINE_CACHE_SIZE)
+        n = VM_INLINE_CACHE_SIZE;
+    for (int i = 0; i < n; i++) {
+        Class *receiver = entries[i].receiver.load(memory_order_relaxed);
+        if (receiver != nullptr)
+            oss << (i == 0 ? ", receivers: " : ", ") << receiver->className;
+    }
+    return oss.str();
+}
+
+void print_inline_cache_stats()
+{
+    printf("Inline cache statistics (cache size: %d)\n", VM_INLINE_CACHE_SIZE);
+
+    size_t sites = 0, hits = 0, misses = 0;
+    pthread_mutex_lock(&g_all_classes_mutex);
+    for (Class *c : g_all_classes) {
+        for (Method *m : c->methods) {
+            for (u2 i = 0; i < m->inlineCachesCount; i++) {
+                InlineCache &ic = m->inlineCaches[i];
+                if (ic.hits + ic.misses == 0)
+                    continue;
+                sites++;
+                hits += ic.hits;
+                misses += ic.misses;
+                printf("  %s.%s%s @%d -> %s.%s%s: %s\n",
+                       c->className, m->name, m->descriptor, ic.pc,
+                       ic.method->clazz->className, ic.method->name, ic.method->descriptor,
+                       ic.toString().c_str());
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_all_classes_mutex);
+    printf("  total: %zu call sites, hits: %zu, misses: %zu\n", sites, hits, misses);
+}
@@ -0,0 +1,89 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_INLINECACHE_H
+#define KAYOVM_INLINECACHE_H
+
+#include <atomic>
+#include <string>
+#include "../jtypes.h"
+#include "../config.h"
+
+class Class;
+class Method;
+
+/*
+ * invokevirtual 和 invokeinterface 调用点的内联缓存（inline cache）
+ *
+ * 每个调用点一个，缓存接收者的类型（receiver）和实际调用的方法（target）。
+ * 第一个接收者类型进入缓存后调用点是 monomorphic 的；之后遇到新的类型继续加入缓存（polymorphic），
+ * 最多 VM_INLINE_CACHE_SIZE 个；缓存满了之后再遇到新的类型，调用点成为 megamorphic，
+ * 不再加入新的项，未命中时通过 vtable（invokevirtual）或者查找接口方法（invokeinterface）分派。
+ *
+ * 类加载时（Method::parseCodeAttr）给方法中的每个调用点分配一个缓存，并把调用指令的操作数改写为缓存的下标，
+ * 原来的常量池下标保存在缓存中。此时还没有线程执行这个方法，所以操作数的改写不会和执行冲突。
+ *
+ * 多个线程可以同时查找和添加，项的 target 先于 receiver 写入，读到 receiver 时 target 已经可见。
+ * 两个线程同时为同一个类型添加时缓存中会有重复的项，不影响正确性。
+ */
+struct InlineCache {
+    u2 pc = 0;       // 调用指令在方法中的位置
+    u2 cpIndex = 0;  // 调用指令原来的操作数
+
+    // 常量池中解析出来的方法，改写为快速指令之前设置
+    Method *method = nullptr;
+
+    struct Entry {
+        std::atomic<Class *> receiver{nullptr};
+        Method *target = nullptr;
+    } entries[VM_INLINE_CACHE_SIZE];
+
+    // 已占用的项数，大于 VM_INLINE_CACHE_SIZE 表示 megamorphic
+    std::atomic<int> size{0};
+
+    // 统计（-XX:+PrintInlineCaches），不加锁，多线程时不精确
+    size_t hits = 0;
+    size_t misses = 0;
+
+    // 返回缓存的 @receiver 的 target，没有时返回 nullptr
+    Method *lookup(const Class *receiver)
+    {
+        int n = size.load(std::memory_order_relaxed);
+        if (n > VM_INLINE_CACHE_SIZE)
+            n = VM_INLINE_CACHE_SIZE;
+        for (int i = 0; i < n; i++) {
+            if (entries[i].receiver.load(std::memory_order_acquire) == receiver) {
+                hits++;
+                return entries[i].target;
+            }
+        }
+        misses++;
+        return nullptr;
+    }
+
+    // 缓存满了时不添加，并把调用点标记为 megamorphic
+    void add(Class *receiver, Method *target)
+    {
+        int i = size.load(std::memory_order_relaxed);
+        while (i < VM_INLINE_CACHE_SIZE && !size.compare_exchange_weak(i, i + 1, std::memory_order_relaxed))
+            ;
+        if (i >= VM_INLINE_CACHE_SIZE) {
+            size.store(VM_INLINE_CACHE_SIZE + 1, std::memory_order_relaxed);
+            return;
+        }
+        entries[i].target = target;
+        entries[i].receiver.store(receiver, std::memory_order_release);
+    }
+
+    bool megamorphic() const { return size.load(std::memory_order_relaxed) > VM_INLINE_CACHE_SIZE; }
+
+    std::string toString() const;
+};
+
+/*
+ * 打印所有执行过的调用点的内联缓存统计（-XX:+PrintInlineCaches）
+ */
+void print_inline_cache_stats();
+
+#endif //KAYOVM_INLINECACHE_H
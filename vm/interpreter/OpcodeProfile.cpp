@@ -0,0 +1,273 @@
+/*
+ * Author: kayo
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <pthread.h>
+#include <csignal>
+#include "OpcodeProfile.h"
+#include "interpreter.h"
+#include "../kayo.h"
+#include "../rtda/ma/Class.h"
+#include "../rtda/ma/Method.h"
+
+using namespace std;
+
+// 处理程序 -> 操作码，重复的处理程序（notused）取最小的操作码
+static unordered_map<const void *, int> handlerOpcodes;
+
+static u8 counts[OPC_SUPERINSTRUCTION_END];
+static u8 cycles[OPC_SUPERINSTRUCTION_END];
+
+// 当前线程上一条指令的操作码和分派它时的时钟
+static __thread int lastOpcode = -1;
+static __thread u8 lastTicks;
+
+static pthread_mutex_t dumpMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// 执行过指令的方法。收到信号时可能正在加载类，所以不遍历 g_all_classes
+static vector<Method *> profiledMethods;
+static pthread_mutex_t methodsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline u8 ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+#ifdef SIGUSR2
+// 收到 SIGUSR2 时写入统计。信号在所有线程中都被屏蔽，由这个线程同步地等待
+static void *dumpOnSignal(void *signals)
+{
+    int sig;
+    while (sigwait((sigset_t *) signals, &sig) == 0)
+        dump_opcode_profile();
+    return nullptr;
+}
+#endif
+
+void opcode_profile_init()
+{
+#ifdef SIGUSR2
+    static sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    pthread_t tid;
+    if (pthread_create(&tid, nullptr, dumpOnSignal, &signals) != 0)
+        jvm_abort("创建线程失败\n");
+    pthread_detach(tid);
+#endif
+}
+
+void opcode_profile_register_handlers(void *const *handlers, int count)
+{
+    assert(count == OPC_SUPERINSTRUCTION_END);
+    for (int i = 0; i < count; i++)
+        handlerOpcodes.emplace(handlers[i], i);
+}
+
+static u8 *opcode_counts(Method *m)
+{
+    u8 *mc = __atomic_load_n(&m->opcodeCounts, __ATOMIC_ACQUIRE);
+    if (mc == nullptr) {
+        auto allocated = new u8[OPC_SUPERINSTRUCTION_END]();
+        if (__atomic_compare_exchange_n(&m->opcodeCounts, &mc, allocated,
+                                        false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            mc = allocated;
+            pthread_mutex_lock(&methodsMutex);
+            profiledMethods.push_back(m);
+            pthread_mutex_unlock(&methodsMutex);
+        } else {
+            delete[] allocated;
+        }
+    }
+    return mc;
+}
+
+void profile_instruction(Method *m, const void *handler)
+{
+    u8 now = ticks();
+    auto it = handlerOpcodes.find(handler);
+    assert(it != handlerOpcodes.end());
+    int opcode = it->second;
+
+    counts[opcode]++;
+    opcode_counts(m)[opcode]++;
+
+    if (g_profile_opcode_cycles) {
+        if (lastOpcode >= 0)
+            cycles[lastOpcode] += now - lastTicks;
+        lastOpcode = opcode;
+        // 统计本身的开销不算在指令上
+        lastTicks = ticks();
+    }
+}
+
+static string json_string(const string &s)
+{
+    string r = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            r += '\\';
+            r += c;
+        } else if ((unsigned char) c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            r += buf;
+        } else {
+            r += c;
+        }
+    }
+    return r + "\"";
+}
+
+static string csv_field(const string &s)
+{
+    if (s.find_first_of(",\"\n") == string::npos)
+        return s;
+    string r = "\"";
+    for (char c : s) {
+        if (c == '"')
+            r += '"';
+        r += c;
+    }
+    return r + "\"";
+}
+
+/*
+ * 写入时的统计。写入期间其他线程仍在更新 counts 和 Method::opcodeCounts，
+ * 排序和写入都使用复制出来的这一份，保证排序时比较的结果不变。
+ */
+struct MethodCounts {
+    Method *method;
+    u8 total;
+    vector<u8> counts;
+};
+
+struct Snapshot {
+    vector<u8> counts;
+    vector<u8> cycles;
+    vector<int> opcodes; // 按执行次数从多到少排列
+    u8 total = 0;
+    vector<MethodCounts> methods; // 按执行的指令数从多到少排列
+};
+
+static void write_json(FILE *f, const Snapshot &ss)
+{
+    fprintf(f, "{\n  \"instructions\": %llu,\n", (unsigned long long) ss.total);
+    if (g_profile_opcode_cycles) {
+        u8 totalCycles = 0;
+        for (int opcode : ss.opcodes)
+            totalCycles += ss.cycles[opcode];
+        fprintf(f, "  \"cycles\": %llu,\n", (unsigned long long) totalCycles);
+    }
+
+    fprintf(f, "  \"opcodes\": [");
+    for (size_t i = 0; i < ss.opcodes.size(); i++) {
+        int opcode = ss.opcodes[i];
+        fprintf(f, "%s\n    {\"opcode\": %d, \"name\": \"%s\", \"count\": %llu",
+                i == 0 ? "" : ",", opcode, instruction_name(opcode), (unsigned long long) ss.counts[opcode]);
+        if (g_profile_opcode_cycles)
+            fprintf(f, ", \"cycles\": %llu", (unsigned long long) ss.cycles[opcode]);
+        fprintf(f, "}");
+    }
+    fprintf(f, "\n  ],\n");
+
+    fprintf(f, "  \"methods\": [");
+    for (size_t i = 0; i < ss.methods.size(); i++) {
+        const MethodCounts &mc = ss.methods[i];
+        Method *m = mc.method;
+        string name = string(m->clazz->className) + "." + m->name + m->descriptor;
+        fprintf(f, "%s\n    {\"method\": %s, \"instructions\": %llu, \"opcodes\": {",
+                i == 0 ? "" : ",", json_string(name).c_str(), (unsigned long long) mc.total);
+        const char *sep = "";
+        for (int opcode : ss.opcodes) {
+            if (mc.counts[opcode] > 0) {
+                fprintf(f, "%s\"%s\": %llu", sep, instruction_name(opcode), (unsigned long long) mc.counts[opcode]);
+                sep = ", ";
+            }
+        }
+        fprintf(f, "}}");
+    }
+    fprintf(f, "\n  ]\n}\n");
+}
+
+// 每行一种指令，总计的行 method 为 *，方法的行没有 cycles
+static void write_csv(FILE *f, const Snapshot &ss)
+{
+    fprintf(f, "method,opcode,name,count,cycles\n");
+    for (int opcode : ss.opcodes) {
+        fprintf(f, "*,%d,%s,%llu,", opcode, instruction_name(opcode), (unsigned long long) ss.counts[opcode]);
+        if (g_profile_opcode_cycles)
+            fprintf(f, "%llu", (unsigned long long) ss.cycles[opcode]);
+        fprintf(f, "\n");
+    }
+
+    for (auto &mc : ss.methods) {
+        Method *m = mc.method;
+        string name = csv_field(string(m->clazz->className) + "." + m->name + m->descriptor);
+        for (int opcode : ss.opcodes) {
+            if (mc.counts[opcode] > 0) {
+                fprintf(f, "%s,%d,%s,%llu,\n", name.c_str(), opcode,
+                        instruction_name(opcode), (unsigned long long) mc.counts[opcode]);
+            }
+        }
+    }
+}
+
+void dump_opcode_profile()
+{
+    pthread_mutex_lock(&dumpMutex);
+
+    Snapshot ss;
+    ss.counts.assign(counts, counts + OPC_SUPERINSTRUCTION_END);
+    ss.cycles.assign(cycles, cycles + OPC_SUPERINSTRUCTION_END);
+    for (int i = 0; i < OPC_SUPERINSTRUCTION_END; i++) {
+        if (ss.counts[i] > 0) {
+            ss.opcodes.push_back(i);
+            ss.total += ss.counts[i];
+        }
+    }
+    sort(ss.opcodes.begin(), ss.opcodes.end(), [&ss](int a, int b) { return ss.counts[a] > ss.counts[b]; });
+
+    pthread_mutex_lock(&methodsMutex);
+    for (Method *m : profiledMethods) {
+        MethodCounts mc { m, 0, vector<u8>(m->opcodeCounts, m->opcodeCounts + OPC_SUPERINSTRUCTION_END) };
+        for (u8 n : mc.counts)
+            mc.total += n;
+        ss.methods.push_back(move(mc));
+    }
+    pthread_mutex_unlock(&methodsMutex);
+    sort(ss.methods.begin(), ss.methods.end(), [](const MethodCounts &a, const MethodCounts &b) {
+        return a.total > b.total;
+    });
+
+    const char *path = g_profile_opcodes_file;
+    FILE *f = fopen(path, "w");
+    if (f == nullptr) {
+        printvm("can't write opcode profile to %s\n", path);
+        pthread_mutex_unlock(&dumpMutex);
+        return;
+    }
+
+    size_t len = strlen(path);
+    if (len >= 4 && strcmp(path + len - 4, ".csv") == 0)
+        write_csv(f, ss);
+    else
+        write_json(f, ss);
+    fclose(f);
+
+    pthread_mutex_unlock(&dumpMutex);
+}
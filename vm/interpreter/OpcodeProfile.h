@@ -0,0 +1,48 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_OPCODEPROFILE_H
+#define KAYOVM_OPCODEPROFILE_H
+
+#include "../jtypes.h"
+
+class Method;
+
+/*
+ * 指令的执行统计（-XX:+ProfileOpcodes）
+ *
+ * 打开时解释器使用另一份处理程序表（见 interpreter.cpp 中的 ProfilePolicy），每条指令分派之前调用 profile_instruction，
+ * 记录每种指令的执行次数和每个方法中每种指令的执行次数（Method::opcodeCounts）。
+ * 指令按处理程序区分，快速指令和超级指令单独计数。关闭时使用的解释器中没有任何统计的代码。
+ *
+ * -XX:+ProfileOpcodeCycles 同时记录每种指令占用的时钟周期（x86 上是 rdtsc，其他平台是纳秒）：
+ * 一条指令从分派到下一条指令分派之间的时间都算在它上面，所以调用本地方法、等待锁、进入 safepoint
+ * 的时间也算在当时执行的指令上。
+ *
+ * 统计不加锁，多线程时不精确。统计期间不使用 JIT，编译后的代码执行的指令不会被统计到。
+ * 虚拟机退出时，以及收到 SIGUSR2 时，把统计写入 -XX:ProfileOpcodesFile 指定的文件，
+ * 文件名以 .csv 结尾时写 CSV，否则写 JSON.
+ */
+
+/*
+ * 在创建其他线程之前调用
+ */
+void opcode_profile_init();
+
+/*
+ * 登记解释器的处理程序，@handlers 按操作码排列，共 @count 个
+ */
+void opcode_profile_register_handlers(void *const *handlers, int count);
+
+/*
+ * 方法 @m 将要执行处理程序为 @handler 的指令
+ */
+void profile_instruction(Method *m, const void *handler);
+
+/*
+ * 把统计写入文件
+ */
+void dump_opcode_profile();
+
+#endif //KAYOVM_OPCODEPROFILE_H
@@ -0,0 +1,275 @@
+/*
+ * Author: kayo
+ */
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include "ThreadedCode.h"
+#include "interpreter.h"
+#include "../debug.h"
+#include "../config.h"
+#include "../rtda/ma/Method.h"
+
+using namespace std;
+
+static inline u2 read_u2(const u1 *p)
+{
+    return (u2) (p[0] << 8 | p[1]);
+}
+
+static inline s4 read_s4(const u1 *p)
+{
+    return (s4) ((u4) p[0] << 24 | (u4) p[1] << 16 | (u4) p[2] << 8 | p[3]);
+}
+
+/*
+ * 超级指令和它执行的指令序列（规范形式，见 canonical），不足 3 条的以 0 结尾，按顺序选择第一个匹配的。
+ * 序列从 PROFILE_NGRAMS 打印的统计中挑选，每个超级指令在 exec 中有对应的处理程序。
+ */
+static const struct {
+    int super;
+    u1 opcodes[3];
+} superinstructions[] = {
+    { OPC_ILOAD_ILOAD_IF_ICMPEQ, { OPC_ILOAD, OPC_ILOAD, OPC_IF_ICMPEQ } },
+    { OPC_ILOAD_ILOAD_IF_ICMPNE, { OPC_ILOAD, OPC_ILOAD, OPC_IF_ICMPNE } },
+    { OPC_ILOAD_ILOAD_IF_ICMPLT, { OPC_ILOAD, OPC_ILOAD, OPC_IF_ICMPLT } },
+    { OPC_ILOAD_ILOAD_IF_ICMPGE, { OPC_ILOAD, OPC_ILOAD, OPC_IF_ICMPGE } },
+    { OPC_ILOAD_ILOAD_IF_ICMPGT, { OPC_ILOAD, OPC_ILOAD, OPC_IF_ICMPGT } },
+    { OPC_ILOAD_ILOAD_IF_ICMPLE, { OPC_ILOAD, OPC_ILOAD, OPC_IF_ICMPLE } },
+    { OPC_IINC_GOTO,             { OPC_IINC, OPC_GOTO } },
+    { OPC_ALOAD_GETFIELD,        { OPC_ALOAD, OPC_GETFIELD } },
+    { OPC_ALOAD_ARRAYLENGTH,     { OPC_ALOAD, OPC_ARRAYLENGTH } },
+};
+
+// 超级指令中的 iload_<n> 和 aload_<n> 翻译为 iload n 和 aload n
+static inline u1 canonical(u1 opcode)
+{
+    if (OPC_ILOAD_0 <= opcode && opcode <= OPC_ILOAD_0 + 3)
+        return OPC_ILOAD;
+    if (OPC_ALOAD_0 <= opcode && opcode <= OPC_ALOAD_0 + 3)
+        return OPC_ALOAD;
+    return opcode;
+}
+
+/*
+ * 从 @pc 开始的指令序列是否可以由一条超级指令执行，
+ * 可以则返回超级指令，并把序列中指令的条数存入 @count，否则返回 -1.
+ */
+static int match_superinstruction(const u1 *code, size_t codeLen, size_t pc, int *count)
+{
+    for (auto &s : superinstructions) {
+        size_t p = pc;
+        int n = 0;
+        while (n < 3 && s.opcodes[n] != 0) {
+            if (p >= codeLen || canonical(code[p]) != s.opcodes[n])
+                break;
+            p += bytecode_length(code, p);
+            n++;
+        }
+        if (n == 3 || s.opcodes[n] == 0) {
+            *count = n;
+            return s.super;
+        }
+    }
+    return -1;
+}
+
+ThreadedCode::ThreadedCode(const Method *m, void *const *handlers)
+{
+    const u1 *code = m->code;
+    size_t codeLen = m->codeLen;
+
+    vector<Cell> out;
+    vector<u4> outPcs;
+    // 每条指令的第一个单元的位置，按字节码的 pc 索引
+    vector<size_t> cellIndex(codeLen, SIZE_MAX);
+    // 跳转目标还不知道的单元，先把目标的 pc 记在其中，翻译完后再解析
+    vector<size_t> branches;
+
+    size_t pc = 0;
+    auto emit = [&](intptr_t i) {
+        Cell c;
+        c.i = i;
+        out.push_back(c);
+        outPcs.push_back((u4) pc);
+    };
+    // 超级指令替换序列中第一条指令的处理程序，为 -1 时不替换
+    int super = -1;
+    // 当前超级指令的序列中还没有翻译的指令的条数
+    int fusing = 0;
+    auto emitHandler = [&](u1 opcode) {
+        Cell c;
+        c.handler = handlers[super >= 0 ? super : opcode];
+        super = -1;
+        out.push_back(c);
+        outPcs.push_back((u4) pc);
+    };
+    auto emitBranch = [&](s4 offset) {
+        branches.push_back(out.size());
+        emit((intptr_t) pc + offset);
+    };
+
+    for (; pc < codeLen; pc += bytecode_length(code, pc)) {
+        cellIndex[pc] = out.size();
+        u1 opcode = code[pc];
+        const u1 *operands = code + pc + 1;
+
+#if !PROFILE_NGRAMS
+        // PROFILE_NGRAMS 统计的是原始的指令序列，不生成超级指令
+        if (fusing == 0)
+            super = match_superinstruction(code, codeLen, pc, &fusing);
+#endif
+        if (fusing > 0) {
+            fusing--;
+            u1 c = canonical(opcode);
+            if (c != opcode) {
+                emitHandler(c);
+                emit(opcode - (c == OPC_ILOAD ? OPC_ILOAD_0 : OPC_ALOAD_0));
+                continue;
+            }
+        }
+
+        switch (opcode) {
+            case OPC_BIPUSH:
+                emitHandler(opcode);
+                emit((s1) operands[0]);
+                break;
+            case OPC_SIPUSH:
+                emitHandler(opcode);
+                emit((s2) read_u2(operands));
+                break;
+            case OPC_LDC:
+            case OPC_ILOAD: case OPC_LLOAD: case OPC_FLOAD: case OPC_DLOAD: case OPC_ALOAD:
+            case OPC_ISTORE: case OPC_LSTORE: case OPC_FSTORE: case OPC_DSTORE: case OPC_ASTORE:
+            case OPC_RET:
+            case OPC_NEWARRAY:
+                emitHandler(opcode);
+                emit(operands[0]);
+                break;
+            case OPC_IINC:
+                emitHandler(opcode);
+                emit(operands[0]);
+                emit((s1) operands[1]);
+                break;
+            case OPC_IFEQ: case OPC_IFNE: case OPC_IFLT: case OPC_IFGE: case OPC_IFGT: case OPC_IFLE:
+            case OPC_IF_ICMPEQ: case OPC_IF_ICMPNE: case OPC_IF_ICMPLT:
+            case OPC_IF_ICMPGE: case OPC_IF_ICMPGT: case OPC_IF_ICMPLE:
+            case OPC_IF_ACMPEQ: case OPC_IF_ACMPNE:
+            case OPC_GOTO: case OPC_JSR:
+            case OPC_IFNULL: case OPC_IFNONNULL:
+                emitHandler(opcode);
+                emitBranch((s2) read_u2(operands));
+                break;
+            case OPC_GOTO_W:
+                emitHandler(OPC_GOTO);
+                emitBranch(read_s4(operands));
+                break;
+            case OPC_JSR_W:
+                emitHandler(OPC_JSR);
+                emitBranch(read_s4(operands));
+                break;
+            case OPC_TABLESWITCH: {
+                // 操作数从方法开始按 4 字节对齐
+                const u1 *p = code + ((pc + 4) & ~(size_t) 3);
+                s4 low = read_s4(p + 4);
+                s4 high = read_s4(p + 8);
+                emitHandler(opcode);
+                emitBranch(read_s4(p));
+                emit(low);
+                emit(high);
+                for (s4 i = 0; i < high - low + 1; i++)
+                    emitBranch(read_s4(p + 12 + i * 4));
+                break;
+            }
+            case OPC_LOOKUPSWITCH: {
+                const u1 *p = code + ((pc + 4) & ~(size_t) 3);
+                s4 defaultOffset = read_s4(p);
+                s4 npairs = read_s4(p + 4);
+
+                // (key, offset)，按 key 排序并去掉重复的 key（保留第一个），解释器按二分查找
+                vector<pair<s4, s4>> pairs;
+                for (s4 i = 0; i < npairs; i++)
+                    pairs.emplace_back(read_s4(p + 8 + i * 8), read_s4(p + 12 + i * 8));
+                stable_sort(pairs.begin(), pairs.end(),
+                            [](const pair<s4, s4> &a, const pair<s4, s4> &b) { return a.first < b.first; });
+                pairs.erase(unique(pairs.begin(), pairs.end(),
+                                   [](const pair<s4, s4> &a, const pair<s4, s4> &b) { return a.first == b.first; }),
+                            pairs.end());
+
+                int64_t low = pairs.empty() ? 0 : pairs.front().first;
+                int64_t high = pairs.empty() ? -1 : pairs.back().first;
+                if (!pairs.empty() && high - low + 1 <= (int64_t) pairs.size() * VM_LOOKUPSWITCH_DENSITY) {
+                    // key 足够稠密，翻译为 tableswitch，直接索引
+                    emitHandler(OPC_TABLESWITCH);
+                    emitBranch(defaultOffset);
+                    emit((s4) low);
+                    emit((s4) high);
+                    size_t k = 0;
+                    for (int64_t key = low; key <= high; key++)
+                        emitBranch(pairs[k].first == key ? pairs[k++].second : defaultOffset);
+                    break;
+                }
+
+                emitHandler(opcode);
+                emitBranch(defaultOffset);
+                emit((intptr_t) pairs.size());
+                for (auto &e : pairs) {
+                    emit(e.first);
+                    emitBranch(e.second);
+                }
+                break;
+            }
+            case OPC_WIDE:
+                // 展开为带 u2 下标的普通指令
+                emitHandler(operands[0]);
+                emit(read_u2(operands + 1));
+                if (operands[0] == OPC_IINC)
+                    emit((s2) read_u2(operands + 3));
+                break;
+            case OPC_INVOKEVIRTUAL:
+            case OPC_INVOKEINTERFACE: {
+                // 操作数是内联缓存的下标，见 Method::createInlineCaches
+                emitHandler(opcode);
+                Cell c;
+                c.ic = m->inlineCaches + read_u2(operands);
+                out.push_back(c);
+                outPcs.push_back((u4) pc);
+                break;
+            }
+            case OPC_MULTIANEWARRAY:
+                emitHandler(opcode);
+                emit(read_u2(operands));
+                emit(operands[2]);
+                break;
+            default:
+                // 其余指令没有操作数，或者只有一个 u2 的常量池下标（invokedynamic 后面还有两个 0）
+                emitHandler(opcode);
+                if (bytecode_length(code, pc) > 1) {
+                    assert(bytecode_length(code, pc) == 3 || opcode == OPC_INVOKEDYNAMIC);
+                    emit(read_u2(operands));
+                }
+                break;
+        }
+    }
+
+    length = out.size();
+    cells = new Cell[length];
+    pcs = new u4[length];
+    copy(out.begin(), out.end(), cells);
+    copy(outPcs.begin(), outPcs.end(), pcs);
+
+    for (size_t i : branches) {
+        auto target = (size_t) cells[i].i;
+        assert(target < codeLen && cellIndex[target] != SIZE_MAX);
+        cells[i].target = cells + cellIndex[target];
+    }
+}
+
+Cell *ThreadedCode::cellAt(size_t pc) const
+{
+    // pcs 是递增的，第一个不小于 @pc 的单元就是此指令的处理程序
+    u4 *p = lower_bound(pcs, pcs + length, (u4) pc);
+    assert(p != pcs + length && *p == pc);
+    return cells + (p - pcs);
+}
@@ -0,0 +1,76 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_THREADEDCODE_H
+#define KAYOVM_THREADEDCODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "../jtypes.h"
+
+class Method;
+struct InlineCache;
+
+/*
+ * 线索码（direct-threaded code）的一个单元，一条指令由处理程序的地址和其后的若干个操作数组成。
+ * 每个单元都是一个字，操作数已经解码并对齐，解释器不必逐字节的读取和拼接。
+ */
+union Cell {
+    void *handler;        // 指令的处理程序，即 exec 中 labels 的元素
+    intptr_t i;           // 立即数、局部变量的下标、常量池的下标、字段访问的快速指令的操作数
+    Cell *target;         // 跳转的目标
+    InlineCache *ic;      // invokevirtual 和 invokeinterface 调用点的内联缓存
+};
+
+/*
+ * 方法的线索码
+ *
+ * 方法第一次执行时由字节码翻译而来（见 exec），解释器直接从中取出处理程序的地址跳转，
+ * 操作数在翻译时解码：
+ * 1. 跳转指令的偏移量解析为目标指令的地址；
+ * 2. tableswitch 和 lookupswitch 的跳转表展开为 [default, low, high, targets...] 和 [default, npairs, (key, target)...]，
+ *    lookupswitch 的 key 按升序排列；key 足够稠密（见 VM_LOOKUPSWITCH_DENSITY）的 lookupswitch 翻译为 tableswitch；
+ * 3. wide 展开为带宽下标的普通指令，goto_w 翻译为 goto；
+ * 4. invokevirtual 和 invokeinterface 的操作数是内联缓存的地址，invokeinterface 丢掉了 count 和 0 两个字节；
+ * 5. 其余指令的操作数按原来的顺序每个占一个单元；
+ * 6. 常见的指令序列由超级指令执行（见 interpreter.h），序列中第一条指令的处理程序换成超级指令。
+ *
+ * 快速指令改写处理程序所在的单元（见 interpreter.cpp 中的 QUICKEN），可以改写的指令都只有一个操作数。
+ * 方法调用的快速指令的操作数仍然是常量池下标；字段访问的快速指令的操作数先改写为字段的偏移或者 Field *，
+ * 再发布新的处理程序（见 QUICKEN_WITH_OPERAND）.
+ *
+ * 原来的字节码保留在 Method::code 中，异常处理表和行号表仍然按字节码的 pc 查找，
+ * pcs 记录每个单元所属指令的 pc.
+ */
+class ThreadedCode {
+public:
+    Cell *cells = nullptr;
+    u4 *pcs = nullptr;
+    size_t length = 0;
+
+    /*
+     * 翻译 @m 的字节码，@handlers 是按操作码排列的处理程序，其后是超级指令的处理程序
+     */
+    ThreadedCode(const Method *m, void *const *handlers);
+
+    ThreadedCode(const ThreadedCode &) = delete;
+    ThreadedCode &operator=(const ThreadedCode &) = delete;
+
+    ~ThreadedCode()
+    {
+        delete[] cells;
+        delete[] pcs;
+    }
+
+    // @cell 所属的指令在字节码中的 pc
+    size_t pcOf(const Cell *cell) const
+    {
+        return pcs[cell - cells];
+    }
+
+    // 字节码中从 @pc 开始的指令的第一个单元
+    Cell *cellAt(size_t pc) const;
+};
+
+#endif //KAYOVM_THREADEDCODE_H
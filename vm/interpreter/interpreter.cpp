@@ -4,6 +4,9 @@
 
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
 #include "../kayo.h"
 #include "../debug.h"
 #include "../rtda/thread/Thread.h"
@@ -11,9 +14,15 @@
 #include "../rtda/heap/StrPool.h"
 #include "../classfile/constant.h"
 #include "../rtda/heap/ArrayObject.h"
+#include "../rtda/ma/ArrayClass.h"
 #include "../rtda/ma/Field.h"
 #include "../rtda/ma/resolve.h"
+#include "../heapmgr/gc.h"
 #include "interpreter.h"
+#include "InlineCache.h"
+#include "ThreadedCode.h"
+#include "OpcodeProfile.h"
+#include "../jit/jit.h"
 #include "../symbol.h"
 
 using namespace std;
@@ -24,163 +33,114 @@ using namespace std;
 #define TRACE(...)
 #endif
 
-#if TRACE_INTERPRETER
+// opcodes.h 中的表必须按操作码从 0 开始连续排列，以下按操作码索引的数组才能由表直接生成
+static constexpr int table_opcodes[] = {
+#define OPCODE_CODE(code, ...) code,
+#define OPCODE_CODE_UNUSED(code) code,
+        BYTECODES(OPCODE_CODE, OPCODE_CODE_UNUSED)
+        SUPERINSTRUCTIONS(OPCODE_CODE)
+#undef OPCODE_CODE
+#undef OPCODE_CODE_UNUSED
+};
+
+static constexpr bool is_dense(int i = 0)
+{
+    return i == OPC_SUPERINSTRUCTION_END || (table_opcodes[i] == i && is_dense(i + 1));
+}
+static_assert(sizeof(table_opcodes) / sizeof(*table_opcodes) == OPC_SUPERINSTRUCTION_END && is_dense(),
+              "opcodes.h must list every opcode in order");
+
 // the mapping of instructions's code and name
 static const char *instruction_names[] = {
-        "nop",
-
-        // Constants [0x01 ... 0x14]
-        "aconst_null",
-        "iconst_m1", "iconst_0", "iconst_1", "iconst_2", "iconst_3", "iconst_4", "iconst_5",
-        "lconst_0", "lconst_1",
-        "fconst_0", "fconst_1", "fconst_2",
-        "dconst_0", "dconst_1",
-        "bipush", "sipush",
-        "ldc", "ldc_w", "ldc2_w",
-
-        // Loads [0x15 ... 0x35]
-        "iload", "lload", "fload", "dload", "aload",
-        "iload_0", "iload_1", "iload_2", "iload_3",
-        "lload_0", "lload_1", "lload_2", "lload_3",
-        "fload_0", "fload_1", "fload_2", "fload_3",
-        "dload_0", "dload_1", "dload_2", "dload_3",
-        "aload_0", "aload_1", "aload_2", "aload_3",
-        "iaload", "laload", "faload", "daload", "aaload", "baload", "caload", "saload",
-
-        // Stores [0x36 ... 0x56]
-        "istore", "lstore", "fstore", "dstore", "astore",
-        "istore_0", "istore_1", "istore_2", "istore_3",
-        "lstore_0", "lstore_1", "lstore_2", "lstore_3",
-        "fstore_0", "fstore_1", "fstore_2", "fstore_3",
-        "dstore_0", "dstore_1", "dstore_2", "dstore_3",
-        "astore_0", "astore_1", "astore_2", "astore_3",
-        "iastore", "lastore", "fastore", "dastore", "aastore", "bastore", "castore", "sastore",
-
-        // Stack [0x57 ... 0x5f]
-        "pop", "pop2", "dup", "dup_x1", "dup_x2", "dup2", "dup2_x1", "dup2_x2", "swap",
-
-        // Math [0x60 ... 0x84]
-        "iadd", "ladd", "fadd", "dadd",
-        "isub", "lsub", "fsub", "dsub",
-        "imul", "lmul", "fmul", "dmul",
-        "idiv", "ldiv", "fdiv", "ddiv",
-        "irem", "lrem", "frem", "drem",
-        "ineg", "lneg", "fneg", "dneg",
-        "ishl", "lshl", "ishr", "lshr", "iushr", "lushr",
-        "iand", "land", "ior", "lor", "ixor", "lxor", "iinc",
-
-        // Conversions [0x85 ... 0x93]
-        "i2l", "i2f", "i2d",
-        "l2i", "l2f", "l2d",
-        "f2i", "f2l", "f2d",
-        "d2i", "d2l", "d2f",
-        "i2b", "i2c", "i2s",
-
-        // Comparisons [0x94 ... 0xa6]
-        "lcmp", "fcmpl", "fcmpg", "dcmpl", "dcmpg",
-        "ifeq", "ifne", "iflt", "ifge", "ifgt", "ifle",
-        "if_icmpeq", "if_icmpne", "if_icmplt", "if_icmpge", "if_icmpgt", "if_icmple",
-        "if_acmpeq", "if_acmpne",
-
-        // Control [0xa7 ... 0xb1]
-        "goto", "jsr", "ret", "tableswitch", "lookupswitch",
-        "ireturn", "lreturn", "freturn", "dreturn","areturn", "return",
-
-        // References [0xb2 ... 0xc3]
-        "getstatic", "putstatic", "getfield", "putfield",
-        "invokevirtual", "invokespecial", "invokestatic", "invokeinterface", "invokedynamic",
-        "new", "newarray", "anewarray", "arraylength",
-        "athrow", "checkcast", "instanceof", "monitorenter", "monitorexit",
-
-        // Extended [0xc4 ... 0xc9]
-        "wide", "multianewarray", "ifnull", "ifnonnull", "goto_w", "jsr_w",
-
-        // Reserved [0xca ... 0xff]
-        "breakpoint",
-        "notused", "notused", "notused", "notused", "notused", // [0xcb ... 0xcf]
-        "notused", "notused", "notused", "notused", "notused", "notused", "notused", "notused", // [0xd0 ... 0xd7]
-        "notused", "notused", "notused", "notused", "notused", "notused", "notused", "notused", // [0xd8 ... 0xdf]
-        "notused", "notused", "notused", "notused", "notused", "notused", "notused", "notused", // [0xe0 ... 0xe7]
-        "notused", "notused", "notused", "notused", "notused", "notused", "notused", "notused", // [0xe8 ... 0xef]
-        "notused", "notused", "notused", "notused", "notused", "notused", "notused", "notused", // [0xf0 ... 0xf7]
-        "notused", "notused", "notused", "notused", "notused", "notused", // [0xf8 ... 0xfd]
-        "invokenative", "impdep2"
+#define OPCODE_NAME(code, NAME, name, ...) #name,
+#define OPCODE_NAME_UNUSED(code) "notused",
+        BYTECODES(OPCODE_NAME, OPCODE_NAME_UNUSED)
+        SUPERINSTRUCTIONS(OPCODE_NAME)
+#undef OPCODE_NAME
+#undef OPCODE_NAME_UNUSED
 };
-#endif
+static_assert(sizeof(instruction_names) / sizeof(*instruction_names) == OPC_SUPERINSTRUCTION_END, "instruction_names");
+
+const char *instruction_name(int opcode)
+{
+    assert(0 <= opcode && opcode < OPC_SUPERINSTRUCTION_END);
+    return instruction_names[opcode];
+}
+
+
+// 指令的长度（包括操作码），0 表示长度不固定（tableswitch, lookupswitch, wide）
+static const u1 instruction_lengths[] = {
+#define OPCODE_LENGTH(code, NAME, name, length) length,
+#define OPCODE_LENGTH_UNUSED(code) 1,
+        BYTECODES(OPCODE_LENGTH, OPCODE_LENGTH_UNUSED)
+#undef OPCODE_LENGTH
+#undef OPCODE_LENGTH_UNUSED
+};
+
+static_assert(sizeof(instruction_lengths) == 256, "one length per opcode");
+
+size_t bytecode_length(const u1 *code, size_t pc)
+{
+    u1 opcode = code[pc];
+    if (instruction_lengths[opcode] != 0)
+        return instruction_lengths[opcode];
+
+    if (opcode == OPC_WIDE)
+        return code[pc + 1] == OPC_IINC ? 6 : 4;
 
+    // tableswitch 和 lookupswitch 的操作数从方法开始按 4 字节对齐
+    size_t p = (pc + 4) & ~(size_t) 3;
+    auto reads4 = [=](size_t i) {
+        return (s4) ((u4) code[i] << 24 | (u4) code[i + 1] << 16 | (u4) code[i + 2] << 8 | code[i + 3]);
+    };
+    if (opcode == OPC_TABLESWITCH) {
+        s4 low = reads4(p + 4);
+        s4 high = reads4(p + 8);
+        return p + 12 + (high - low + 1) * 4 - pc;
+    }
+    assert(opcode == OPC_LOOKUPSWITCH);
+    s4 npairs = reads4(p + 4);
+    return p + 8 + npairs * 8 - pc;
+}
 
 /*
- * todo 指令说明  好像是实现 switch 语句
+ * 实现 switch 语句，case 的值是连续的。
+ * 操作数在翻译时已经展开为 [default, low, high, targets...]（见 ThreadedCode），返回跳转的目标。
  */
-static void tableswitch(Frame *frame)
+static Cell *tableswitch(jint index, const Cell *operands)
 {
-    BytecodeReader &reader = frame->reader;
-    size_t saved_pc = reader.pc - 1; // save the pc before 'tableswitch' instruction
-    reader.align4();
-
-    // 默认情况下执行跳转所需字节码的偏移量
-    // 对应于 switch 中的 default 分支。
-    s4 default_offset = reader.reads4();
-
-    // low 和 height 标识了 case 的取值范围。
-    s4 low = reader.reads4();
-    s4 height = reader.reads4();
-
-    // 跳转偏移量表，对应于各个 case 的情况
-    s4 jump_offset_count = height - low + 1;
-    s4 jump_offsets[jump_offset_count];
-    reader.reads4s(jump_offset_count, jump_offsets);
-
-    // 弹出要判断的值
-    jint index = frame->popi();
-    s4 offset;
-    if (index < low || index > height) {
-        offset = default_offset; // 没在 case 标识的范围内，跳转到 default 分支。
-    } else {
-        offset = jump_offsets[index - low]; // 找到对应的case了
-    }
+    // low 和 high 标识了 case 的取值范围。
+    intptr_t low = operands[1].i;
+    intptr_t high = operands[2].i;
 
-    // The target address that can be calculated from each jump table
-    // offset, as well as the one that can be calculated from default,
-    // must be the address of an opcode of an instruction within the method
-    // that contains this tableswitch instruction.
-    reader.pc = saved_pc + offset;
+    if (index < low || index > high) {
+        return operands[0].target; // 没在 case 标识的范围内，跳转到 default 分支。
+    }
+    return operands[3 + index - low].target; // 找到对应的case了
 }
 
 /*
- * todo 指令说明  好像是实现 switch 语句
+ * 实现 switch 语句，case 的值是稀疏的。
+ * 操作数在翻译时已经展开为 [default, npairs, (key, target)...]，key 按升序排列，二分查找，返回跳转的目标。
  */
-static void lookupswitch(Frame *frame)
+static Cell *lookupswitch(jint key, const Cell *operands)
 {
-    BytecodeReader &reader = frame->reader;
-    size_t saved_pc = reader.pc - 1; // save the pc before 'lookupswitch' instruction
-    reader.align4();
-
-    // 默认情况下执行跳转所需字节码的偏移量
-    // 对应于 switch 中的 default 分支。
-    s4 default_offset = reader.reads4();
-
-    // case的个数
-    s4 npairs = reader.reads4();
-    assert(npairs >= 0); // The npairs must be greater than or equal to 0.
-
-    // match_offsets 有点像 Map，它的 key 是 case 值，value 是跳转偏移量。
-    s4 match_offsets[npairs * 2];
-    reader.reads4s(npairs * 2, match_offsets);
-
-    // 弹出要判断的值
-    jint key = frame->popi();
-    s4 offset = default_offset;
-    for (int i = 0; i < npairs * 2; i += 2) {
-        if (match_offsets[i] == key) { // 找到 case
-            offset = match_offsets[i + 1];
-            break;
+    const Cell *pairs = operands + 2;
+    intptr_t low = 0;
+    intptr_t high = operands[1].i - 1;
+
+    while (low <= high) {
+        intptr_t mid = (low + high) >> 1;
+        intptr_t k = pairs[2 * mid].i;
+        if (k == key) { // 找到 case
+            return pairs[2 * mid + 1].target;
         }
+        if (k < key)
+            low = mid + 1;
+        else
+            high = mid - 1;
     }
-
-    // The target address is calculated by adding the corresponding offset
-    // to the address of the opcode of this lookupswitch instruction.
-    reader.pc = saved_pc + offset;
+    return operands[0].target;
 }
 
 // extended instructions -----------------------------------------------------------------------------------------------
@@ -188,24 +148,20 @@ static void lookupswitch(Frame *frame)
  * 创建多维数组
  * todo 注意这种情况，基本类型的多维数组 int[][][]
  */
-static void multianewarray(Frame *frame)
+static jref multianewarray(Class *curr_class, int index, int arr_dim /* 多维数组的维度 */, const slot_t *dims)
 {
-    Class *curr_class = frame->method->clazz;
-    int index = frame->reader.readu2();
     const char *class_name = CP_UTF8(curr_class->cp, index); // 这里解析出来的直接就是数组类。
 
-    auto arr_dim = frame->reader.readu1(); // 多维数组的维度
-    size_t arr_lens[arr_dim]; // 每一维数组的长度
-    for (int i = arr_dim - 1; i >= 0; i--) {
-        int len = frame->popi();
+    size_t arr_lens[arr_dim]; // 每一维数组的长度，@dims 是操作数栈中按顺序压入的各维的长度
+    for (int i = 0; i < arr_dim; i++) {
+        jint len = ISLOT(dims + i);
         if (len < 0) {  // todo 等于0的情况
             thread_throw_negative_array_size_exception(len);
         }
         arr_lens[i] = (size_t) len;
     }
 
-    jref arr = ArrayObject::newInst(loadArrayClass(class_name), arr_dim, arr_lens);
-    frame->pushr(arr);
+    return ArrayObject::newInst(loadArrayClass(class_name), arr_dim, arr_lens);
 }
 
 /*
@@ -213,16 +169,14 @@ static void multianewarray(Frame *frame)
  * 显然基本类型数组肯定都是一维数组，
  * 如果引用类型数组的元素也是数组，那么它就是多维数组。
  */
-static void newarray(Frame *frame)
+static jref newarray(jint arr_len, int arr_type)
 {
-    jint arr_len = frame->popi();
     if (arr_len < 0) {
         thread_throw_negative_array_size_exception(arr_len);
     }
 
     // todo arrLen == 0 的情况
 
-    int arr_type = frame->reader.readu1();
     const char *arr_name;
     switch (arr_type) {
         case 4: arr_name = "[Z"; break;  // AT_BOOLEAN
@@ -240,7 +194,7 @@ static void newarray(Frame *frame)
     }
 
     auto c = loadArrayClass(arr_name);
-    frame->pushr(ArrayObject::newInst(c, (size_t) arr_len));
+    return ArrayObject::newInst(c, (size_t) arr_len);
 }
 
 /*
@@ -249,17 +203,15 @@ static void newarray(Frame *frame)
  * 实现完全错误
  * 创建一维引用类型数组
  */
-static void anewarray(Frame *frame)
+static jref anewarray(Class *curr_class, jint arr_len, int index)
 {
-    jint arr_len = frame->popi();
     if (arr_len < 0) {
         thread_throw_array_index_out_of_bounds_exception(arr_len);
     }
 
     // todo arrLen == 0 的情况
 
-    int index = frame->reader.readu2();
-    ConstantPool &cp = frame->method->clazz->cp;
+    ConstantPool &cp = curr_class->cp;
 
     const char *class_name;
     u1 type = CP_TYPE(cp, index);
@@ -270,8 +222,8 @@ static void anewarray(Frame *frame)
         class_name = CP_CLASS_NAME(cp, index);
     }
 
-    auto ac = frame->method->clazz->loader->loadClass(class_name)->arrayClass();
-    frame->pushr(ArrayObject::newInst(ac, (size_t) arr_len));
+    auto ac = curr_class->loader->loadClass(class_name)->arrayClass();
+    return ArrayObject::newInst(ac, (size_t) arr_len);
 }
 
 
@@ -325,9 +277,254 @@ static void anewarray(Frame *frame)
     } ref_constant, field_ref_constant, method_ref_constant, interface_method_ref_constant;
  */
 
+// 在类 @c 中查找接口方法 @m 的实现，内联缓存未命中时调用
+/*
+ * 查找类 @c 中接口方法 @m 的实现，通过 itable 查找，见 Class::ITable.
+ * 通过接口调用 java/lang/Object 中的方法（比如 toString）时，@m 是 Object 中的方法，通过 vtable 查找。
+ */
+static Method *find_interface_method(Class *c, const Method *m)
+{
+    Method *method;
+    if (m->clazz->isInterface()) {
+        method = c->itable.lookup(m);
+        if (method == nullptr) {
+            // @c 没有实现此接口
+            raiseException(INCOMPATIBLE_CLASS_CHANGE_ERROR);
+        }
+        if (method == Class::ITable::CONFLICT) {
+            // 有多个最具体的 default 方法，无法选择
+            string msg = string(c->className) + "~" + m->name + "~" + m->descriptor;
+            raiseException(INCOMPATIBLE_CLASS_CHANGE_ERROR, msg.c_str());
+        }
+    } else {
+        method = c->vtable[m->vtableIndex];
+    }
+
+    if (method->isAbstract()) {
+        raiseException(ABSTRACT_METHOD_ERROR);
+    }
+    if (!method->isPublic()) {
+        raiseException(ILLEGAL_ACCESS_ERROR);
+    }
+    return method;
+}
+
+// getfield 对应的快速指令，按字段的宽度区分
+static u1 getfield_quick_opcode(const Field *f)
+{
+    switch (f->descriptor[0]) {
+        case 'Z':
+        case 'B': return OPC_GETFIELD_QUICK_B;
+        case 'C': return OPC_GETFIELD_QUICK_C;
+        case 'S': return OPC_GETFIELD_QUICK_S;
+        case 'I':
+        case 'F': return OPC_GETFIELD_QUICK;
+        case 'J':
+        case 'D': return OPC_GETFIELD2_QUICK;
+        default:  return OPC_GETFIELD_QUICK_REF;
+    }
+}
+
+// putfield 对应的快速指令，char 和 short 的写入相同
+static u1 putfield_quick_opcode(const Field *f)
+{
+    switch (f->descriptor[0]) {
+        case 'Z':
+        case 'B': return OPC_PUTFIELD_QUICK_B;
+        case 'C':
+        case 'S': return OPC_PUTFIELD_QUICK_S;
+        case 'I':
+        case 'F': return OPC_PUTFIELD_QUICK;
+        case 'J':
+        case 'D': return OPC_PUTFIELD2_QUICK;
+        default:  return OPC_PUTFIELD_QUICK_REF;
+    }
+}
+
+// aload, getfield 的超级指令解析字段后改写为的指令，其他宽度的字段只有 aload 的部分改写为 aload
+static int aload_getfield_opcode(const Field *f)
+{
+    if (f->isStatic())
+        return OPC_ALOAD;
+    switch (f->descriptor[0]) {
+        case 'I':
+        case 'F': return OPC_ALOAD_GETFIELD_QUICK;
+        case 'L':
+        case '[': return OPC_ALOAD_GETFIELD_QUICK_REF;
+        default:  return OPC_ALOAD;
+    }
+}
+
+#if PROFILE_NGRAMS
+/*
+ * 统计顺序执行的指令序列（二元组和三元组），用于挑选超级指令，见 debug.h
+ * 每个线程记录最近执行的指令，跳转、调用、返回之后重新开始记录。
+ */
+static __thread const Method *ngram_method = nullptr;
+static __thread size_t ngram_next_pc = 0;
+static __thread u4 ngram_history = 0; // 最近执行的指令，每条占一个字节
+static __thread int ngram_length = 0;
+
+static pthread_mutex_t ngram_mutex = PTHREAD_MUTEX_INITIALIZER;
+static u8 ngram_total = 0;
+// key 的低三个字节是操作码，最高的字节是序列的长度
+static unordered_map<u4, u8> ngram_counts;
+
+static void count_ngram(const Method *m, size_t pc)
+{
+    if (m != ngram_method || pc != ngram_next_pc) {
+        ngram_method = m;
+        ngram_length = 0;
+    }
+    ngram_next_pc = pc + bytecode_length(m->code, pc);
+    ngram_history = (ngram_history << 8 | m->code[pc]) & 0xffffff;
+    if (ngram_length < 3)
+        ngram_length++;
+
+    pthread_mutex_lock(&ngram_mutex);
+    ngram_total++;
+    for (u4 n = 2; n <= (u4) ngram_length; n++)
+        ngram_counts[n << 24 | (ngram_history & ((1u << (n * 8)) - 1))]++;
+    pthread_mutex_unlock(&ngram_mutex);
+}
+
+void print_opcode_ngrams()
+{
+    pthread_mutex_lock(&ngram_mutex);
+    vector<pair<u4, u8>> sorted(ngram_counts.begin(), ngram_counts.end());
+    pthread_mutex_unlock(&ngram_mutex);
+    sort(sorted.begin(), sorted.end(), [](const pair<u4, u8> &a, const pair<u4, u8> &b) {
+        return a.second > b.second;
+    });
+
+    printf("Bytecode n-grams: %llu instructions executed\n", (unsigned long long) ngram_total);
+    for (u4 n = 2; n <= 3; n++) {
+        printf("  top %u-grams:\n", n);
+        int printed = 0;
+        for (auto &e : sorted) {
+            if (e.first >> 24 != n)
+                continue;
+            printf("    %12llu  %5.2f%%  ", (unsigned long long) e.second,
+                    ngram_total == 0 ? 0.0 : 100.0 * e.second / ngram_total);
+            for (int i = n - 1; i >= 0; i--)
+                printf(" %s", instruction_names[(e.first >> (i * 8)) & 0xff]);
+            printf("\n");
+            if (++printed == VM_PROFILE_NGRAMS_TOP)
+                break;
+        }
+    }
+}
+
+#define COUNT_NGRAM count_ngram
+#else
+#define COUNT_NGRAM(m, pc)
+#endif
+
+/*
+ * 返回 @m 的线索码，方法第一次执行时翻译，@labels 是解释器的处理程序。
+ * 多个线程同时翻译同一个方法时只保留先完成的一份。
+ */
+static ThreadedCode *threaded_code(Method *m, void *const *labels)
+{
+    ThreadedCode *tc = __atomic_load_n(&m->threadedCode, __ATOMIC_ACQUIRE);
+    if (tc == nullptr) {
+        auto translated = new ThreadedCode(m, labels);
+        if (__atomic_compare_exchange_n(&m->threadedCode, &tc, translated,
+                                        false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            tc = translated;
+        } else {
+            delete translated;
+        }
+    }
+    return tc;
+}
+
+/*
+ * 返回 @m 编译后的代码的入口，@m 仍由解释器执行时返回 nullptr.
+ * 解释执行的方法的热度达到 jitCountBase + VM_JIT_THRESHOLD 时编译，见 jit.h
+ */
+static inline JitEntry jit_code(Method *m)
+{
+    JitEntry entry = __atomic_load_n(&m->jitEntry, __ATOMIC_ACQUIRE);
+    if (entry != nullptr) {
+        m->jitUsed = true;
+        return entry;
+    }
+
+    if (!g_use_jit || m->jitState != JIT_INTERPRETED || m->hotness() - m->jitCountBase < VM_JIT_THRESHOLD)
+        return nullptr;
+    return jit_compile(m);
+}
+
+/*
+ * 为 @m 的调用计数（见 Method::invocationCount），然后同 jit_code.
+ * 方法的每次调用（execJavaFunc 和 __invoke_method）都经过这里。
+ */
+static inline JitEntry compiled_code(Method *m)
+{
+    m->invocationCount++;
+    return jit_code(m);
+}
+
+/*
+ * 解释器的策略（policy），作为 exec 的模板参数生成专门的解释器。
+ * 跟踪、统计等插桩只出现在使用它的解释器中，默认的解释器（FastPolicy）没有任何额外的代码。
+ *
+ * INSTRUMENTED 为 true 时，解释器第一次执行时调用 init 登记处理程序表，
+ * 每条指令分派之前调用 dispatch，@ip 指向指令的处理程序所在的单元。
+ *
+ * 每个解释器有自己的处理程序表，方法的线索码由运行的那一个翻译，
+ * 所以整个虚拟机只能使用其中的一个，在启动时选定，见 interpret.
+ */
+struct FastPolicy {
+    static constexpr bool INSTRUMENTED = false;
+    static void init(void *const *) { }
+    static void dispatch(Frame *, const Cell *) { }
+};
+
+// -XX:+ProfileOpcodes, 见 OpcodeProfile.h
+struct ProfilePolicy {
+    static constexpr bool INSTRUMENTED = true;
+
+    static void init(void *const *labels)
+    {
+        opcode_profile_register_handlers(labels, OPC_SUPERINSTRUCTION_END);
+    }
+
+    static void dispatch(Frame *frame, const Cell *ip)
+    {
+        profile_instruction(frame->method, ip->handler);
+    }
+};
+
+#if TRACE_INTERPRETER || PROFILE_NGRAMS
+// 打开 TRACE_INTERPRETER 或者 PROFILE_NGRAMS（见 debug.h）时使用，同时支持 -XX:+ProfileOpcodes
+struct DebugPolicy {
+    static constexpr bool INSTRUMENTED = true;
+
+    static void init(void *const *labels)
+    {
+        if (g_profile_opcodes)
+            ProfilePolicy::init(labels);
+    }
+
+    static void dispatch(Frame *frame, const Cell *ip)
+    {
+        size_t pc = frame->method->threadedCode->pcOf(ip);
+        u1 opcode = frame->method->code[pc];
+        (void) opcode;
+        TRACE("%d(0x%x), %s, pc = %lu\n", opcode, opcode, instruction_names[opcode], pc);
+        COUNT_NGRAM(frame->method, pc);
+        if (g_profile_opcodes)
+            ProfilePolicy::dispatch(frame, ip);
+    }
+};
+#endif
+
 /*
  * 执行当前线程栈顶的frame
  */
+template <typename Policy>
 static slot_t *exec()
 {
     Thread *thread = thread_self();
@@ -338,197 +535,232 @@ static slot_t *exec()
     Frame *frame = thread->topFrame;
     TRACE("executing frame: %s\n", frame->toString().c_str());
 
-    BytecodeReader *reader = &frame->reader;
-    Class *clazz = frame->method->clazz;
-    slot_t *stack = frame->stack;
+    /*
+     * 当前栈桢的执行状态放在局部变量中，以便编译器把它们分配在寄存器里，
+     * 只在调用和返回时与 frame 同步（见 SAVE_FRAME 和 CHANGE_FRAME），
+     * 指令不必每次都通过 frame 读写内存中的 ip 和栈顶。
+     */
+    Cell *ip; // 线索码中下一个要执行的单元，见 ThreadedCode
+    slot_t *sp = frame->stack; // 操作数栈的栈顶，指向下一个空闲的 slot
     slot_t *locals = frame->locals;
+    Class *clazz = frame->method->clazz;
     
     jint index;
     slot_t *value;
 
+// 跳转到 @target.
+// 向后跳转（循环）时检查 safepoint，保证一直在执行循环的线程也能及时响应 GC，
+// 同时为向后跳转计数（见 Method::backedgeCount），方法已经编译（或者这时变热了）时从 @target 处进入编译后的代码
+#define JUMP_TO(target) \
+    do { \
+        Cell *__target = (target); \
+        if (__target < ip) { \
+            frame->method->backedgeCount++; \
+            SAFEPOINT_POLL(); \
+            ip = __target; \
+            JitEntry __entry = jit_code(frame->method); \
+            if (__entry != nullptr) \
+                ENTER_COMPILED_CODE(__entry); \
+        } else { \
+            ip = __target; \
+        } \
+    } while (false)
+
+// 读取当前指令的下一个操作数
+#define OPERAND() ((ip++)->i)
+
+// 执行可能调用 Java 代码（类的初始化、抛出异常等）的慢速路径之前保存当前的位置，栈回溯中的行号才是对的。
+// 操作数栈中的值总是在内存中（GC 扫描整个操作数栈，见 gc.cpp），所以这时不必写回 sp
+#define SAVE_IP() (frame->ip = ip)
+
+// 离开当前栈桢（调用其他方法或者本地方法）之前把 ip 和 sp 写回 frame
+#define SAVE_FRAME() (frame->ip = ip, frame->stack = sp)
+
+// 切换到 @newFrame 执行，它的 ip 和 sp 已经保存在其中
 #define CHANGE_FRAME(newFrame) \
     do { \
-        /*frame->stack = stack;  stack指针在变动，需要设置一下 todo */ \
         frame = newFrame; \
-        reader = &frame->reader; \
-        stack = frame->stack; \
+        ip = frame->ip; \
+        sp = frame->stack; \
         clazz = frame->method->clazz; \
         locals = frame->locals; \
     } while (false)
 
+// 从 ip 处进入编译后的代码 @entry，然后从它退出的位置继续解释执行，ip 处的指令没有编译时什么也不做。
+// 退出的位置编译了，说明编译后的代码是在向后跳转处因为 GC 请求退出的（见 jit.h），
+// 这时进入 safepoint，然后从退出的位置重新进入（代码可能在 GC 期间被回收了，所以重新读取 jitEntry）
+#define ENTER_COMPILED_CODE(entry) \
+    do { \
+        JitEntry __e = (entry); \
+        const void *__start = jit_resume_point(frame->method, __e, ip); \
+        while (__start != nullptr) { \
+            sp = __e(locals, sp, &ip, __start); \
+            if (jit_resume_point(frame->method, __e, ip) == nullptr) \
+                break; \
+            SAFEPOINT_POLL(); \
+            __e = __atomic_load_n(&frame->method->jitEntry, __ATOMIC_ACQUIRE); \
+            if (__e == nullptr) \
+                break; \
+            __start = jit_resume_point(frame->method, __e, ip); \
+        } \
+    } while (false)
+
+// 进入方法时，如果方法已经编译则执行编译后的代码，然后从它退出的位置继续解释执行
+#define RUN_COMPILED_CODE() \
+    do { \
+        JitEntry __entry = compiled_code(frame->method); \
+        if (__entry != nullptr) \
+            ENTER_COMPILED_CODE(__entry); \
+    } while (false)
+
+// 同 Frame 中的 push 和 pop，但使用寄存器中的 sp
+#define PUSHI(v) (ISLOT(sp) = (v), sp++)
+#define PUSHF(v) (FSLOT(sp) = (v), sp++)
+#define PUSHL(v) (LSLOT(sp) = (v), sp += 2)
+#define PUSHD(v) (DSLOT(sp) = (v), sp += 2)
+#define PUSHR(v) (RSLOT(sp) = (v), sp++)
+
+#define POPI() (sp--, ISLOT(sp))
+#define POPF() (sp--, FSLOT(sp))
+#define POPL() (sp -= 2, LSLOT(sp))
+#define POPD() (sp -= 2, DSLOT(sp))
+#define POPR() (sp--, RSLOT(sp))
+
+    // 按操作码排列的处理程序，由 opcodes.h 中的表生成
     static void *labels[] = {
-        &&nop,
-
-        // Constants [0x01 ... 0x14]
-        &&opc_aconst_null, 
-        &&opc_iconst_m1, &&opc_iconst_0,  &&opc_iconst_1, &&opc_iconst_2, &&opc_iconst_3, &&opc_iconst_4, &&opc_iconst_5,
-        &&opc_lconst_0, &&opc_lconst_1,
-        &&opc_fconst_0, &&opc_fconst_1, &&opc_fconst_2, 
-        &&opc_dconst_0, &&opc_dconst_1,
-        &&opc_bipush, &&opc_sipush,
-        &&opc_ldc, &&opc_ldc_w, &&opc_ldc2_w, 
-
-        // Loads [0x15 ... 0x35]
-        &&opc_iload, &&opc_lload, &&opc_fload,&&opc_dload, &&opc_aload, 
-        &&opc_iload_0, &&opc_iload_1,  &&opc_iload_2, &&opc_iload_3, 
-        &&opc_lload_0, &&opc_lload_1,  &&opc_lload_2, &&opc_lload_3,
-        &&opc_fload_0, &&opc_fload_1,  &&opc_fload_2,  &&opc_fload_3,
-        &&opc_dload_0, &&opc_dload_1, &&opc_dload_2, &&opc_dload_3,
-        &&opc_aload_0, &&opc_aload_1, &&opc_aload_2, &&opc_aload_3,
-        &&opc_iaload, &&opc_laload, &&opc_faload, &&opc_daload, &&opc_aaload, &&opc_baload, &&opc_caload, &&opc_saload,
-
-        // Stores [0x36 ... 0x56]
-        &&opc_istore,  &&opc_lstore, &&opc_fstore, &&opc_dstore,  &&opc_astore, 
-        &&opc_istore_0, &&opc_istore_1, &&opc_istore_2, &&opc_istore_3,
-        &&opc_lstore_0, &&opc_lstore_1, &&opc_lstore_2, &&opc_lstore_3,
-        &&opc_fstore_0, &&opc_fstore_1, &&opc_fstore_2, &&opc_fstore_3,
-        &&opc_dstore_0, &&opc_dstore_1, &&opc_dstore_2, &&opc_dstore_3,
-        &&opc_astore_0, &&opc_astore_1, &&opc_astore_2, &&opc_astore_3,
-        &&opc_iastore, &&opc_lastore, &&opc_fastore, &&opc_dastore, &&opc_aastore, &&opc_bastore, &&opc_castore, &&opc_sastore,
-
-        // Stack [0x57 ... 0x5f]
-        &&opc_pop, &&opc_pop2, 
-        &&opc_dup, &&opc_dup_x1, &&opc_dup_x2, &&opc_dup2, &&opc_dup2_x1, &&opc_dup2_x2, 
-        &&opc_swap,
-
-        // Math [0x60 ... 0x84]
-        &&opc_iadd, &&opc_ladd, &&opc_fadd, &&opc_dadd, 
-        &&opc_isub, &&opc_lsub, &&opc_fsub, &&opc_dsub, 
-        &&opc_imul, &&opc_lmul, &&opc_fmul, &&opc_dmul, 
-        &&opc_idiv, &&opc_ldiv, &&opc_fdiv, &&opc_ddiv, 
-        &&opc_irem, &&opc_lrem, &&opc_frem, &&opc_drem,
-        &&opc_ineg, &&opc_lneg, &&opc_fneg, &&opc_dneg, 
-        &&opc_ishl, &&opc_lshl, &&opc_ishr, &&opc_lshr, &&opc_iushr, &&opc_lushr, 
-        &&opc_iand, &&opc_land, &&opc_ior, &&opc_lor, &&opc_ixor, &&opc_lxor, &&opc_iinc,
-
-        // Conversions [0x85 ... 0x93]
-        &&opc_i2l, &&opc_i2f, &&opc_i2d, 
-        &&opc_l2i, &&opc_l2f, &&opc_l2d, 
-        &&opc_f2i, &&opc_f2l, &&opc_f2d,
-        &&opc_d2i, &&opc_d2l, &&opc_d2f, 
-        &&opc_i2b, &&opc_i2c, &&opc_i2s, 
-
-        // Comparisons [0x94 ... 0xa6]
-        &&opc_lcmp, &&opc_fcmpl, &&opc_fcmpg, &&opc_dcmpl, &&opc_dcmpg, 
-        &&opc_ifeq, &&opc_ifne, &&opc_iflt, &&opc_ifge, &&opc_ifgt,&&opc_ifle, 
-        &&opc_if_icmpeq, &&opc_if_icmpne, &&opc_if_icmplt, &&opc_if_icmpge, &&opc_if_icmpgt, &&opc_if_icmple, 
-        &&opc_if_acmpeq, &&opc_if_acmpne, 
-
-        // Control [0xa7 ... 0xb1]
-        &&opc_goto, &&opc_jsr, &&opc_ret, &&opc_tableswitch, &&opc_lookupswitch, 
-        &&opc_ireturn, &&opc_lreturn, &&opc_freturn, &&opc_dreturn, &&opc_areturn, &&opc_return,
-
-        // References [0xb2 ... 0xc3]
-        &&opc_getstatic, &&opc_putstatic, &&opc_getfield, &&opc_putfield,
-        &&opc_invokevirtual, &&opc_invokespecial, &&opc_invokestatic,&&opc_invokeinterface, &&opc_invokedynamic,
-        &&opc_new,&&opc_newarray, &&opc_anewarray, &&opc_arraylength, 
-        &&opc_athrow, &&opc_checkcast, &&opc_instanceof, &&opc_monitorenter, &&opc_monitorexit,
-
-        // Extended [0xc4 ... 0xc9]
-        &&opc_wide, &&opc_multianewarray, &&opc_ifnull, &&opc_ifnonnull, &&opc_goto_w, &&opc_jsr_w, 
-
-        // Reserved [0xca ... 0xff]
-        &&opc_breakpoint,
-        &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused,
-        &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused,
-        &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused,
-        &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused,
-        &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused,
-        &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused,
-        &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused,
-        &&opc_notused,  &&opc_notused, &&opc_invokenative, &&opc_impdep2
+#define OPCODE_LABEL(code, NAME, name, ...) &&opc_##name,
+#define OPCODE_LABEL_UNUSED(code) &&opc_notused,
+        BYTECODES(OPCODE_LABEL, OPCODE_LABEL_UNUSED)
+        SUPERINSTRUCTIONS(OPCODE_LABEL)
+#undef OPCODE_LABEL
+#undef OPCODE_LABEL_UNUSED
     };
+    static_assert(sizeof(labels) / sizeof(*labels) == OPC_SUPERINSTRUCTION_END, "labels");
+
+// 把刚读取了操作数的指令改写为快速指令 @quickOpcode，可以改写的指令都只有一个操作数（见 ThreadedCode）.
+// 常量池中的项在此之前已经解析，release 保证其他线程读到快速指令时也能读到解析的结果
+#define QUICKEN(quickOpcode) \
+    __atomic_store_n(&(ip - 2)->handler, labels[quickOpcode], __ATOMIC_RELEASE)
+
+/*
+ * 字段访问的快速指令的操作数不再是常量池下标：getfield, putfield 的是字段的偏移（存为 ~offset），
+ * getstatic, putstatic 的是 Field *，执行时不必再经过常量池。先写入操作数，再用 QUICKEN 发布快速指令。
+ * 其他线程可能已经分派到了原来的指令，却读到新的操作数。新的操作数都不可能是常量池下标（~offset 是负数，
+ * Field * 不小于 0x10000），原来的指令读到这样的操作数时（QUICKENED_OPERAND）回到指令开始处重新分派。
+ */
+#define QUICKEN_WITH_OPERAND(quickOpcode, operand) \
+    do { \
+        __atomic_store_n(&(ip - 1)->i, (intptr_t) (operand), __ATOMIC_RELAXED); \
+        QUICKEN(quickOpcode); \
+    } while (false)
+
+#define QUICK_FIELD_OFFSET(field) (~(intptr_t) (field)->offset)
+#define QUICKENED_OPERAND(operand) ((uintptr_t) (operand) > 0xffff)
+
+// 可以改写为快速指令的字段访问指令读取常量池下标到 index
+#define FIELD_CP_INDEX_OPERAND() \
+{ \
+    intptr_t __operand = __atomic_load_n(&(ip++)->i, __ATOMIC_RELAXED); \
+    if (QUICKENED_OPERAND(__operand)) { \
+        ip -= 2; \
+        goto *__atomic_load_n(&(ip++)->handler, __ATOMIC_ACQUIRE); \
+    } \
+    index = (jint) __operand; \
+}
 
-#if TRACE_INTERPRETER    
 #define DISPATCH \
 { \
-    u1 opcode = reader->readu1(); \
-    TRACE("%d(0x%x), %s, pc = %lu\n", opcode, opcode, instruction_names[opcode], frame->reader.pc); \
-    goto *labels[opcode]; \
+    if constexpr (Policy::INSTRUMENTED) \
+        Policy::dispatch(frame, ip); \
+    goto *(ip++)->handler; \
 }
-#else
-#define DISPATCH goto *labels[reader->readu1()];
-#endif
+
+    if constexpr (Policy::INSTRUMENTED) {
+        static bool inited = (Policy::init(labels), true);
+        (void) inited;
+    }
 
     Class *c;
 
-nop:
+    // 方法第一次执行时翻译为线索码
+    ip = frame->ip = threaded_code(frame->method, labels)->cells;
+    RUN_COMPILED_CODE();
+
+opc_nop:
     DISPATCH
 opc_aconst_null:
-    *frame->stack++ = 0;
+    *sp++ = 0;
     DISPATCH
 opc_iconst_m1:
-    *frame->stack++ = -1;
+    *sp++ = -1;
     DISPATCH
 opc_iconst_0:
-    *frame->stack++ = 0;
+    *sp++ = 0;
     DISPATCH
 opc_iconst_1:
-    *frame->stack++ = 1; 
+    *sp++ = 1; 
     DISPATCH
 opc_iconst_2:
-    *frame->stack++ = 2;
+    *sp++ = 2;
     DISPATCH
 opc_iconst_3:
-    *frame->stack++ = 3;
+    *sp++ = 3;
     DISPATCH
 opc_iconst_4:
-    *frame->stack++ = 4;
+    *sp++ = 4;
     DISPATCH
 opc_iconst_5:
-    *frame->stack++ = 5;
+    *sp++ = 5;
     DISPATCH
 
 opc_lconst_0: 
-    frame->pushl(0); 
+    PUSHL(0); 
     DISPATCH
 opc_lconst_1:
-     frame->pushl(1); 
+     PUSHL(1); 
      DISPATCH
 
 opc_fconst_0: 
-    *frame->stack++ = 0; 
+    *sp++ = 0; 
     DISPATCH
 opc_fconst_1:
-    *((jfloat*) frame->stack) = (float) 1.0;
-    frame->stack++;
+    *((jfloat*) sp) = (float) 1.0;
+    sp++;
     DISPATCH
 opc_fconst_2:
-    *((jfloat*) frame->stack) = (float) 2.0;
-    frame->stack++;
+    *((jfloat*) sp) = (float) 2.0;
+    sp++;
     DISPATCH
 
 opc_dconst_0: 
-    frame->pushd(0); 
+    PUSHD(0); 
     DISPATCH
 opc_dconst_1: 
-    frame->pushd(1); 
+    PUSHD(1); 
     DISPATCH
 
 opc_bipush: // Byte Integer push
-    frame->pushi(reader->readu1()); 
+    PUSHI(OPERAND());
     DISPATCH
 opc_sipush: // Short Integer push
-    frame->pushi(reader->readu2());
+    PUSHI(OPERAND());
      DISPATCH
 
 opc_ldc:
-    index = reader->readu1();
-    goto __ldc;
 opc_ldc_w:
-    index = reader->readu2();
-__ldc:
+    index = OPERAND();
+    SAVE_IP();
     ConstantPool &cp = frame->method->clazz->cp;
     u1 type = CP_TYPE(cp, index);
 
     if (type == CONSTANT_Integer || type == CONSTANT_Float || type == CONSTANT_ResolvedString) {
-        *frame->stack++ = CP_INFO(cp, index);
+        *sp++ = CP_INFO(cp, index);
     } else if (type == CONSTANT_String) {
-        frame->pushr(resolve_string(frame->method->clazz, index));
+        PUSHR(resolve_string(frame->method->clazz, index));
     } else if (type == CONSTANT_Class) {
-        frame->pushr(resolve_class(frame->method->clazz, index));
+        PUSHR(resolve_class(frame->method->clazz, index));
     } else if (type == CONSTANT_ResolvedClass) {
-        frame->pushr((Class *) CP_INFO(cp, index));
+        PUSHR((Class *) CP_INFO(cp, index));
     } else {
         stringstream ss;
         ss << "unknown type: " << type;
@@ -538,14 +770,14 @@ __ldc:
 
 opc_ldc2_w:
     {
-        index = frame->reader.readu2();
+        index = OPERAND();
         ConstantPool &cp = frame->method->clazz->cp;
         u1 type = CP_TYPE(cp, index);
 
         if (type == CONSTANT_Long) {
-            frame->pushl(CP_LONG(cp, index));
+            PUSHL(CP_LONG(cp, index));
         } else if (type == CONSTANT_Double) {
-            frame->pushd(CP_DOUBLE(cp, index));
+            PUSHD(CP_DOUBLE(cp, index));
         } else {
             stringstream ss;
             ss << "unknown type: " << type;
@@ -557,247 +789,258 @@ opc_ldc2_w:
 opc_iload:
 opc_fload:
 opc_aload: 
-    index = reader->readu1();
-    *frame->stack++ = locals[index];
+    index = OPERAND();
+    *sp++ = locals[index];
     DISPATCH
 
 opc_lload:
 opc_dload: 
-    index = reader->readu1();
-    *frame->stack++ = locals[index];
-    *frame->stack++ = locals[index + 1];
+    index = OPERAND();
+    *sp++ = locals[index];
+    *sp++ = locals[index + 1];
     DISPATCH
 
 opc_iload_0:
 opc_fload_0:
 opc_aload_0:
-    *frame->stack++ = locals[0];
+    *sp++ = locals[0];
     DISPATCH
 opc_iload_1:
 opc_fload_1: 
 opc_aload_1: 
-    *frame->stack++ = locals[1];
+    *sp++ = locals[1];
     DISPATCH
 opc_iload_2:
 opc_fload_2:
 opc_aload_2: 
-    *frame->stack++ = locals[2];
+    *sp++ = locals[2];
     DISPATCH
 opc_iload_3: 
 opc_fload_3:
 opc_aload_3: 
-    *frame->stack++ = locals[3];
+    *sp++ = locals[3];
     DISPATCH
 
 opc_lload_0:
 opc_dload_0:
-    *frame->stack++ = locals[0];
-    *frame->stack++ = locals[1];
+    *sp++ = locals[0];
+    *sp++ = locals[1];
     DISPATCH
 opc_lload_1: 
 opc_dload_1: 
-    *frame->stack++ = locals[1];
-    *frame->stack++ = locals[2];
+    *sp++ = locals[1];
+    *sp++ = locals[2];
     DISPATCH
 opc_lload_2: 
 opc_dload_2: 
-    *frame->stack++ = locals[2];
-    *frame->stack++ = locals[3];
+    *sp++ = locals[2];
+    *sp++ = locals[3];
     DISPATCH
 opc_lload_3: 
 opc_dload_3: 
-    *frame->stack++ = locals[3];
-    *frame->stack++ = locals[4];
+    *sp++ = locals[3];
+    *sp++ = locals[4];
     DISPATCH
 
 #define GET_AND_CHECK_ARRAY \
-    index = frame->popi(); \
-    auto arr = (ArrayObject *) frame->popr(); \
+    index = POPI(); \
+    auto arr = (ArrayObject *) POPR(); \
     if ((arr) == nullptr) \
         thread_throw_null_pointer_exception(); \
     if (!arr->checkBounds(index)) \
         thread_throw_array_index_out_of_bounds_exception(index);
 
-#define ARRAY_LOAD_CATEGORY_ONE(type) \
+// 数组元素按实际的大小存放（见 Class::eleSize），读出后按 @SLOT 扩展为栈中的格式
+#define ARRAY_LOAD_CATEGORY_ONE(type, SLOT) \
 { \
     GET_AND_CHECK_ARRAY \
-    *frame->stack++ = (slot_t) arr->get<type>(index); \
+    SLOT(sp) = arr->get<type>(index); \
+    sp++; \
 }
 opc_iaload: 
-    ARRAY_LOAD_CATEGORY_ONE(jint); 
+    ARRAY_LOAD_CATEGORY_ONE(jint, ISLOT); 
     DISPATCH
 opc_faload:
-    ARRAY_LOAD_CATEGORY_ONE(jfloat); 
+    ARRAY_LOAD_CATEGORY_ONE(jfloat, FSLOT); 
     DISPATCH
 opc_aaload:
-    ARRAY_LOAD_CATEGORY_ONE(jref);
+    ARRAY_LOAD_CATEGORY_ONE(jref, RSLOT);
     DISPATCH
 opc_baload: 
-    ARRAY_LOAD_CATEGORY_ONE(jbyte); 
+    ARRAY_LOAD_CATEGORY_ONE(jbyte, ISLOT); 
     DISPATCH
 opc_caload: 
-    ARRAY_LOAD_CATEGORY_ONE(jchar); 
+    ARRAY_LOAD_CATEGORY_ONE(jchar, ISLOT); 
     DISPATCH
 opc_saload: 
-    ARRAY_LOAD_CATEGORY_ONE(jshort); 
+    ARRAY_LOAD_CATEGORY_ONE(jshort, ISLOT); 
     DISPATCH
 
 opc_laload: 
 opc_daload:
     {
         GET_AND_CHECK_ARRAY
-        value = (slot_t *) arr->index(index);
-        *frame->stack++ = value[0];
-        *frame->stack++ = value[1];
+        // 元素是 8 字节的，不一定等于两个 slot
+        LSLOT(sp) = arr->get<jlong>(index);
+        sp += 2;
         DISPATCH
     }
 
 opc_istore: 
 opc_fstore: 
 opc_astore:
-    index = reader->readu1();
-    locals[index] = *--frame->stack;
+    index = OPERAND();
+    locals[index] = *--sp;
     DISPATCH
 
 opc_lstore: 
 opc_dstore:
-    index = reader->readu1();
-    locals[index + 1] = *--frame->stack;
-    locals[index] = *--frame->stack;
+    index = OPERAND();
+    locals[index + 1] = *--sp;
+    locals[index] = *--sp;
     DISPATCH
 
 opc_istore_0: 
 opc_fstore_0: 
 opc_astore_0:
-    locals[0] = *--frame->stack;
+    locals[0] = *--sp;
     DISPATCH
 opc_istore_1: 
 opc_fstore_1: 
 opc_astore_1:
-    locals[1] = *--frame->stack;
+    locals[1] = *--sp;
     DISPATCH
 opc_istore_2: 
 opc_fstore_2: 
 opc_astore_2: 
-    locals[2] = *--frame->stack;
+    locals[2] = *--sp;
     DISPATCH
 opc_istore_3: 
 opc_fstore_3: 
 opc_astore_3: 
-    locals[3] = *--frame->stack;
+    locals[3] = *--sp;
     DISPATCH
 
 opc_lstore_0:
 opc_dstore_0:
-    locals[1] = *--frame->stack;
-    locals[0] = *--frame->stack;
+    locals[1] = *--sp;
+    locals[0] = *--sp;
     DISPATCH
 opc_lstore_1:
 opc_dstore_1:
-    locals[2] = *--frame->stack;
-    locals[1] = *--frame->stack;
+    locals[2] = *--sp;
+    locals[1] = *--sp;
     DISPATCH
 opc_lstore_2: 
 opc_dstore_2:
-    locals[3] = *--frame->stack;
-    locals[2] = *--frame->stack;
+    locals[3] = *--sp;
+    locals[2] = *--sp;
     DISPATCH
 opc_lstore_3: 
 opc_dstore_3:
-    locals[4] = *--frame->stack;
-    locals[3] = *--frame->stack;
+    locals[4] = *--sp;
+    locals[3] = *--sp;
     DISPATCH
 
-#define ARRAY_STORE_CATEGORY_ONE(type) \
+#define ARRAY_STORE_CATEGORY_ONE(type, SLOT) \
 { \
-    auto value = (type) *--frame->stack; \
+    auto value = (type) SLOT(--sp); \
     GET_AND_CHECK_ARRAY \
     arr->set(index, value); \
 }
 opc_iastore: 
-    ARRAY_STORE_CATEGORY_ONE(jint); 
+    ARRAY_STORE_CATEGORY_ONE(jint, ISLOT); 
     DISPATCH
 opc_fastore: 
-    ARRAY_STORE_CATEGORY_ONE(jfloat);
+    ARRAY_STORE_CATEGORY_ONE(jfloat, FSLOT);
     DISPATCH
 opc_aastore:
-    ARRAY_STORE_CATEGORY_ONE(jref); 
+{
+    // 存入的值必须是数组元素类型的实例
+    auto value = RSLOT(--sp);
+    GET_AND_CHECK_ARRAY
+    if (value != nullptr && !value->isInstanceOf(((ArrayClass *) arr->clazz)->componentType())) {
+        SAVE_IP();
+        raiseException(ARRAY_STORE_EXCEPTION, value->clazz->className);
+    }
+    arr->set(index, value);
+}
     DISPATCH
 opc_bastore:
-    ARRAY_STORE_CATEGORY_ONE(jbyte);
+    ARRAY_STORE_CATEGORY_ONE(jbyte, ISLOT);
     DISPATCH
 opc_castore:
-    ARRAY_STORE_CATEGORY_ONE(jchar);
+    ARRAY_STORE_CATEGORY_ONE(jchar, ISLOT);
     DISPATCH
 opc_sastore:
-    ARRAY_STORE_CATEGORY_ONE(jshort); 
+    ARRAY_STORE_CATEGORY_ONE(jshort, ISLOT); 
     DISPATCH
 
 opc_lastore: 
 opc_dastore:
-    frame->stack -= 2;
-    value = frame->stack;
+    sp -= 2;
+    value = sp;
     GET_AND_CHECK_ARRAY
-    memcpy(arr->index(index), value, sizeof(slot_t) * 2);
+    arr->set(index, LSLOT(value));
     DISPATCH
 
 opc_pop:
-    frame->stack--;
+    sp--;
     DISPATCH
 opc_pop2:
-    frame->stack -= 2;
+    sp -= 2;
     DISPATCH
 opc_dup:
-    frame->stack[0] = frame->stack[-1];
-    frame->stack++;
+    sp[0] = sp[-1];
+    sp++;
     DISPATCH
 opc_dup_x1:
-    frame->stack[0] = frame->stack[-1];
-    frame->stack[-1] = frame->stack[-2];
-    frame->stack[-2] = frame->stack[0];
-    frame->stack++;
+    sp[0] = sp[-1];
+    sp[-1] = sp[-2];
+    sp[-2] = sp[0];
+    sp++;
     DISPATCH
 opc_dup_x2:
-    frame->stack[0] = frame->stack[-1];
-    frame->stack[-1] = frame->stack[-2];
-    frame->stack[-2] = frame->stack[-3];
-    frame->stack[-3] = frame->stack[0];
-    frame->stack++;
+    sp[0] = sp[-1];
+    sp[-1] = sp[-2];
+    sp[-2] = sp[-3];
+    sp[-3] = sp[0];
+    sp++;
     DISPATCH
 opc_dup2:
-    frame->stack[0] = frame->stack[-2];
-    frame->stack[1] = frame->stack[-1];
-    frame->stack += 2;
+    sp[0] = sp[-2];
+    sp[1] = sp[-1];
+    sp += 2;
     DISPATCH
 opc_dup2_x1:
     // ..., value3, value2, value1 →
     // ..., value2, value1, value3, value2, value1
-    frame->stack[1] = frame->stack[-1];
-    frame->stack[0] = frame->stack[-2];
-    frame->stack[-1] = frame->stack[-3];
-    frame->stack[-2] = frame->stack[1];
-    frame->stack[-3] = frame->stack[0];
-    frame->stack += 2;
+    sp[1] = sp[-1];
+    sp[0] = sp[-2];
+    sp[-1] = sp[-3];
+    sp[-2] = sp[1];
+    sp[-3] = sp[0];
+    sp += 2;
     DISPATCH
 opc_dup2_x2:
     // ..., value4, value3, value2, value1 →
     // ..., value2, value1, value4, value3, value2, value1
-    frame->stack[1] = frame->stack[-1];
-    frame->stack[0] = frame->stack[-2];
-    frame->stack[-1] = frame->stack[-3];
-    frame->stack[-2] = frame->stack[-4];
-    frame->stack[-3] = frame->stack[1];
-    frame->stack[-4] = frame->stack[0];
-    frame->stack += 2;
+    sp[1] = sp[-1];
+    sp[0] = sp[-2];
+    sp[-1] = sp[-3];
+    sp[-2] = sp[-4];
+    sp[-3] = sp[1];
+    sp[-4] = sp[0];
+    sp += 2;
     DISPATCH
 opc_swap:
-    swap(frame->stack[-1], frame->stack[-2]);
+    swap(sp[-1], sp[-2]);
     DISPATCH
 
 #define BINARY_OP(type, n, oper) \
 { \
-    frame->stack -= (n);\
-    ((type *) frame->stack)[-1] = ((type *) frame->stack)[-1] oper ((type *) frame->stack)[0]; \
+    sp -= (n);\
+    ((type *) sp)[-1] = ((type *) sp)[-1] oper ((type *) sp)[0]; \
 }
 opc_iadd:
     BINARY_OP(jint, 1, +)
@@ -860,32 +1103,32 @@ opc_lrem:
 
 opc_frem:
     {
-        jfloat v2 = frame->popf();
-        jfloat v1 = frame->popf();
+        jfloat v2 = POPF();
+        jfloat v1 = POPF();
         jvm_abort("not implement\n");
         //    os_pushf(frame->operand_stack, dremf(v1, v2)); /* todo 相加溢出的问题 */
         DISPATCH
     }
 opc_drem:
     {
-        jdouble v2 = frame->popd();
-        jdouble v1 = frame->popd();
+        jdouble v2 = POPD();
+        jdouble v1 = POPD();
         jvm_abort("not implement\n");
         //    os_pushd(frame->operand_stack, drem(v1, v2)); /* todo 相加溢出的问题 */
         DISPATCH
     }
     
 opc_ineg:
-    frame->pushi(-frame->popi());
+    ISLOT(sp - 1) = -ISLOT(sp - 1);
     DISPATCH
 opc_lneg: 
-    frame->pushl(-frame->popl());
+    LSLOT(sp - 2) = -LSLOT(sp - 2);
     DISPATCH
 opc_fneg: 
-    frame->pushf(-frame->popf());
+    FSLOT(sp - 1) = -FSLOT(sp - 1);
     DISPATCH
 opc_dneg: 
-    frame->pushd(-frame->popd());
+    DSLOT(sp - 2) = -DSLOT(sp - 2);
     DISPATCH
 
     jint shift;
@@ -893,40 +1136,40 @@ opc_dneg:
     jlong lvalue;
 opc_ishl:
     // 与0x1f是因为低5位表示位移距离，位移距离实际上被限制在0到31之间。
-    shift = frame->popi() & 0x1f;
-    ivalue = frame->popi();
-    frame->pushi(ivalue << shift);
+    shift = POPI() & 0x1f;
+    ivalue = POPI();
+    PUSHI(ivalue << shift);
     DISPATCH
 opc_lshl: 
     // 与0x3f是因为低6位表示位移距离，位移距离实际上被限制在0到63之间。
-    shift = frame->popi() & 0x3f;
-    lvalue = frame->popl();
-    frame->pushl(lvalue << shift);
+    shift = POPI() & 0x3f;
+    lvalue = POPL();
+    PUSHL(lvalue << shift);
     DISPATCH
 opc_ishr:
     // 逻辑右移 shift logical right
-    shift = frame->popi() & 0x1f;
-    ivalue = frame->popi();
-    frame->pushi((~(((jint)1) >> shift)) & (ivalue >> shift));
+    shift = POPI() & 0x1f;
+    ivalue = POPI();
+    PUSHI((~(((jint)1) >> shift)) & (ivalue >> shift));
     DISPATCH
 
 opc_lshr: 
-    shift = frame->popi() & 0x3f;
-    lvalue = frame->popl();
-    frame->pushl((~(((jlong)1) >> shift)) & (lvalue >> shift));
+    shift = POPI() & 0x3f;
+    lvalue = POPL();
+    PUSHL((~(((jlong)1) >> shift)) & (lvalue >> shift));
     DISPATCH
 
 opc_iushr: 
     // 算术右移 shift arithmetic right
-    shift = frame->popi() & 0x1f;
-    ivalue = frame->popi();
-    frame->pushi(ivalue >> shift);
+    shift = POPI() & 0x1f;
+    ivalue = POPI();
+    PUSHI(ivalue >> shift);
     DISPATCH
 
 opc_lushr: 
-    shift = frame->popi() & 0x3f;
-    lvalue = frame->popl();
-    frame->pushl(lvalue >> shift);
+    shift = POPI() & 0x3f;
+    lvalue = POPL();
+    PUSHL(lvalue >> shift);
     DISPATCH
 
 opc_iand: 
@@ -949,58 +1192,82 @@ opc_lxor:
     DISPATCH
 
 opc_iinc: 
-    index = reader->readu1();
-    ISLOT(locals + index) = ISLOT(locals + index) + reader->reads1();
+    index = OPERAND();
+    ISLOT(locals + index) = ISLOT(locals + index) + (jint) OPERAND();
     DISPATCH
 
 opc_i2l: 
-    frame->pushl(i2l(frame->popi()));
+{
+    jint v = POPI();
+    PUSHL(i2l(v));
+}
     DISPATCH
 opc_i2f: 
-    frame->pushf(i2f(frame->popi()));
+    FSLOT(sp - 1) = i2f(ISLOT(sp - 1));
     DISPATCH
 opc_i2d: 
-    frame->pushd(i2d(frame->popi()));
+{
+    jint v = POPI();
+    PUSHD(i2d(v));
+}
     DISPATCH
 
 opc_l2i: 
-    frame->pushi(l2i(frame->popl()));
+{
+    jlong v = POPL();
+    PUSHI(l2i(v));
+}
     DISPATCH
 opc_l2f: 
-    frame->pushf(l2f(frame->popl()));
+{
+    jlong v = POPL();
+    PUSHF(l2f(v));
+}
     DISPATCH
 opc_l2d: 
-    frame->pushd(l2d(frame->popl()));
+    DSLOT(sp - 2) = l2d(LSLOT(sp - 2));
     DISPATCH
 
 opc_f2i:
-    frame->pushi(f2i(frame->popf()));
+    ISLOT(sp - 1) = f2i(FSLOT(sp - 1));
     DISPATCH
 opc_f2l: 
-    frame->pushl(f2l(frame->popf()));
+{
+    jfloat v = POPF();
+    PUSHL(f2l(v));
+}
     DISPATCH
 opc_f2d: 
-    frame->pushd(f2d(frame->popf()));
+{
+    jfloat v = POPF();
+    PUSHD(f2d(v));
+}
     DISPATCH
 
 opc_d2i:
-    frame->pushi(d2i(frame->popd()));
+{
+    jdouble v = POPD();
+    PUSHI(d2i(v));
+}
     DISPATCH
 opc_d2l:
-    frame->pushl(d2l(frame->popd()));
+    LSLOT(sp - 2) = d2l(DSLOT(sp - 2));
     DISPATCH
 opc_d2f: 
-    frame->pushf(d2f(frame->popd()));
+{
+    jdouble v = POPD();
+    PUSHF(d2f(v));
+}
     DISPATCH
 
 opc_i2b:  // todo byte or bool????
-    frame->pushi(i2b(frame->popi()));
+    ISLOT(sp - 1) = i2b(ISLOT(sp - 1));
     DISPATCH
 opc_i2c: 
-    frame->pushi(i2c(frame->popi()));
+    ISLOT(sp - 1) = i2c(ISLOT(sp - 1));
     DISPATCH
 opc_i2s:
-    frame->pushi(i2s(frame->popi()));
+    ISLOT(sp - 1) = i2s(ISLOT(sp - 1));
     DISPATCH
 
 /*
@@ -1012,33 +1279,34 @@ opc_i2s:
 
 #define CMP(type, t, cmp_result) \
 { \
-    type v2 = frame->pop##t(); \
-    type v1 = frame->pop##t(); \
-    frame->pushi(cmp_result); \
+    type v2 = POP##t(); \
+    type v1 = POP##t(); \
+    PUSHI(cmp_result); \
 }
 
 opc_lcmp: 
-    CMP(jlong, l, DO_CMP(v1, v2, -1));
+    CMP(jlong, L, DO_CMP(v1, v2, -1));
     DISPATCH
 opc_fcmpl:
-    CMP(jfloat, f, DO_CMP(v1, v2, -1));
+    CMP(jfloat, F, DO_CMP(v1, v2, -1));
     DISPATCH
 opc_fcmpg: 
-    CMP(jfloat, f, DO_CMP(v1, v2, 1));
+    CMP(jfloat, F, DO_CMP(v1, v2, 1));
     DISPATCH
 opc_dcmpl: 
-    CMP(jdouble, d, DO_CMP(v1, v2, -1));
+    CMP(jdouble, D, DO_CMP(v1, v2, -1));
     DISPATCH
 opc_dcmpg:
-    CMP(jdouble, d, DO_CMP(v1, v2, 1));
+    CMP(jdouble, D, DO_CMP(v1, v2, 1));
     DISPATCH
 
 #define IF_COND(cond) \
 { \
-    jint v = frame->popi(); \
-    jint offset = reader->reads2(); \
-    if (v cond 0) \
-        reader->skip(offset - 3);  /* minus instruction length */ \
+    jint v = POPI(); \
+    Cell *target = (ip++)->target; \
+    if (v cond 0) { \
+        JUMP_TO(target); \
+    } \
 }
 opc_ifeq:
     IF_COND(==);
@@ -1061,10 +1329,11 @@ opc_ifle:
 
 #define IF_ICMP_COND(cond) \
 { \
-    frame->stack -= 2;\
-    jint offset = reader->reads2(); \
-    if (ISLOT(frame->stack) cond ISLOT(frame->stack + 1)) \
-        reader->skip(offset - 3); /* minus instruction length */ \
+    sp -= 2;\
+    Cell *target = (ip++)->target; \
+    if (ISLOT(sp) cond ISLOT(sp + 1)) { \
+        JUMP_TO(target); \
+    } \
     DISPATCH \
 }
 opc_if_icmpeq: 
@@ -1088,10 +1357,11 @@ opc_if_icmple:
 
 #define IF_ACMP_COND(cond) \
 { \
-    frame->stack -= 2;\
-    jint offset = reader->reads2(); \
-    if (RSLOT(frame->stack) cond RSLOT(frame->stack + 1)) \
-        reader->skip(offset - 3);  /* minus instruction length */ \
+    sp -= 2;\
+    Cell *target = (ip++)->target; \
+    if (RSLOT(sp) cond RSLOT(sp + 1)) { \
+        JUMP_TO(target); \
+    } \
 }
 opc_if_acmpeq:
     IF_ACMP_COND(==);
@@ -1101,8 +1371,8 @@ opc_if_acmpne:
     DISPATCH
 
 opc_goto: 
-    int offset = reader->reads2();
-    reader->skip(offset - 3);  // minus instruction length
+    Cell *target = ip->target;
+    JUMP_TO(target);
     DISPATCH
 
 // 在Java 6之前，Oracle的Java编译器使用 jsr, jsr_w 和 ret 指令来实现 finally 子句。
@@ -1115,10 +1385,10 @@ opc_ret:
     DISPATCH
 
 opc_tableswitch:
-    tableswitch(frame);
+    ip = tableswitch(POPI(), ip);
     DISPATCH
 opc_lookupswitch:
-    lookupswitch(frame);
+    ip = lookupswitch(POPI(), ip);
     DISPATCH
 
     int ret_value_slot_count;
@@ -1136,11 +1406,11 @@ opc_return:
     ret_value_slot_count = 0;
 __method_return:
     Frame *invoke_frame = thread->topFrame = frame->prev;
-    frame->stack -= ret_value_slot_count;
+    sp -= ret_value_slot_count;
     if (frame->vm_invoke || invoke_frame == nullptr) {
-        return frame->stack;
+        return sp;
     } else {
-        slot_t *ret_value = frame->stack;
+        slot_t *ret_value = sp;
         for (int i = 0; i < ret_value_slot_count; i++) {
             *invoke_frame->stack++ = *ret_value++;
         }
@@ -1150,58 +1420,69 @@ __method_return:
     DISPATCH
 
     Field *field;
+    intptr_t offset;
 opc_getstatic: 
-    index = reader->readu2();
+    FIELD_CP_INDEX_OPERAND();
+    SAVE_IP();
     field = resolve_field(frame->method->clazz, index);
     assert(field->isStatic());
 
     if (!field->clazz->inited) {
         field->clazz->clinit();
     }
+    if (field->clazz->inited) {
+        QUICKEN_WITH_OPERAND(field->categoryTwo ? OPC_GETSTATIC2_QUICK : OPC_GETSTATIC_QUICK, field);
+    }
 
-    *frame->stack++ = field->staticValue.data[0];
+    *sp++ = field->staticValue.data[0];
     if (field->categoryTwo) {
-        *frame->stack++ = field->staticValue.data[1];
+        *sp++ = field->staticValue.data[1];
     }
     DISPATCH
 
 opc_putstatic:
-    index = reader->readu2();
+    FIELD_CP_INDEX_OPERAND();
+    SAVE_IP();
     field = resolve_field(frame->method->clazz, index);
     assert(field->isStatic());
 
     if (!field->clazz->inited) {
         field->clazz->clinit();
     }
+    if (field->clazz->inited) {
+        QUICKEN_WITH_OPERAND(field->categoryTwo ? OPC_PUTSTATIC2_QUICK : OPC_PUTSTATIC_QUICK, field);
+    }
 
     if (field->categoryTwo) {
-        frame->stack -= 2;
-        field->staticValue.data[0] = frame->stack[0];
-        field->staticValue.data[1] = frame->stack[1];
+        sp -= 2;
+        field->staticValue.data[0] = sp[0];
+        field->staticValue.data[1] = sp[1];
     } else {
-        field->staticValue.data[0] = *--frame->stack;
+        field->staticValue.data[0] = *--sp;
     }
+    // 静态变量保存在堆外的类中，不需要写屏障：每次 minor GC 都会扫描所有类的静态变量
 
     DISPATCH
 
     jref obj;
 opc_getfield:
-    index = reader->readu2();
+    FIELD_CP_INDEX_OPERAND();
+    SAVE_IP();
     field = resolve_field(frame->method->clazz, index);
-    obj = frame->popr();
+    QUICKEN_WITH_OPERAND(getfield_quick_opcode(field), QUICK_FIELD_OFFSET(field));
+    obj = POPR();
     if (obj == nullptr) {
         thread_throw_null_pointer_exception();
     }
 
-    *frame->stack++ = obj->data[field->id];
-    if (field->categoryTwo) {
-        *frame->stack++ = value[field->id + 1];
-    }
+    // 实例变量按宽度紧凑存放，读出后扩展为栈中的格式
+    sp += obj->getFieldValue(field, sp);
 
     DISPATCH
 
 opc_putfield:
-    index = reader->readu2();
+    FIELD_CP_INDEX_OPERAND();
+    SAVE_IP();
     field = resolve_field(frame->method->clazz, index);
 
     // 如果是final字段，则只能在构造函数中初始化，否则抛出java.lang.IllegalAccessError。
@@ -1211,15 +1492,17 @@ opc_putfield:
             raiseException(ILLEGAL_ACCESS_ERROR);
         }
     }
+    // 检查只和这条指令所在的方法有关，通过一次就不用再检查了
+    QUICKEN_WITH_OPERAND(putfield_quick_opcode(field), QUICK_FIELD_OFFSET(field));
 
     if (field->categoryTwo) {
-        frame->stack -= 2;
+        sp -= 2;
     } else {
-        frame->stack--;
+        sp--;
     }
-    value = frame->stack;
+    value = sp;
 
-    obj = frame->popr();
+    obj = POPR();
     if (obj == nullptr) {
         thread_throw_null_pointer_exception();
     }
@@ -1227,30 +1510,126 @@ opc_putfield:
     obj->setFieldValue(field, value);
     DISPATCH
 
+// 快速指令的操作数是 ~offset，见 QUICK_FIELD_OFFSET
+#define GET_QUICK_FIELD_AND_OBJECT \
+    offset = ~OPERAND(); \
+    obj = POPR(); \
+    if (obj == nullptr) \
+        thread_throw_null_pointer_exception();
+
+#define FIELD_ADDR(type) ((type *) ((u1 *) obj->data() + offset))
+
+#define GETFIELD_QUICK(type, SLOT) \
+{ \
+    GET_QUICK_FIELD_AND_OBJECT \
+    SLOT(sp) = *FIELD_ADDR(type); \
+    sp++; \
+}
+opc_getfield_quick_b:
+    GETFIELD_QUICK(jbyte, ISLOT);
+    DISPATCH
+opc_getfield_quick_c:
+    GETFIELD_QUICK(jchar, ISLOT);
+    DISPATCH
+opc_getfield_quick_s:
+    GETFIELD_QUICK(jshort, ISLOT);
+    DISPATCH
+opc_getfield_quick:
+    GETFIELD_QUICK(jint, ISLOT);
+    DISPATCH
+opc_getfield_quick_ref:
+    GETFIELD_QUICK(jref, RSLOT);
+    DISPATCH
+opc_getfield2_quick:
+    GET_QUICK_FIELD_AND_OBJECT
+    LSLOT(sp) = *FIELD_ADDR(jlong);
+    sp += 2;
+    DISPATCH
+
+#define PUTFIELD_QUICK(type, SLOT) \
+{ \
+    value = --sp; \
+    GET_QUICK_FIELD_AND_OBJECT \
+    *FIELD_ADDR(type) = (type) SLOT(value); \
+}
+opc_putfield_quick_b:
+    PUTFIELD_QUICK(jbyte, ISLOT);
+    DISPATCH
+opc_putfield_quick_s:
+    PUTFIELD_QUICK(jshort, ISLOT);
+    DISPATCH
+opc_putfield_quick:
+    PUTFIELD_QUICK(jint, ISLOT);
+    DISPATCH
+opc_putfield2_quick:
+    sp -= 2;
+    value = sp;
+    GET_QUICK_FIELD_AND_OBJECT
+    *FIELD_ADDR(jlong) = LSLOT(value);
+    DISPATCH
+opc_putfield_quick_ref:
+    value = --sp;
+    GET_QUICK_FIELD_AND_OBJECT
+    pre_write_barrier(*FIELD_ADDR(jref));
+    *FIELD_ADDR(jref) = RSLOT(value);
+    write_barrier(obj, RSLOT(value));
+    DISPATCH
+
+// 改写为快速指令时类已经初始化了，操作数是 Field *
+opc_getstatic_quick:
+    field = (Field *) OPERAND();
+    *sp++ = field->staticValue.data[0];
+    DISPATCH
+opc_getstatic2_quick:
+    field = (Field *) OPERAND();
+    *sp++ = field->staticValue.data[0];
+    *sp++ = field->staticValue.data[1];
+    DISPATCH
+opc_putstatic_quick:
+    field = (Field *) OPERAND();
+    field->staticValue.data[0] = *--sp;
+    DISPATCH
+opc_putstatic2_quick:
+    field = (Field *) OPERAND();
+    sp -= 2;
+    field->staticValue.data[0] = sp[0];
+    field->staticValue.data[1] = sp[1];
+    DISPATCH
+
 opc_invokevirtual:
     {
         // invokevirtual指令用于调用对象的实例方法，根据对象的实际类型进行分派（虚方法分派）。
-        index = reader->readu2();
-        Method *m = resolve_method(frame->method->clazz, index);
-
-        frame->stack -= m->arg_slot_count;
-        args = frame->stack;
+        // 操作数是内联缓存的地址，见 ThreadedCode
+        InlineCache *ic = (ip++)->ic;
+        SAVE_IP();
+        Method *m = resolve_method(frame->method->clazz, ic->cpIndex);
+        ic->method = m;
+        QUICKEN(OPC_INVOKEVIRTUAL_QUICK);
+
+        sp -= m->arg_slot_count;
+        args = sp;
         obj = (Object *) args[0];
         if (obj == nullptr) {
             thread_throw_null_pointer_exception();
         }
 
-        assert(m->vtableIndex >= 0);
-        assert(m->vtableIndex < obj->clazz->vtable.size());
-        resolved_method = obj->clazz->vtable[m->vtableIndex];
-        assert(resolved_method == obj->clazz->lookupMethod(m->name, m->descriptor));
+        if (m->clazz->isInterface()) {
+            // 通过类调用从接口继承来的 default 方法，default 方法不在类的 vtable 中
+            resolved_method = find_interface_method(obj->clazz, m);
+        } else {
+            assert(m->vtableIndex >= 0);
+            assert(m->vtableIndex < obj->clazz->vtable.size());
+            resolved_method = obj->clazz->vtable[m->vtableIndex];
+            assert(resolved_method == obj->clazz->lookupMethod(m->name, m->descriptor));
+        }
         goto __invoke_method;
     }
 opc_invokespecial:
     {
         // invokespecial指令用于调用一些需要特殊处理的实例方法，
         // 包括构造函数、私有方法和通过super关键字调用的超类方法。
-        index = reader->readu2();
+        index = OPERAND();
+        SAVE_IP();
 //
 //    // 假定从方法符号引用中解析出来的类是C，方法是M。如果M是构造函数，则声明M的类必须是C，
 ////    if (method->name == "<init>" && method->class != c) {
@@ -1277,9 +1656,13 @@ opc_invokespecial:
         if (m->isStatic()) {
             raiseException(INCOMPATIBLE_CLASS_CHANGE_ERROR);
         }
+        // 调用超类方法时实际的方法不是常量池中的，不改写
+        if (m == (Method *) CP_INFO(clazz->cp, index)) {
+            QUICKEN(OPC_INVOKENONVIRTUAL_QUICK);
+        }
 
-        frame->stack -= m->arg_slot_count;
-        args = frame->stack;
+        sp -= m->arg_slot_count;
+        args = sp;
         obj = (jref) args[0];
         if (obj == nullptr) {
             thread_throw_null_pointer_exception();
@@ -1292,7 +1675,8 @@ opc_invokestatic:
     {
         // invokestatic指令用来调用静态方法。
         // 如果类还没有被初始化，会触发类的初始化。
-        index = reader->readu2();
+        index = OPERAND();
+        SAVE_IP();
         Method *m = resolve_method(clazz, index);
         if (m->isAbstract()) {
             raiseException(ABSTRACT_METHOD_ERROR);
@@ -1304,54 +1688,93 @@ opc_invokestatic:
         if (!m->clazz->inited) {
             m->clazz->clinit();
         }
+        if (m->clazz->inited) {
+            QUICKEN(OPC_INVOKESTATIC_QUICK);
+        }
 
-        frame->stack -= m->arg_slot_count;
-        args = frame->stack;
+        sp -= m->arg_slot_count;
+        args = sp;
         resolved_method = m;
         goto __invoke_method;
     }
+opc_invokevirtual_quick:
+    {
+        InlineCache *ic = (ip++)->ic;
+        sp -= ic->method->arg_slot_count;
+        args = sp;
+        obj = (jref) args[0];
+        if (obj == nullptr) {
+            thread_throw_null_pointer_exception();
+        }
+        resolved_method = ic->lookup(obj->clazz);
+        if (resolved_method == nullptr) {
+            // 未命中或者 megamorphic，通过 vtable 分派
+            if (ic->method->clazz->isInterface())
+                resolved_method = find_interface_method(obj->clazz, ic->method);
+            else
+                resolved_method = obj->clazz->vtable[ic->method->vtableIndex];
+            if (!ic->megamorphic())
+                ic->add(obj->clazz, resolved_method);
+        }
+        goto __invoke_method;
+    }
+opc_invokeinterface_quick:
+    {
+        InlineCache *ic = (ip++)->ic;
+        sp -= ic->method->arg_slot_count;
+        args = sp;
+        obj = (jref) args[0];
+        if (obj == nullptr) {
+            thread_throw_null_pointer_exception();
+        }
+        resolved_method = ic->lookup(obj->clazz);
+        if (resolved_method == nullptr) {
+            resolved_method = find_interface_method(obj->clazz, ic->method);
+            if (!ic->megamorphic())
+                ic->add(obj->clazz, resolved_method);
+        }
+        goto __invoke_method;
+    }
+opc_invokenonvirtual_quick:
+    {
+        resolved_method = (Method *) CP_INFO(clazz->cp, OPERAND());
+        sp -= resolved_method->arg_slot_count;
+        args = sp;
+        if (args[0] == 0) {
+            thread_throw_null_pointer_exception();
+        }
+        goto __invoke_method;
+    }
+opc_invokestatic_quick:
+    resolved_method = (Method *) CP_INFO(clazz->cp, OPERAND());
+    sp -= resolved_method->arg_slot_count;
+    args = sp;
+    goto __invoke_method;
 opc_invokeinterface:
     {
-        index = reader->readu2();
+        // 操作数是内联缓存的地址，见 ThreadedCode
+        InlineCache *ic = (ip++)->ic;
+        SAVE_IP();
 
         /*
-         * 此字节的值是给方法传递参数需要的slot数，
-         * 其含义和给method结构体定义的arg_slot_count字段相同。
-         * 这个数是可以根据方法描述符计算出来的，它的存在仅仅是因为历史原因。
+         * 字节码中其后还有两个字节：给方法传递参数需要的slot数（可以根据方法描述符计算出来，
+         * 它的存在仅仅是因为历史原因）和一个 0，翻译为线索码时已经丢掉了。
          */
-        reader->readu1();
-        /*
-         * 此字节是留给Oracle的某些Java虚拟机实现用的，它的值必须是0。
-         * 该字节的存在是为了保证Java虚拟机可以向后兼容。
-         */
-        reader->readu1();
-
-        Method *m = resolve_method(clazz, index);
-        assert(m->clazz->isInterface());
+        Method *m = resolve_method(clazz, ic->cpIndex);
+        ic->method = m;
+        QUICKEN(OPC_INVOKEINTERFACE_QUICK);
 
         /* todo 本地方法 */
 
-        frame->stack -= m->arg_slot_count;
-        args = frame->stack;
+        sp -= m->arg_slot_count;
+        args = sp;
 
         obj = (jref) args[0];
         if (obj == nullptr) {
             thread_throw_null_pointer_exception();
         }
 
-        Method *method = obj->clazz->lookupMethod(m->name, m->descriptor);
-        if (method == nullptr) {
-            jvm_abort("error\n"); // todo
-        }
-
-        if (method->isAbstract()) {
-            raiseException(ABSTRACT_METHOD_ERROR);
-        }
-        if (!method->isPublic()) {
-            raiseException(ILLEGAL_ACCESS_ERROR);
-        }
-
-        resolved_method = method;
+        resolved_method = find_interface_method(obj->clazz, m);
         goto __invoke_method;
     }
 opc_invokedynamic:
@@ -1369,9 +1792,7 @@ opc_invokedynamic:
                 u2 name_and_type_index;
             }
          */
-        index = reader->readu2(); // point to CONSTANT_InvokeDynamic_info
-        reader->readu1(); // this byte must always be zero.
-        reader->readu1(); // this byte must always be zero.
+        index = OPERAND(); // point to CONSTANT_InvokeDynamic_info
 
         // 调用方法
         // public static MethodType fromMethodDescriptorString(String descriptor, ClassLoader loader);
@@ -1459,6 +1880,8 @@ opc_invokedynamic:
     }
 __invoke_method:
     assert(resolved_method);
+    SAVE_FRAME(); // 返回后从这里继续执行，参数已经弹出
+    SAFEPOINT_POLL();
     Frame *new_frame = allocFrame(resolved_method, false);
     if (resolved_method->arg_slot_count > 0 && args == nullptr) {
         jvm_abort("do not find args, %d\n", resolved_method->arg_slot_count); // todo
@@ -1470,13 +1893,17 @@ __invoke_method:
         new_frame->locals[i] = args[i];
     }
 
+    new_frame->ip = threaded_code(resolved_method, labels)->cells;
     CHANGE_FRAME(new_frame);
+    RUN_COMPILED_CODE();
     DISPATCH
 
 opc_new:
     // new指令专门用来创建类实例。数组由专门的指令创建
     // 如果类还没有被初始化，会触发类的初始化。
-    c = resolve_class(clazz, reader->readu2());  // todo
+    index = OPERAND();
+    SAVE_IP();
+    c = resolve_class(clazz, index);  // todo
     if (!c->inited) {
         c->clinit();
     }
@@ -1488,36 +1915,47 @@ opc_new:
     // todo java/lang/Class 会在这里创建，为什么会这样，怎么处理
     //    assert(strcmp(c->class_name, "java/lang/Class") == 0);
 
-    frame->pushr(Object::newInst(c));
+    PUSHR(Object::newInst(c));
     DISPATCH
 
 opc_newarray: 
-    newarray(frame);
+    index = OPERAND();
+    SAVE_IP();
+{
+    jint len = POPI();
+    PUSHR(newarray(len, index));
+}
     DISPATCH
 opc_anewarray: 
-    anewarray(frame);
+    index = OPERAND();
+    SAVE_IP();
+{
+    jint len = POPI();
+    PUSHR(anewarray(clazz, len, index));
+}
     DISPATCH
 
 opc_arraylength: 
-    Object *o = frame->popr();
+    Object *o = POPR();
     if (o == nullptr) {
         thread_throw_null_pointer_exception();
     }
     if (!o->isArray()) {
         raiseException(UNKNOWN_ERROR, "not a array"); // todo
     }
-    frame->pushi(((ArrayObject *) o)->len);
+    PUSHI(((ArrayObject *) o)->len);
     DISPATCH
 
 opc_athrow:
-    jref exception = frame->popr();
+    SAVE_IP();
+    jref exception = POPR();
     if (exception == nullptr) {
         thread_throw_null_pointer_exception();
     }
 
     // 遍历虚拟机栈找到可以处理此异常的方法
     while (true) {
-        int handler_pc = frame->method->findExceptionHandler(exception->clazz, reader->pc - 1); // instruction length todo 好像是错的
+        int handler_pc = frame->method->findExceptionHandler(exception->clazz, frame->pc());
         if (handler_pc >= 0) {  // todo 可以等于0吗
             /*
              * 找到可以处理的函数了
@@ -1527,8 +1965,8 @@ opc_athrow:
              */
 //                frame_stack_clear(top);  // todo
 //                frame_stack_pushr(top, exception);
-            frame->pushr(exception);
-            reader->pc = (size_t) handler_pc;
+            PUSHR(exception);
+            ip = frame->method->threadedCode->cellAt((size_t) handler_pc);
             DISPATCH  // todo
         }
 
@@ -1546,8 +1984,9 @@ opc_athrow:
     return nullptr; // todo
 
 opc_checkcast: 
-    obj = RSLOT(frame->stack - 1); // 不改变操作数栈
-    index = reader->readu2();
+    obj = RSLOT(sp - 1); // 不改变操作数栈
+    index = OPERAND();
+    SAVE_IP();
 
     // 如果引用是null，则指令执行结束。也就是说，null 引用可以转换成任何类型
     if (obj != nullptr) {
@@ -1559,86 +1998,57 @@ opc_checkcast:
     DISPATCH
 
 opc_instanceof:
-    index = reader->readu2();
+    index = OPERAND();
+    SAVE_IP();
     c = resolve_class(clazz, index);
 
-    obj = frame->popr();
+    obj = POPR();
     if (obj == nullptr)
-        frame->pushi(0);
+        PUSHI(0);
     else
-        frame->pushi(obj->isInstanceOf(c) ? 1 : 0);
+        PUSHI(obj->isInstanceOf(c) ? 1 : 0);
     DISPATCH
 
 opc_monitorenter:
-    frame->popr();
+    sp--;
     // todo
     DISPATCH
 
 opc_monitorexit: 
-    frame->popr();
+    sp--;
     // todo
     DISPATCH
 
 opc_wide: 
-    int __opcode = reader->readu1();
-    TRACE("%d(0x%x), %s, pc = %lu\n", __opcode, __opcode, instruction_names[__opcode], frame->reader.pc);
-    index = reader->readu2();
-    switch (__opcode) {
-        case OPC_ILOAD:
-        case OPC_FLOAD:
-        case OPC_ALOAD:
-            *frame->stack++ = locals[index];
-            break;
-        case OPC_LLOAD:
-        case OPC_DLOAD:
-            *frame->stack++ = locals[index];
-            *frame->stack++ = locals[index + 1];
-            break;
-        case OPC_ISTORE:
-        case OPC_FSTORE:
-        case OPC_ASTORE:
-            locals[index] = *--frame->stack;
-            break;
-        case OPC_LSTORE:
-        case OPC_DSTORE:
-            locals[index + 1] = *--frame->stack;
-            locals[index] = *--frame->stack;
-            break;
-        case OPC_RET:
-            raiseException(INTERNAL_ERROR, "ret doesn't support after jdk 6.");
-            break;
-        case OPC_IINC:
-            ISLOT(locals + index) = ISLOT(locals + index) + reader->readu2();
-            break;
-        default:
-            // todo never goes here.
-            break;
-    }
+    // 翻译为线索码时已经展开为带宽下标的普通指令（见 ThreadedCode），不会执行到这里
+    jvm_abort("never goes here\n");
     DISPATCH
 
 opc_multianewarray:
-    multianewarray(frame);
+    ip += 2;
+    SAVE_IP();
+    sp -= ip[-1].i;
+    PUSHR(multianewarray(clazz, ip[-2].i, ip[-1].i, sp));
     DISPATCH
 
 opc_ifnull: 
-    offset = reader->reads2();
-    if (frame->popr() == nullptr) {
-        reader->skip(offset - 3); // minus instruction length
+    target = (ip++)->target;
+    if (POPR() == nullptr) {
+        JUMP_TO(target);
     }
     DISPATCH
 
 opc_ifnonnull: 
-    offset = reader->reads2();
-    if (frame->popr() != nullptr) {
-        reader->skip(offset - 3); // minus instruction length
+    target = (ip++)->target;
+    if (POPR() != nullptr) {
+        JUMP_TO(target);
     }
     DISPATCH
 
-opc_goto_w: // todo
-    raiseException(INTERNAL_ERROR, "goto_w doesn't support");
-    DISPATCH
-opc_jsr_w: // todo
-    raiseException(INTERNAL_ERROR, "jsr_w doesn't support after jdk 6.");
+opc_goto_w:
+opc_jsr_w:
+    // 翻译为线索码时已经改为 goto 和 jsr（见 ThreadedCode），不会执行到这里
+    jvm_abort("never goes here\n");
     DISPATCH
 opc_breakpoint:
     // todo
@@ -1647,11 +2057,113 @@ opc_notused:
     jvm_abort("This instruction isn't used.\n"); // todo
     DISPATCH
 opc_invokenative:
+    // 本地方法通过 frame 读取参数、压入返回值
+    SAVE_FRAME();
     frame->method->nativeMethod(frame);
+    sp = frame->stack;
     DISPATCH
 opc_impdep2:
     jvm_abort("This instruction isn't used.\n"); // todo
     DISPATCH
+
+// 超级指令，见 interpreter.h 和 ThreadedCode.cpp
+// ip 指向序列中第一条指令的操作数，其后是其余指令的单元，执行完后跳过它们
+
+opc_aload_getfield:
+    // [aload 的下标][getfield][常量池下标]
+    // 第一次执行时解析字段，按字段的类型改写：先把其中的 getfield 改写为快速指令，再改写整个序列。
+    // 这一次仍然分别执行 aload 和 getfield
+{
+    intptr_t operand = __atomic_load_n(&ip[2].i, __ATOMIC_RELAXED);
+    int opcode = OPC_ALOAD; // 其中的 getfield 已经被其他线程改写了，只改写 aload 的部分
+    if (!QUICKENED_OPERAND(operand)) {
+        SAVE_IP();
+        field = resolve_field(frame->method->clazz, (int) operand);
+        opcode = aload_getfield_opcode(field);
+        if (opcode != OPC_ALOAD) {
+            __atomic_store_n(&ip[2].i, QUICK_FIELD_OFFSET(field), __ATOMIC_RELAXED);
+            __atomic_store_n(&ip[1].handler, labels[getfield_quick_opcode(field)], __ATOMIC_RELEASE);
+        }
+    }
+    __atomic_store_n(&(ip - 1)->handler, labels[opcode], __ATOMIC_RELEASE);
+}
+    *sp++ = locals[OPERAND()];
+    DISPATCH
+
+#define ALOAD_GETFIELD_QUICK(type, SLOT) \
+{ \
+    obj = RSLOT(locals + ip[0].i); \
+    offset = ~ip[2].i; \
+    ip += 3; \
+    if (obj == nullptr) \
+        thread_throw_null_pointer_exception(); \
+    SLOT(sp) = *FIELD_ADDR(type); \
+    sp++; \
+}
+opc_aload_getfield_quick:
+    ALOAD_GETFIELD_QUICK(jint, ISLOT);
+    DISPATCH
+opc_aload_getfield_quick_ref:
+    ALOAD_GETFIELD_QUICK(jref, RSLOT);
+    DISPATCH
+
+opc_aload_arraylength:
+    // [aload 的下标][arraylength]
+    obj = RSLOT(locals + ip[0].i);
+    ip += 2;
+    if (obj == nullptr) {
+        thread_throw_null_pointer_exception();
+    }
+    PUSHI(((ArrayObject *) obj)->len);
+    DISPATCH
+
+#define ILOAD_ILOAD_IF_ICMP(cond) \
+{ \
+    /* [iload 的下标][iload][iload 的下标][if_icmp<cond>][跳转目标] */ \
+    if (ISLOT(locals + ip[0].i) cond ISLOT(locals + ip[2].i)) { \
+        target = ip[4].target; \
+        JUMP_TO(target); \
+    } else { \
+        ip += 5; \
+    } \
+}
+opc_iload_iload_if_icmpeq:
+    ILOAD_ILOAD_IF_ICMP(==);
+    DISPATCH
+opc_iload_iload_if_icmpne:
+    ILOAD_ILOAD_IF_ICMP(!=);
+    DISPATCH
+opc_iload_iload_if_icmplt:
+    ILOAD_ILOAD_IF_ICMP(<);
+    DISPATCH
+opc_iload_iload_if_icmpge:
+    ILOAD_ILOAD_IF_ICMP(>=);
+    DISPATCH
+opc_iload_iload_if_icmpgt:
+    ILOAD_ILOAD_IF_ICMP(>);
+    DISPATCH
+opc_iload_iload_if_icmple:
+    ILOAD_ILOAD_IF_ICMP(<=);
+    DISPATCH
+
+opc_iinc_goto:
+    // [iinc 的下标][增量][goto][跳转目标]
+    ISLOT(locals + ip[0].i) += (jint) ip[1].i;
+    target = ip[3].target;
+    JUMP_TO(target);
+    DISPATCH
+}
+
+/*
+ * 用启动时选定的解释器执行当前线程栈顶的frame
+ */
+static slot_t *interpret()
+{
+#if TRACE_INTERPRETER || PROFILE_NGRAMS
+    return exec<DebugPolicy>();
+#else
+    return g_profile_opcodes ? exec<ProfilePolicy>() : exec<FastPolicy>();
+#endif
 }
 
 slot_t *execJavaFunc(Method *method, const slot_t *args)
@@ -1668,7 +2180,7 @@ slot_t *execJavaFunc(Method *method, const slot_t *args)
         frame->locals[i] = args[i];
     }
 
-    return exec();
+    return interpret();
 }
 
 slot_t *execJavaFunc(Method *method, initializer_list<slot_t> args)
@@ -1685,5 +2197,5 @@ slot_t *execJavaFunc(Method *method, initializer_list<slot_t> args)
         frame->locals[i] = *iter;
     }
 
-    return exec();
+    return interpret();
 }
@@ -0,0 +1,294 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_OPCODES_H
+#define KAYOVM_OPCODES_H
+
+/*
+ * 所有指令的定义表，按操作码从 0 开始连续排列。
+ *
+ * 操作码常量（OPC_*）、指令的名字、指令的长度和解释器的处理程序表（exec 中的 labels）都由这张表生成，
+ * 增加或者改动指令只需要修改这里（以及 exec 中对应的处理程序）。
+ *
+ * X(操作码, 常量名, 名字和处理程序的后缀, 指令的长度)，长度包括操作码，0 表示长度不固定（tableswitch, lookupswitch, wide）。
+ * UNUSED(操作码) 是没有使用的操作码，名字为 notused.
+ *
+ * 快速指令（quickening），使用保留的 [0xcb ... 0xfd].
+ * 字段访问和方法调用指令第一次执行时解析常量池中的符号引用，并做各种检查（类是否已经初始化，final 字段等），
+ * 之后把线索码（见 ThreadedCode）中指令的处理程序改写为对应的快速指令的，再次执行时不再解析和检查。
+ * 方法调用的快速指令的操作数仍然是常量池下标，对应的项已经解析为 Method *.
+ * 字段访问的快速指令的操作数改写为字段的偏移（getfield, putfield）或者 Field *（getstatic, putstatic），
+ * 执行时只需读取这一个单元。先写入操作数再发布处理程序，其他线程不会读到新的处理程序和旧的操作数；
+ * 读到旧的处理程序和新的操作数的线程重新分派，见 interpreter.cpp 中的 QUICKEN_WITH_OPERAND.
+ */
+#define BYTECODES(X, UNUSED) \
+    X(0x00, NOP, nop, 1)                                                          \
+    /* Constants [0x01 ... 0x14] */                                               \
+    X(0x01, ACONST_NULL, aconst_null, 1)                                          \
+    X(0x02, ICONST_M1, iconst_m1, 1)                                              \
+    X(0x03, ICONST_0, iconst_0, 1)                                                \
+    X(0x04, ICONST_1, iconst_1, 1)                                                \
+    X(0x05, ICONST_2, iconst_2, 1)                                                \
+    X(0x06, ICONST_3, iconst_3, 1)                                                \
+    X(0x07, ICONST_4, iconst_4, 1)                                                \
+    X(0x08, ICONST_5, iconst_5, 1)                                                \
+    X(0x09, LCONST_0, lconst_0, 1)                                                \
+    X(0x0a, LCONST_1, lconst_1, 1)                                                \
+    X(0x0b, FCONST_0, fconst_0, 1)                                                \
+    X(0x0c, FCONST_1, fconst_1, 1)                                                \
+    X(0x0d, FCONST_2, fconst_2, 1)                                                \
+    X(0x0e, DCONST_0, dconst_0, 1)                                                \
+    X(0x0f, DCONST_1, dconst_1, 1)                                                \
+    X(0x10, BIPUSH, bipush, 2)                                                    \
+    X(0x11, SIPUSH, sipush, 3)                                                    \
+    X(0x12, LDC, ldc, 2)                                                          \
+    X(0x13, LDC_W, ldc_w, 3)                                                      \
+    X(0x14, LDC2_W, ldc2_w, 3)                                                    \
+    /* Loads [0x15 ... 0x35] */                                                   \
+    X(0x15, ILOAD, iload, 2)                                                      \
+    X(0x16, LLOAD, lload, 2)                                                      \
+    X(0x17, FLOAD, fload, 2)                                                      \
+    X(0x18, DLOAD, dload, 2)                                                      \
+    X(0x19, ALOAD, aload, 2)                                                      \
+    X(0x1a, ILOAD_0, iload_0, 1)                                                  \
+    X(0x1b, ILOAD_1, iload_1, 1)                                                  \
+    X(0x1c, ILOAD_2, iload_2, 1)                                                  \
+    X(0x1d, ILOAD_3, iload_3, 1)                                                  \
+    X(0x1e, LLOAD_0, lload_0, 1)                                                  \
+    X(0x1f, LLOAD_1, lload_1, 1)                                                  \
+    X(0x20, LLOAD_2, lload_2, 1)                                                  \
+    X(0x21, LLOAD_3, lload_3, 1)                                                  \
+    X(0x22, FLOAD_0, fload_0, 1)                                                  \
+    X(0x23, FLOAD_1, fload_1, 1)                                                  \
+    X(0x24, FLOAD_2, fload_2, 1)                                                  \
+    X(0x25, FLOAD_3, fload_3, 1)                                                  \
+    X(0x26, DLOAD_0, dload_0, 1)                                                  \
+    X(0x27, DLOAD_1, dload_1, 1)                                                  \
+    X(0x28, DLOAD_2, dload_2, 1)                                                  \
+    X(0x29, DLOAD_3, dload_3, 1)                                                  \
+    X(0x2a, ALOAD_0, aload_0, 1)                                                  \
+    X(0x2b, ALOAD_1, aload_1, 1)                                                  \
+    X(0x2c, ALOAD_2, aload_2, 1)                                                  \
+    X(0x2d, ALOAD_3, aload_3, 1)                                                  \
+    X(0x2e, IALOAD, iaload, 1)                                                    \
+    X(0x2f, LALOAD, laload, 1)                                                    \
+    X(0x30, FALOAD, faload, 1)                                                    \
+    X(0x31, DALOAD, daload, 1)                                                    \
+    X(0x32, AALOAD, aaload, 1)                                                    \
+    X(0x33, BALOAD, baload, 1)                                                    \
+    X(0x34, CALOAD, caload, 1)                                                    \
+    X(0x35, SALOAD, saload, 1)                                                    \
+    /* Stores [0x36 ... 0x56] */                                                  \
+    X(0x36, ISTORE, istore, 2)                                                    \
+    X(0x37, LSTORE, lstore, 2)                                                    \
+    X(0x38, FSTORE, fstore, 2)                                                    \
+    X(0x39, DSTORE, dstore, 2)                                                    \
+    X(0x3a, ASTORE, astore, 2)                                                    \
+    X(0x3b, ISTORE_0, istore_0, 1)                                                \
+    X(0x3c, ISTORE_1, istore_1, 1)                                                \
+    X(0x3d, ISTORE_2, istore_2, 1)                                                \
+    X(0x3e, ISTORE_3, istore_3, 1)                                                \
+    X(0x3f, LSTORE_0, lstore_0, 1)                                                \
+    X(0x40, LSTORE_1, lstore_1, 1)                                                \
+    X(0x41, LSTORE_2, lstore_2, 1)                                                \
+    X(0x42, LSTORE_3, lstore_3, 1)                                                \
+    X(0x43, FSTORE_0, fstore_0, 1)                                                \
+    X(0x44, FSTORE_1, fstore_1, 1)                                                \
+    X(0x45, FSTORE_2, fstore_2, 1)                                                \
+    X(0x46, FSTORE_3, fstore_3, 1)                                                \
+    X(0x47, DSTORE_0, dstore_0, 1)                                                \
+    X(0x48, DSTORE_1, dstore_1, 1)                                                \
+    X(0x49, DSTORE_2, dstore_2, 1)                                                \
+    X(0x4a, DSTORE_3, dstore_3, 1)                                                \
+    X(0x4b, ASTORE_0, astore_0, 1)                                                \
+    X(0x4c, ASTORE_1, astore_1, 1)                                                \
+    X(0x4d, ASTORE_2, astore_2, 1)                                                \
+    X(0x4e, ASTORE_3, astore_3, 1)                                                \
+    X(0x4f, IASTORE, iastore, 1)                                                  \
+    X(0x50, LASTORE, lastore, 1)                                                  \
+    X(0x51, FASTORE, fastore, 1)                                                  \
+    X(0x52, DASTORE, dastore, 1)                                                  \
+    X(0x53, AASTORE, aastore, 1)                                                  \
+    X(0x54, BASTORE, bastore, 1)                                                  \
+    X(0x55, CASTORE, castore, 1)                                                  \
+    X(0x56, SASTORE, sastore, 1)                                                  \
+    /* Stack [0x57 ... 0x5f] */                                                   \
+    X(0x57, POP, pop, 1)                                                          \
+    X(0x58, POP2, pop2, 1)                                                        \
+    X(0x59, DUP, dup, 1)                                                          \
+    X(0x5a, DUP_X1, dup_x1, 1)                                                    \
+    X(0x5b, DUP_X2, dup_x2, 1)                                                    \
+    X(0x5c, DUP2, dup2, 1)                                                        \
+    X(0x5d, DUP2_X1, dup2_x1, 1)                                                  \
+    X(0x5e, DUP2_X2, dup2_x2, 1)                                                  \
+    X(0x5f, SWAP, swap, 1)                                                        \
+    /* Math [0x60 ... 0x84] */                                                    \
+    X(0x60, IADD, iadd, 1)                                                        \
+    X(0x61, LADD, ladd, 1)                                                        \
+    X(0x62, FADD, fadd, 1)                                                        \
+    X(0x63, DADD, dadd, 1)                                                        \
+    X(0x64, ISUB, isub, 1)                                                        \
+    X(0x65, LSUB, lsub, 1)                                                        \
+    X(0x66, FSUB, fsub, 1)                                                        \
+    X(0x67, DSUB, dsub, 1)                                                        \
+    X(0x68, IMUL, imul, 1)                                                        \
+    X(0x69, LMUL, lmul, 1)                                                        \
+    X(0x6a, FMUL, fmul, 1)                                                        \
+    X(0x6b, DMUL, dmul, 1)                                                        \
+    X(0x6c, IDIV, idiv, 1)                                                        \
+    X(0x6d, LDIV, ldiv, 1)                                                        \
+    X(0x6e, FDIV, fdiv, 1)                                                        \
+    X(0x6f, DDIV, ddiv, 1)                                                        \
+    X(0x70, IREM, irem, 1)                                                        \
+    X(0x71, LREM, lrem, 1)                                                        \
+    X(0x72, FREM, frem, 1)                                                        \
+    X(0x73, DREM, drem, 1)                                                        \
+    X(0x74, INEG, ineg, 1)                                                        \
+    X(0x75, LNEG, lneg, 1)                                                        \
+    X(0x76, FNEG, fneg, 1)                                                        \
+    X(0x77, DNEG, dneg, 1)                                                        \
+    X(0x78, ISHL, ishl, 1)                                                        \
+    X(0x79, LSHL, lshl, 1)                                                        \
+    X(0x7a, ISHR, ishr, 1)                                                        \
+    X(0x7b, LSHR, lshr, 1)                                                        \
+    X(0x7c, IUSHR, iushr, 1)                                                      \
+    X(0x7d, LUSHR, lushr, 1)                                                      \
+    X(0x7e, IAND, iand, 1)                                                        \
+    X(0x7f, LAND, land, 1)                                                        \
+    X(0x80, IOR, ior, 1)                                                          \
+    X(0x81, LOR, lor, 1)                                                          \
+    X(0x82, IXOR, ixor, 1)                                                        \
+    X(0x83, LXOR, lxor, 1)                                                        \
+    X(0x84, IINC, iinc, 3)                                                        \
+    /* Conversions [0x85 ... 0x93] */                                             \
+    X(0x85, I2L, i2l, 1)                                                          \
+    X(0x86, I2F, i2f, 1)                                                          \
+    X(0x87, I2D, i2d, 1)                                                          \
+    X(0x88, L2I, l2i, 1)                                                          \
+    X(0x89, L2F, l2f, 1)                                                          \
+    X(0x8a, L2D, l2d, 1)                                                          \
+    X(0x8b, F2I, f2i, 1)                                                          \
+    X(0x8c, F2L, f2l, 1)                                                          \
+    X(0x8d, F2D, f2d, 1)                                                          \
+    X(0x8e, D2I, d2i, 1)                                                          \
+    X(0x8f, D2L, d2l, 1)                                                          \
+    X(0x90, D2F, d2f, 1)                                                          \
+    X(0x91, I2B, i2b, 1)                                                          \
+    X(0x92, I2C, i2c, 1)                                                          \
+    X(0x93, I2S, i2s, 1)                                                          \
+    /* Comparisons [0x94 ... 0xa6] */                                             \
+    X(0x94, LCMP, lcmp, 1)                                                        \
+    X(0x95, FCMPL, fcmpl, 1)                                                      \
+    X(0x96, FCMPG, fcmpg, 1)                                                      \
+    X(0x97, DCMPL, dcmpl, 1)                                                      \
+    X(0x98, DCMPG, dcmpg, 1)                                                      \
+    X(0x99, IFEQ, ifeq, 3)                                                        \
+    X(0x9a, IFNE, ifne, 3)                                                        \
+    X(0x9b, IFLT, iflt, 3)                                                        \
+    X(0x9c, IFGE, ifge, 3)                                                        \
+    X(0x9d, IFGT, ifgt, 3)                                                        \
+    X(0x9e, IFLE, ifle, 3)                                                        \
+    X(0x9f, IF_ICMPEQ, if_icmpeq, 3)                                              \
+    X(0xa0, IF_ICMPNE, if_icmpne, 3)                                              \
+    X(0xa1, IF_ICMPLT, if_icmplt, 3)                                              \
+    X(0xa2, IF_ICMPGE, if_icmpge, 3)                                              \
+    X(0xa3, IF_ICMPGT, if_icmpgt, 3)                                              \
+    X(0xa4, IF_ICMPLE, if_icmple, 3)                                              \
+    X(0xa5, IF_ACMPEQ, if_acmpeq, 3)                                              \
+    X(0xa6, IF_ACMPNE, if_acmpne, 3)                                              \
+    /* Control [0xa7 ... 0xb1] */                                                 \
+    X(0xa7, GOTO, goto, 3)                                                        \
+    X(0xa8, JSR, jsr, 3)                                                          \
+    X(0xa9, RET, ret, 2)                                                          \
+    X(0xaa, TABLESWITCH, tableswitch, 0)                                          \
+    X(0xab, LOOKUPSWITCH, lookupswitch, 0)                                        \
+    X(0xac, IRETURN, ireturn, 1)                                                  \
+    X(0xad, LRETURN, lreturn, 1)                                                  \
+    X(0xae, FRETURN, freturn, 1)                                                  \
+    X(0xaf, DRETURN, dreturn, 1)                                                  \
+    X(0xb0, ARETURN, areturn, 1)                                                  \
+    X(0xb1, RETURN, return, 1)                                                    \
+    /* References [0xb2 ... 0xc3] */                                              \
+    X(0xb2, GETSTATIC, getstatic, 3)                                              \
+    X(0xb3, PUTSTATIC, putstatic, 3)                                              \
+    X(0xb4, GETFIELD, getfield, 3)                                                \
+    X(0xb5, PUTFIELD, putfield, 3)                                                \
+    X(0xb6, INVOKEVIRTUAL, invokevirtual, 3)                                      \
+    X(0xb7, INVOKESPECIAL, invokespecial, 3)                                      \
+    X(0xb8, INVOKESTATIC, invokestatic, 3)                                        \
+    X(0xb9, INVOKEINTERFACE, invokeinterface, 5)                                  \
+    X(0xba, INVOKEDYNAMIC, invokedynamic, 5)                                      \
+    X(0xbb, NEW, new, 3)                                                          \
+    X(0xbc, NEWARRAY, newarray, 2)                                                \
+    X(0xbd, ANEWARRAY, anewarray, 3)                                              \
+    X(0xbe, ARRAYLENGTH, arraylength, 1)                                          \
+    X(0xbf, ATHROW, athrow, 1)                                                    \
+    X(0xc0, CHECKCAST, checkcast, 3)                                              \
+    X(0xc1, INSTANCEOF, instanceof, 3)                                            \
+    X(0xc2, MONITORENTER, monitorenter, 1)                                        \
+    X(0xc3, MONITOREXIT, monitorexit, 1)                                          \
+    /* Extended [0xc4 ... 0xc9] */                                                \
+    X(0xc4, WIDE, wide, 0)                                                        \
+    X(0xc5, MULTIANEWARRAY, multianewarray, 4)                                    \
+    X(0xc6, IFNULL, ifnull, 3)                                                    \
+    X(0xc7, IFNONNULL, ifnonnull, 3)                                              \
+    X(0xc8, GOTO_W, goto_w, 5)                                                    \
+    X(0xc9, JSR_W, jsr_w, 5)                                                      \
+    /* Reserved [0xca ... 0xff] */                                                \
+    X(0xca, BREAKPOINT, breakpoint, 1)                                            \
+    /* Quick [0xcb ... 0xdd] */                                                   \
+    X(0xcb, GETFIELD_QUICK_B, getfield_quick_b, 3)       /* boolean, byte */      \
+    X(0xcc, GETFIELD_QUICK_C, getfield_quick_c, 3)                                \
+    X(0xcd, GETFIELD_QUICK_S, getfield_quick_s, 3)                                \
+    X(0xce, GETFIELD_QUICK, getfield_quick, 3)           /* int, float */         \
+    X(0xcf, GETFIELD2_QUICK, getfield2_quick, 3)         /* long, double */       \
+    X(0xd0, GETFIELD_QUICK_REF, getfield_quick_ref, 3)                            \
+    X(0xd1, PUTFIELD_QUICK_B, putfield_quick_b, 3)       /* boolean, byte */      \
+    X(0xd2, PUTFIELD_QUICK_S, putfield_quick_s, 3)       /* char, short */        \
+    X(0xd3, PUTFIELD_QUICK, putfield_quick, 3)           /* int, float */         \
+    X(0xd4, PUTFIELD2_QUICK, putfield2_quick, 3)         /* long, double */       \
+    X(0xd5, PUTFIELD_QUICK_REF, putfield_quick_ref, 3)                            \
+    X(0xd6, GETSTATIC_QUICK, getstatic_quick, 3)                                  \
+    X(0xd7, GETSTATIC2_QUICK, getstatic2_quick, 3)                                \
+    X(0xd8, PUTSTATIC_QUICK, putstatic_quick, 3)                                  \
+    X(0xd9, PUTSTATIC2_QUICK, putstatic2_quick, 3)                                \
+    X(0xda, INVOKEVIRTUAL_QUICK, invokevirtual_quick, 3)                          \
+    X(0xdb, INVOKENONVIRTUAL_QUICK, invokenonvirtual_quick, 3)                    \
+    X(0xdc, INVOKESTATIC_QUICK, invokestatic_quick, 3)                            \
+    X(0xdd, INVOKEINTERFACE_QUICK, invokeinterface_quick, 5)                      \
+    /* Not used [0xde ... 0xfd] */                                                \
+    UNUSED(0xde) UNUSED(0xdf) UNUSED(0xe0) UNUSED(0xe1) UNUSED(0xe2) UNUSED(0xe3) \
+    UNUSED(0xe4) UNUSED(0xe5) UNUSED(0xe6) UNUSED(0xe7) UNUSED(0xe8) UNUSED(0xe9) \
+    UNUSED(0xea) UNUSED(0xeb) UNUSED(0xec) UNUSED(0xed) UNUSED(0xee) UNUSED(0xef) \
+    UNUSED(0xf0) UNUSED(0xf1) UNUSED(0xf2) UNUSED(0xf3) UNUSED(0xf4) UNUSED(0xf5) \
+    UNUSED(0xf6) UNUSED(0xf7) UNUSED(0xf8) UNUSED(0xf9) UNUSED(0xfa) UNUSED(0xfb) \
+    UNUSED(0xfc) UNUSED(0xfd)                                                     \
+    X(0xfe, INVOKENATIVE, invokenative, 1)                                        \
+    X(0xff, IMPDEP2, impdep2, 1)
+
+/*
+ * 超级指令（superinstruction），编号从 256 开始，只出现在线索码中（见 ThreadedCode）。
+ * X(操作码, 常量名, 名字和处理程序的后缀)
+ *
+ * 一条超级指令执行一个常见的指令序列，省去序列中间的分派和操作数栈的读写。
+ * 翻译时只把序列中第一条指令的处理程序换成超级指令，其余指令的单元保持不变，由超级指令跳过；
+ * 跳转到序列中间的指令时仍然按原来的指令执行。
+ * 序列中的 iload_<n> 和 aload_<n> 翻译为以 n 为操作数的 iload 和 aload，所以每个序列的单元布局是固定的。
+ *
+ * 序列从 PROFILE_NGRAMS（见 debug.h）统计的执行最多的 n-gram 中挑选，见 ThreadedCode.cpp 中的 superinstructions.
+ */
+#define SUPERINSTRUCTIONS(X) \
+    X(256, ALOAD_GETFIELD, aload_getfield)               /* 解析字段后改写为下面两个之一，其他类型的字段改回 aload */ \
+    X(257, ALOAD_GETFIELD_QUICK, aload_getfield_quick)   /* int, float */                                             \
+    X(258, ALOAD_GETFIELD_QUICK_REF, aload_getfield_quick_ref)                                                        \
+    X(259, ALOAD_ARRAYLENGTH, aload_arraylength)                                                                      \
+    X(260, ILOAD_ILOAD_IF_ICMPEQ, iload_iload_if_icmpeq)                                                              \
+    X(261, ILOAD_ILOAD_IF_ICMPNE, iload_iload_if_icmpne)                                                              \
+    X(262, ILOAD_ILOAD_IF_ICMPLT, iload_iload_if_icmplt)                                                              \
+    X(263, ILOAD_ILOAD_IF_ICMPGE, iload_iload_if_icmpge)                                                              \
+    X(264, ILOAD_ILOAD_IF_ICMPGT, iload_iload_if_icmpgt)                                                              \
+    X(265, ILOAD_ILOAD_IF_ICMPLE, iload_iload_if_icmple)                                                              \
+    X(266, IINC_GOTO, iinc_goto)
+
+#endif //KAYOVM_OPCODES_H
@@ -0,0 +1,107 @@
+/*
+ * Author: kayo
+ */
+
+#include <cassert>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#include "CodeCache.h"
+
+using namespace std;
+
+static inline size_t align(size_t size)
+{
+    return (size + CodeCache::ALIGN - 1) & ~(CodeCache::ALIGN - 1);
+}
+
+#ifdef _WIN32
+
+static void *mapExecutable(size_t len)
+{
+    return VirtualAlloc(nullptr, len, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+}
+
+static void unmapExecutable(void *p, size_t len)
+{
+    VirtualFree(p, 0, MEM_RELEASE);
+}
+
+#else
+
+static void *mapExecutable(size_t len)
+{
+    void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+static void unmapExecutable(void *p, size_t len)
+{
+    munmap(p, len);
+}
+
+#endif
+
+CodeCache::~CodeCache()
+{
+    if (base != nullptr)
+        unmapExecutable(base, capacity);
+}
+
+bool CodeCache::init(size_t size)
+{
+    assert(base == nullptr);
+    size = align(size);
+    base = (u1 *) mapExecutable(size);
+    if (base == nullptr)
+        return false;
+
+    capacity = size;
+    freeBlocks.emplace(base, size);
+    return true;
+}
+
+void *CodeCache::alloc(size_t size)
+{
+    size = align(size);
+    for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it) {
+        if (it->second < size)
+            continue;
+
+        u1 *p = it->first;
+        size_t rest = it->second - size;
+        freeBlocks.erase(it);
+        if (rest > 0)
+            freeBlocks.emplace(p + size, rest);
+        used += size;
+        return p;
+    }
+    return nullptr;
+}
+
+void CodeCache::free(void *p, size_t size)
+{
+    auto q = (u1 *) p;
+    size = align(size);
+    assert(q >= base && q + size <= base + capacity);
+    used -= size;
+
+    // 与后面相邻的空闲块合并
+    auto next = freeBlocks.lower_bound(q);
+    if (next != freeBlocks.end() && next->first == q + size) {
+        size += next->second;
+        next = freeBlocks.erase(next);
+    }
+
+    // 与前面相邻的空闲块合并
+    if (next != freeBlocks.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == q) {
+            prev->second += size;
+            return;
+        }
+    }
+    freeBlocks.emplace(q, size);
+}
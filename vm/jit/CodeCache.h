@@ -0,0 +1,61 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_CODECACHE_H
+#define KAYOVM_CODECACHE_H
+
+#include <map>
+#include <cstddef>
+#include "../jtypes.h"
+
+/*
+ * 代码缓存（code cache），存放 JIT 编译后的代码
+ *
+ * 初始化时向操作系统申请一段可读、可写、可执行的内存，按 ALIGN 对齐分块，
+ * 空闲块按地址排序，首次适配（first-fit）分配，释放时与相邻的空闲块合并。
+ * 不加锁，由调用者（jit.cpp）保证互斥。
+ */
+class CodeCache {
+    u1 *base = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+
+    // 空闲块：起始地址 -> 大小
+    std::map<u1 *, size_t> freeBlocks;
+
+public:
+    // 每个块的起始地址和大小都按此对齐
+    static const size_t ALIGN = 16;
+
+    CodeCache() = default;
+    CodeCache(const CodeCache &) = delete;
+    CodeCache &operator=(const CodeCache &) = delete;
+    ~CodeCache();
+
+    // 申请 @size 字节的可执行内存，失败时返回 false
+    bool init(size_t size);
+
+    bool inited() const
+    {
+        return base != nullptr;
+    }
+
+    // 申请一块至少 @size 字节的内存，没有足够大的空闲块时返回 nullptr
+    void *alloc(size_t size);
+
+    // 释放由 alloc 分配的大小为 @size 的块
+    void free(void *p, size_t size);
+
+    size_t usedBytes() const
+    {
+        return used;
+    }
+
+    size_t capacityBytes() const
+    {
+        return capacity;
+    }
+};
+
+#endif //KAYOVM_CODECACHE_H
@@ -0,0 +1,715 @@
+/*
+ * Author: kayo
+ */
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cassert>
+#include <pthread.h>
+#include "jit.h"
+#include "CodeCache.h"
+#include "../kayo.h"
+#include "../config.h"
+#include "../interpreter/interpreter.h"
+#include "../interpreter/ThreadedCode.h"
+#include "../rtda/ma/Method.h"
+#include "../rtda/ma/Class.h"
+#include "../heapmgr/gc.h"
+
+using namespace std;
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define JIT_64 1
+#else
+#define JIT_64 0
+#endif
+
+// 寄存器的编号，x86-64 上是对应的 64 位寄存器
+enum Reg { EAX = 0, ECX = 1, EDX = 2, EBX = 3, ESP = 4, EBP = 5, ESI = 6, EDI = 7 };
+
+// 编译后的代码中固定使用的寄存器，EAX 和 ECX 是临时寄存器
+static const Reg LOCALS = ESI; // 局部变量表
+static const Reg SP = EDI;     // 操作数栈的栈顶
+
+static const int S = sizeof(slot_t);
+
+// 条件码，即 Jcc 指令操作码的低 4 位
+enum Cond { CC_E = 0x4, CC_NE = 0x5, CC_L = 0xc, CC_GE = 0xd, CC_LE = 0xe, CC_G = 0xf };
+
+static inline Cond inverse(Cond cc)
+{
+    return (Cond) (cc ^ 1);
+}
+
+/*
+ * 生成 x86 的机器码，只包含模板用到的指令。
+ * 操作数默认是 32 位的，@w 为 true 时在 x86-64 上是 64 位的（加 REX.W 前缀）。
+ */
+class Assembler {
+public:
+    vector<u1> code;
+
+    size_t offset() const
+    {
+        return code.size();
+    }
+
+    void byte(u1 b)
+    {
+        code.push_back(b);
+    }
+
+    void int32(s4 v)
+    {
+        for (int i = 0; i < 4; i++)
+            byte((u1) ((u4) v >> (i * 8)));
+    }
+
+    void word(intptr_t v)
+    {
+        for (size_t i = 0; i < sizeof(v); i++)
+            byte((u1) ((uintptr_t) v >> (i * 8)));
+    }
+
+    void rexw(bool w)
+    {
+        if (JIT_64 && w)
+            byte(0x48);
+    }
+
+    // ModRM（以及 SIB 和偏移量）：寄存器或者扩展操作码 @reg，内存操作数 [@base + @disp]
+    void mem(int reg, Reg base, s4 disp)
+    {
+        int mod = disp == 0 && base != EBP ? 0 : (-128 <= disp && disp <= 127 ? 1 : 2);
+        byte((u1) (mod << 6 | reg << 3 | base));
+        if (base == ESP)
+            byte(0x24);
+        if (mod == 1)
+            byte((u1) disp);
+        else if (mod == 2)
+            int32(disp);
+    }
+
+    // 操作码为 @opcode（0x0f 开头的两字节操作码为 0x0fxx），操作数为 @reg 和 [@base + @disp] 的指令
+    void op(u2 opcode, int reg, Reg base, s4 disp, bool w = false)
+    {
+        rexw(w);
+        if (opcode > 0xff)
+            byte((u1) (opcode >> 8));
+        byte((u1) opcode);
+        mem(reg, base, disp);
+    }
+
+    void load(Reg dst, Reg base, s4 disp, bool w = false)
+    {
+        op(0x8b, dst, base, disp, w);
+    }
+
+    void store(Reg base, s4 disp, Reg src, bool w = false)
+    {
+        op(0x89, src, base, disp, w);
+    }
+
+    void storeImm(Reg base, s4 disp, s4 imm, bool w = false)
+    {
+        op(0xc7, 0, base, disp, w);
+        int32(imm);
+    }
+
+    // mov @dst, @imm（x86-64 上是 64 位的立即数）
+    void movImm(Reg dst, intptr_t imm)
+    {
+        rexw(true);
+        byte((u1) (0xb8 + dst));
+        word(imm);
+    }
+
+    // 指针宽度的 add @r, @imm
+    void addImm(Reg r, s1 imm)
+    {
+        rexw(true);
+        byte(0x83);
+        byte((u1) (0xc0 | r));
+        byte((u1) imm);
+    }
+
+    // 返回 rel32 的位置，由 bind 填写
+    size_t jcc(Cond cc)
+    {
+        byte(0x0f);
+        byte((u1) (0x80 | cc));
+        size_t at = offset();
+        int32(0);
+        return at;
+    }
+
+    size_t jmp()
+    {
+        byte(0xe9);
+        size_t at = offset();
+        int32(0);
+        return at;
+    }
+
+    void bind(size_t at, size_t target)
+    {
+        auto rel = (s4) (target - (at + 4));
+        for (int i = 0; i < 4; i++)
+            code[at + i] = (u1) ((u4) rel >> (i * 8));
+    }
+
+    // 短跳转，返回 rel8 的位置，由 bind8 填写为当前位置
+    size_t jcc8(Cond cc)
+    {
+        byte((u1) (0x70 | cc));
+        byte(0);
+        return offset() - 1;
+    }
+
+    void bind8(size_t at)
+    {
+        size_t rel = offset() - (at + 1);
+        assert(rel <= 127);
+        code[at] = (u1) rel;
+    }
+};
+
+static inline u2 read_u2(const u1 *p)
+{
+    return (u2) (p[0] << 8 | p[1]);
+}
+
+static inline s4 read_s4(const u1 *p)
+{
+    return (s4) ((u4) p[0] << 24 | (u4) p[1] << 16 | (u4) p[2] << 8 | p[3]);
+}
+
+/*
+ * 把一个方法的字节码逐条翻译为模板
+ */
+class TemplateCompiler {
+    const Method *m;
+    Assembler a;
+
+    // 每条指令的代码的起始位置，按字节码的 pc 索引
+    vector<size_t> nativeOffsets;
+    // 指令是否翻译为了模板（而不是退出），可以从这里进入编译后的代码，按字节码的 pc 索引
+    vector<bool> resumable;
+
+    // 跳转到字节码中 targetPc 处的指令，翻译完后填写
+    struct Fixup {
+        size_t at;
+        size_t targetPc;
+    };
+    vector<Fixup> fixups;
+
+    // 跳转到方法的结尾（epilogue）
+    vector<size_t> exits;
+
+    void prologue();
+    void epilogue();
+    void exitTo(size_t pc);
+    void branch(int cc, size_t pc, size_t target);
+    bool emitTemplate(size_t pc);
+
+    void pushImm(s4 imm)
+    {
+        a.storeImm(SP, 0, imm);
+        a.addImm(SP, S);
+    }
+
+    // 把 @slots 个 slot 从局部变量表的 @index 处复制到栈顶
+    void loadLocal(int index, int slots)
+    {
+        for (int i = 0; i < slots; i++) {
+            a.load(EAX, LOCALS, (index + i) * S, true);
+            a.store(SP, i * S, EAX, true);
+        }
+        a.addImm(SP, (s1) (slots * S));
+    }
+
+    void storeLocal(int index, int slots)
+    {
+        a.addImm(SP, (s1) (-slots * S));
+        for (int i = 0; i < slots; i++) {
+            a.load(EAX, SP, i * S, true);
+            a.store(LOCALS, (index + i) * S, EAX, true);
+        }
+    }
+
+public:
+    size_t supported = 0; // 翻译为模板（而不是退出）的指令数
+
+    explicit TemplateCompiler(const Method *m): m(m), nativeOffsets(m->codeLen, SIZE_MAX), resumable(m->codeLen, false) { }
+
+    /*
+     * 翻译整个方法，方法的第一条指令就不支持时返回 false，这样的方法不值得编译
+     */
+    bool compile();
+
+    const vector<u1> &code() const
+    {
+        return a.code;
+    }
+
+    /*
+     * 每个线索码单元在代码中的位置，按单元索引，见 Method::jitResumeOffsets
+     */
+    u4 *resumeOffsets() const
+    {
+        const ThreadedCode *tc = m->threadedCode;
+        u4 *offsets = new u4[tc->length];
+        fill(offsets, offsets + tc->length, JIT_NOT_RESUMABLE);
+        for (size_t pc = 0; pc < m->codeLen; pc += bytecode_length(m->code, pc)) {
+            if (resumable[pc])
+                offsets[tc->cellAt(pc) - tc->cells] = (u4) nativeOffsets[pc];
+        }
+        return offsets;
+    }
+};
+
+/*
+ * 入口：保存用到的 callee-saved 寄存器，把参数放到固定的寄存器中，exitIp 保存在栈顶，
+ * 然后跳转到参数 start 处开始执行
+ */
+void TemplateCompiler::prologue()
+{
+    a.byte(0x56); // push esi
+    a.byte(0x57); // push edi
+#if JIT_64 && defined(_WIN64)
+    // rcx: locals, rdx: sp, r8: exitIp, r9: start
+    a.byte(0x41); a.byte(0x50);             // push r8
+    a.byte(0x48); a.byte(0x89); a.byte(0xce); // mov rsi, rcx
+    a.byte(0x48); a.byte(0x89); a.byte(0xd7); // mov rdi, rdx
+    a.byte(0x41); a.byte(0xff); a.byte(0xe1); // jmp r9
+#elif JIT_64
+    // rdi: locals, rsi: sp, rdx: exitIp, rcx: start
+    a.byte(0x52);                             // push rdx
+    a.byte(0x48); a.byte(0x87); a.byte(0xf7); // xchg rsi, rdi
+    a.byte(0xff); a.byte(0xe1);               // jmp rcx
+#else
+    // 参数都在栈上，push 了两个寄存器后依次是 [esp + 12], [esp + 16], [esp + 20], [esp + 24]
+    a.load(LOCALS, ESP, 12);
+    a.load(SP, ESP, 16);
+    a.op(0xff, 6, ESP, 20); // push dword [esp + 20]
+    a.op(0xff, 4, ESP, 28); // jmp dword [esp + 28]，即参数 start
+#endif
+}
+
+void TemplateCompiler::epilogue()
+{
+    a.rexw(true);
+    a.byte(0x89); a.byte(0xf8); // mov eax, edi，返回栈顶
+    a.byte(0x59); // pop ecx，丢掉 exitIp
+    a.byte(0x5f); // pop edi
+    a.byte(0x5e); // pop esi
+    a.byte(0xc3); // ret
+}
+
+/*
+ * 退出编译后的代码，解释器从 @pc 处的指令继续执行
+ */
+void TemplateCompiler::exitTo(size_t pc)
+{
+    Cell *cell = m->threadedCode->cellAt(pc);
+    a.load(ECX, ESP, 0, true); // exitIp
+#if JIT_64
+    a.movImm(EAX, (intptr_t) cell);
+    a.store(ECX, 0, EAX, true);
+#else
+    a.storeImm(ECX, 0, (s4) (intptr_t) cell);
+#endif
+    exits.push_back(a.jmp());
+}
+
+/*
+ * 跳转到字节码的 @target 处，@cc 为跳转的条件，小于 0 时无条件跳转。
+ * 向后跳转时与解释器一样为 Method::backedgeCount 计数，
+ * 并检查 g_gc_requested，有 GC 请求时在 @target 处退出，由解释器进入 safepoint.
+ */
+void TemplateCompiler::branch(int cc, size_t pc, size_t target)
+{
+    if (target > pc) {
+        fixups.push_back({ cc < 0 ? a.jmp() : a.jcc((Cond) cc), target });
+        return;
+    }
+
+    size_t skip = SIZE_MAX;
+    if (cc >= 0)
+        skip = a.jcc8(inverse((Cond) cc));
+#if JIT_64
+    a.movImm(EAX, (intptr_t) &m->backedgeCount);
+    a.op(0x83, 0, EAX, 0, true); // add qword [rax], 1
+    a.byte(1);
+    a.movImm(EAX, (intptr_t) &g_gc_requested);
+    a.op(0x80, 7, EAX, 0); // cmp byte [rax], 0
+    a.byte(0);
+#else
+    a.byte(0x83); a.byte(0x05); // add dword [&backedgeCount], 1
+    a.int32((s4) (intptr_t) &m->backedgeCount);
+    a.byte(1);
+    a.byte(0x83); a.byte(0x15); // adc dword [&backedgeCount + 4], 0
+    a.int32((s4) ((intptr_t) &m->backedgeCount + 4));
+    a.byte(0);
+    a.byte(0x80); a.byte(0x3d); // cmp byte [&g_gc_requested], 0
+    a.int32((s4) (intptr_t) &g_gc_requested);
+    a.byte(0);
+#endif
+    fixups.push_back({ a.jcc(CC_E), target });
+    exitTo(target);
+    if (skip != SIZE_MAX)
+        a.bind8(skip);
+}
+
+/*
+ * 翻译 @pc 处的指令，不支持的指令返回 false
+ */
+bool TemplateCompiler::emitTemplate(size_t pc)
+{
+    // ifeq ~ ifle 和 if_icmpeq ~ if_icmple 对应的条件
+    static const Cond conds[] = { CC_E, CC_NE, CC_L, CC_GE, CC_G, CC_LE };
+
+    const u1 *code = m->code;
+    u1 opcode = code[pc];
+    const u1 *operands = code + pc + 1;
+
+    switch (opcode) {
+        case OPC_NOP:
+            return true;
+
+        case OPC_ACONST_NULL:
+            a.storeImm(SP, 0, 0, true);
+            a.addImm(SP, S);
+            return true;
+        case OPC_ICONST_M1: case OPC_ICONST_0: case OPC_ICONST_1: case OPC_ICONST_2:
+        case OPC_ICONST_3: case OPC_ICONST_4: case OPC_ICONST_5:
+            pushImm(opcode - OPC_ICONST_0);
+            return true;
+        case OPC_BIPUSH:
+            pushImm((s1) operands[0]);
+            return true;
+        case OPC_SIPUSH:
+            pushImm((s2) read_u2(operands));
+            return true;
+
+        // 类型一的值按 slot 整个复制，类型二复制两个 slot
+        case OPC_ILOAD: case OPC_FLOAD: case OPC_ALOAD:
+            loadLocal(operands[0], 1);
+            return true;
+        case OPC_LLOAD: case OPC_DLOAD:
+            loadLocal(operands[0], 2);
+            return true;
+        case OPC_ILOAD_0: case OPC_ILOAD_1: case OPC_ILOAD_2: case OPC_ILOAD_3:
+            loadLocal(opcode - OPC_ILOAD_0, 1);
+            return true;
+        case OPC_LLOAD_0: case OPC_LLOAD_1: case OPC_LLOAD_2: case OPC_LLOAD_3:
+            loadLocal(opcode - OPC_LLOAD_0, 2);
+            return true;
+        case OPC_FLOAD_0: case OPC_FLOAD_1: case OPC_FLOAD_2: case OPC_FLOAD_3:
+            loadLocal(opcode - OPC_FLOAD_0, 1);
+            return true;
+        case OPC_DLOAD_0: case OPC_DLOAD_1: case OPC_DLOAD_2: case OPC_DLOAD_3:
+            loadLocal(opcode - OPC_DLOAD_0, 2);
+            return true;
+        case OPC_ALOAD_0: case OPC_ALOAD_1: case OPC_ALOAD_2: case OPC_ALOAD_3:
+            loadLocal(opcode - OPC_ALOAD_0, 1);
+            return true;
+
+        case OPC_ISTORE: case OPC_FSTORE: case OPC_ASTORE:
+            storeLocal(operands[0], 1);
+            return true;
+        case OPC_LSTORE: case OPC_DSTORE:
+            storeLocal(operands[0], 2);
+            return true;
+        case OPC_ISTORE_0: case OPC_ISTORE_1: case OPC_ISTORE_2: case OPC_ISTORE_3:
+            storeLocal(opcode - OPC_ISTORE_0, 1);
+            return true;
+        case OPC_LSTORE_0: case OPC_LSTORE_1: case OPC_LSTORE_2: case OPC_LSTORE_3:
+            storeLocal(opcode - OPC_LSTORE_0, 2);
+            return true;
+        case OPC_FSTORE_0: case OPC_FSTORE_1: case OPC_FSTORE_2: case OPC_FSTORE_3:
+            storeLocal(opcode - OPC_FSTORE_0, 1);
+            return true;
+        case OPC_DSTORE_0: case OPC_DSTORE_1: case OPC_DSTORE_2: case OPC_DSTORE_3:
+            storeLocal(opcode - OPC_DSTORE_0, 2);
+            return true;
+        case OPC_ASTORE_0: case OPC_ASTORE_1: case OPC_ASTORE_2: case OPC_ASTORE_3:
+            storeLocal(opcode - OPC_ASTORE_0, 1);
+            return true;
+
+        case OPC_POP:
+            a.addImm(SP, -S);
+            return true;
+        case OPC_POP2:
+            a.addImm(SP, -2 * S);
+            return true;
+        case OPC_DUP:
+            a.load(EAX, SP, -S, true);
+            a.store(SP, 0, EAX, true);
+            a.addImm(SP, S);
+            return true;
+        case OPC_SWAP:
+            a.load(EAX, SP, -S, true);
+            a.load(ECX, SP, -2 * S, true);
+            a.store(SP, -2 * S, EAX, true);
+            a.store(SP, -S, ECX, true);
+            return true;
+
+        // int 的运算只读写 slot 的低 32 位（见 ISLOT）
+        case OPC_IADD: case OPC_ISUB: case OPC_IAND: case OPC_IOR: case OPC_IXOR: {
+            u1 alu = opcode == OPC_IADD ? 0x01 : opcode == OPC_ISUB ? 0x29
+                     : opcode == OPC_IAND ? 0x21 : opcode == OPC_IOR ? 0x09 : 0x31;
+            a.addImm(SP, -S);
+            a.load(EAX, SP, 0);
+            a.op(alu, EAX, SP, -S); // op [sp - 1], eax
+            return true;
+        }
+        case OPC_IMUL:
+            a.addImm(SP, -S);
+            a.load(EAX, SP, -S);
+            a.op(0x0faf, EAX, SP, 0); // imul eax, [sp]
+            a.store(SP, -S, EAX);
+            return true;
+        case OPC_INEG:
+            a.op(0xf7, 3, SP, -S);
+            return true;
+        case OPC_ISHL: case OPC_ISHR: case OPC_IUSHR:
+            // 移位的次数取低 5 位，和 Java 的语义相同
+            a.addImm(SP, -S);
+            a.load(ECX, SP, 0);
+            a.op(0xd3, opcode == OPC_ISHL ? 4 : opcode == OPC_ISHR ? 7 : 5, SP, -S); // shl/sar/shr [sp - 1], cl
+            return true;
+        case OPC_IINC:
+            a.op(0x81, 0, LOCALS, operands[0] * S); // add [locals + index], imm32
+            a.int32((s1) operands[1]);
+            return true;
+        case OPC_I2B: case OPC_I2C: case OPC_I2S:
+            a.op(opcode == OPC_I2B ? 0x0fbe : opcode == OPC_I2C ? 0x0fb7 : 0x0fbf, EAX, SP, -S); // movsx/movzx
+            a.store(SP, -S, EAX);
+            return true;
+
+        case OPC_IFEQ: case OPC_IFNE: case OPC_IFLT: case OPC_IFGE: case OPC_IFGT: case OPC_IFLE:
+            a.addImm(SP, -S);
+            a.op(0x83, 7, SP, 0); // cmp [sp], 0
+            a.byte(0);
+            branch(conds[opcode - OPC_IFEQ], pc, pc + (s2) read_u2(operands));
+            return true;
+        case OPC_IF_ICMPEQ: case OPC_IF_ICMPNE: case OPC_IF_ICMPLT:
+        case OPC_IF_ICMPGE: case OPC_IF_ICMPGT: case OPC_IF_ICMPLE:
+            a.addImm(SP, -2 * S);
+            a.load(EAX, SP, 0);
+            a.op(0x3b, EAX, SP, S); // cmp eax, [sp + 1]
+            branch(conds[opcode - OPC_IF_ICMPEQ], pc, pc + (s2) read_u2(operands));
+            return true;
+        case OPC_IF_ACMPEQ: case OPC_IF_ACMPNE:
+            a.addImm(SP, -2 * S);
+            a.load(EAX, SP, 0, true);
+            a.op(0x3b, EAX, SP, S, true);
+            branch(opcode == OPC_IF_ACMPEQ ? CC_E : CC_NE, pc, pc + (s2) read_u2(operands));
+            return true;
+        case OPC_IFNULL: case OPC_IFNONNULL:
+            a.addImm(SP, -S);
+            a.load(EAX, SP, 0, true);
+            a.rexw(true);
+            a.byte(0x85); a.byte(0xc0); // test eax, eax
+            branch(opcode == OPC_IFNULL ? CC_E : CC_NE, pc, pc + (s2) read_u2(operands));
+            return true;
+        case OPC_GOTO:
+            branch(-1, pc, pc + (s2) read_u2(operands));
+            return true;
+        case OPC_GOTO_W:
+            branch(-1, pc, pc + read_s4(operands));
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+bool TemplateCompiler::compile()
+{
+    prologue();
+    for (size_t pc = 0; pc < m->codeLen; pc += bytecode_length(m->code, pc)) {
+        nativeOffsets[pc] = a.offset();
+        if (emitTemplate(pc)) {
+            resumable[pc] = true;
+            supported++;
+        } else {
+            if (pc == 0)
+                return false;
+            exitTo(pc);
+        }
+    }
+
+    size_t end = a.offset();
+    epilogue();
+    for (size_t at : exits)
+        a.bind(at, end);
+    for (auto &f : fixups) {
+        assert(f.targetPc < m->codeLen && nativeOffsets[f.targetPc] != SIZE_MAX);
+        a.bind(f.at, nativeOffsets[f.targetPc]);
+    }
+    return true;
+}
+
+static CodeCache codeCache;
+
+// 保护 codeCache, compiled, stats 以及方法的 jitEntry 和 jitState 的修改
+static pthread_mutex_t jitMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// 代码缓存中的所有方法
+struct CompiledMethod {
+    Method *method;
+    void *code;
+    size_t size;
+};
+static vector<CompiledMethod> compiled;
+
+static struct {
+    size_t compiled = 0;
+    size_t notCompilable = 0;
+    size_t cacheFull = 0;   // 代码缓存已满，编译失败的次数
+    size_t evicted = 0;
+    size_t sweeps = 0;
+    size_t bytecodeBytes = 0;
+    size_t codeBytes = 0;
+    double ms = 0;
+} stats;
+
+bool jit_init(size_t codeCacheSize)
+{
+    if (!JIT_SUPPORTED)
+        return false;
+    return codeCache.init(codeCacheSize);
+}
+
+JitEntry jit_compile(Method *m)
+{
+    assert(m->threadedCode != nullptr);
+
+    pthread_mutex_lock(&jitMutex);
+    JitEntry entry = m->jitEntry;
+    if (entry != nullptr || m->jitState != JIT_INTERPRETED || !codeCache.inited()) {
+        pthread_mutex_unlock(&jitMutex);
+        return entry;
+    }
+
+    auto start = chrono::steady_clock::now();
+    TemplateCompiler compiler(m);
+    if (m->codeLen > VM_JIT_MAX_CODE_LENGTH || !compiler.compile()) {
+        m->jitState = JIT_NOT_COMPILABLE;
+        stats.notCompilable++;
+        pthread_mutex_unlock(&jitMutex);
+        return nullptr;
+    }
+
+    const vector<u1> &code = compiler.code();
+    void *p = codeCache.alloc(code.size());
+    if (p == nullptr) {
+        // 等 GC 回收了代码缓存之后，方法重新变热时再编译
+        m->jitCountBase = m->hotness();
+        stats.cacheFull++;
+        pthread_mutex_unlock(&jitMutex);
+        return nullptr;
+    }
+
+    memcpy(p, code.data(), code.size());
+    compiled.push_back({ m, p, code.size() });
+    entry = (JitEntry) p;
+    m->jitResumeOffsets = compiler.resumeOffsets();
+    m->jitState = JIT_COMPILED;
+    m->jitUsed = true;
+    __atomic_store_n(&m->jitEntry, entry, __ATOMIC_RELEASE);
+
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    stats.compiled++;
+    stats.bytecodeBytes += m->codeLen;
+    stats.codeBytes += code.size();
+    stats.ms += ms;
+    if (g_print_compilation) {
+        printf("[JIT #%zu: %s.%s%s, %zu bytes of bytecode (%zu instructions compiled) -> %zu bytes, %.3f ms]\n",
+               stats.compiled, m->clazz->className, m->name, m->descriptor,
+               m->codeLen, compiler.supported, code.size(), ms);
+    }
+    pthread_mutex_unlock(&jitMutex);
+    return entry;
+}
+
+// 在锁内调用
+static void evict(size_t i)
+{
+    CompiledMethod &c = compiled[i];
+    codeCache.free(c.code, c.size);
+    c.method->jitEntry = nullptr;
+    delete[] c.method->jitResumeOffsets;
+    c.method->jitResumeOffsets = nullptr;
+    c.method->jitState = JIT_INTERPRETED;
+    c.method->jitCountBase = c.method->hotness();
+    compiled[i] = compiled.back();
+    compiled.pop_back();
+}
+
+const void *jit_resume_point(const Method *m, JitEntry entry, const Cell *cell)
+{
+    const ThreadedCode *tc = m->threadedCode;
+    assert(entry != nullptr && tc->cells <= cell && cell < tc->cells + tc->length);
+    u4 offset = m->jitResumeOffsets[cell - tc->cells];
+    if (offset == JIT_NOT_RESUMABLE)
+        return nullptr;
+    return (const u1 *) entry + offset;
+}
+
+void jit_release(Method *m)
+{
+    pthread_mutex_lock(&jitMutex);
+    for (size_t i = 0; i < compiled.size(); i++) {
+        if (compiled[i].method == m) {
+            evict(i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&jitMutex);
+}
+
+void jit_sweep_code_cache()
+{
+    pthread_mutex_lock(&jitMutex);
+    if (codeCache.usedBytes() * 100 < codeCache.capacityBytes() * VM_CODE_CACHE_SWEEP_OCCUPANCY) {
+        pthread_mutex_unlock(&jitMutex);
+        return;
+    }
+
+    stats.sweeps++;
+    size_t evicted = 0;
+    for (size_t i = 0; i < compiled.size();) {
+        Method *m = compiled[i].method;
+        if (m->jitUsed) {
+            m->jitUsed = false;
+            i++;
+        } else {
+            evict(i);
+            evicted++;
+        }
+    }
+    stats.evicted += evicted;
+
+    if (g_print_compilation) {
+        printf("[JIT (sweep) #%zu: %zu methods evicted, code cache %zu of %zu bytes used]\n",
+               stats.sweeps, evicted, codeCache.usedBytes(), codeCache.capacityBytes());
+    }
+    pthread_mutex_unlock(&jitMutex);
+}
+
+void print_jit_stats()
+{
+    pthread_mutex_lock(&jitMutex);
+    printf("JIT statistics\n");
+    printf("  compiled methods: %zu, %zu bytes of bytecode -> %zu bytes, %.3f ms\n",
+           stats.compiled, stats.bytecodeBytes, stats.codeBytes, stats.ms);
+    printf("  not compilable: %zu, code cache full: %zu\n", stats.notCompilable, stats.cacheFull);
+    printf("  code cache: %zu of %zu bytes used, %zu sweeps, %zu methods evicted\n",
+           codeCache.usedBytes(), codeCache.capacityBytes(), stats.sweeps, stats.evicted);
+    pthread_mutex_unlock(&jitMutex);
+}
@@ -0,0 +1,95 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_JIT_H
+#define KAYOVM_JIT_H
+
+#include <cstddef>
+#include "../slot.h"
+
+class Method;
+union Cell;
+
+/*
+ * 模板 JIT（template JIT）
+ *
+ * 方法先由解释器执行（第 0 层），解释执行的调用次数和向后跳转的次数（Method::invocationCount,
+ * Method::backedgeCount）之和增加了 VM_JIT_THRESHOLD 后，在下一次调用或者下一次向后跳转时
+ * 把方法编译为本地代码（第 1 层）。
+ * 编译不做寄存器分配和优化：每条字节码对应一段固定的机器码模板，依次拼接，
+ * 局部变量表和操作数栈仍然是栈桢中的那一块内存，寄存器中不保存跨指令的状态，
+ * 所以编译后的代码可以在任何一条指令处退回解释器，也可以从任何一条编译了的指令处进入：
+ * 1. 不支持的指令（调用、字段、数组、对象、long/float/double 的运算等）编译为退出，
+ *    解释器从这条指令继续执行，之后在向后跳转时，如果跳转的目标编译了，就从目标处重新进入编译后的代码，
+ *    所以循环体中有不支持的指令时，每一轮循环只有这些指令由解释器执行；
+ * 2. 返回指令也编译为退出，由解释器完成返回；
+ * 3. 向后跳转时检查 g_gc_requested，有 GC 请求时在跳转的目标处退出，由解释器进入 safepoint，
+ *    然后从这个位置重新进入编译后的代码。
+ * 解释执行中的方法在向后跳转时变热的，在跳转的目标处进入刚编译好的代码，长时间运行的循环不用等到下一次调用。
+ * 编译后的代码不调用任何函数、不分配对象、不抛出异常，执行期间线程不会停在 safepoint.
+ *
+ * 支持 x86 和 x86-64（System V 和 Windows 的调用约定），其他平台上不编译。
+ * 编译后的代码存放在代码缓存中（见 CodeCache），缓存的占用率超过 VM_CODE_CACHE_SWEEP_OCCUPANCY 时，
+ * GC 暂停期间回收上次回收以来没有执行过的方法的代码，这些方法重新由解释器执行，从当时的热度重新开始为 JIT 计数。
+ */
+
+/*
+ * 编译后的代码的入口。
+ * @locals: 栈桢的局部变量表，@sp: 操作数栈的栈顶，@start: 开始执行的位置，见 jit_resume_point
+ * 返回退出时操作数栈的栈顶，并把解释器继续执行的单元（方法的线索码中）存入 @exitIp.
+ */
+typedef slot_t *(*JitEntry)(slot_t *locals, slot_t *sp, Cell **exitIp, const void *start);
+
+// Method::jitResumeOffsets 中表示这条指令没有编译，不能从这里进入
+#define JIT_NOT_RESUMABLE ((u4) -1)
+
+// 方法的编译状态
+enum JitState : u1 {
+    JIT_INTERPRETED,     // 还没有编译，或者编译后的代码已经被回收
+    JIT_COMPILED,
+    JIT_NOT_COMPILABLE,  // 不值得编译，不再尝试
+};
+
+// 当前平台是否支持 JIT
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+/*
+ * 创建大小为 @codeCacheSize 的代码缓存，失败时返回 false，此时不编译任何方法。
+ */
+bool jit_init(size_t codeCacheSize);
+
+/*
+ * 编译方法 @m，@m 的线索码已经翻译好了。
+ * 返回编译后的代码的入口，@m 不能编译或者代码缓存已满时返回 nullptr.
+ */
+JitEntry jit_compile(Method *m);
+
+/*
+ * 方法 @m 编译后的代码（入口为 @entry）中对应线索码单元 @cell 的位置，用作 JitEntry 的参数 start.
+ * @cell 处的指令编译为了退出时（或者 @cell 不是一条指令的第一个单元）返回 nullptr.
+ * 调用者读取 @m 的 jitEntry 之后，到进入编译后的代码之前不能进入 safepoint，否则代码可能已经被回收了。
+ */
+const void *jit_resume_point(const Method *m, JitEntry entry, const Cell *cell);
+
+/*
+ * 释放 @m 编译后的代码，在 @m 销毁时调用
+ */
+void jit_release(Method *m);
+
+/*
+ * 代码缓存的占用率超过 VM_CODE_CACHE_SWEEP_OCCUPANCY 时，回收上次回收以来没有执行过的方法的代码。
+ * 在 GC 暂停期间调用，这时没有线程在执行编译后的代码。
+ */
+void jit_sweep_code_cache();
+
+/*
+ * 打印 JIT 统计（-XX:+PrintCompilation）
+ */
+void print_jit_stats();
+
+#endif //KAYOVM_JIT_H
@@ -13,8 +13,14 @@
 #include "rtda/thread/Thread.h"
 #include "rtda/ma/Class.h"
 #include "interpreter/interpreter.h"
+#include "interpreter/InlineCache.h"
+#include "interpreter/OpcodeProfile.h"
+#include "jit/jit.h"
 #include "rtda/heap/StrPool.h"
 #include "native/registry.h"
+#include "heapmgr/TLAB.h"
+#include "heapmgr/gc.h"
+#include "config.h"
 
 using namespace std;
 
@@ -25,6 +31,9 @@ using namespace std;
 #endif
 
 HeapMgr g_heap_mgr;
+Nursery g_nursery;
+CardTable g_card_table;
+LargeObjectSpace g_large_objects;
 
 vector<std::string> jreLibJars;
 vector<std::string> jreExtJars;
@@ -37,11 +46,27 @@ Object *sysThreadGroup;
 
 vector<Thread *> g_all_threads;
 
+vector<Class *> g_all_classes;
+pthread_mutex_t g_all_classes_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+bool g_print_tlab = false;
+bool g_print_gc = false;
+bool g_print_inline_caches = false;
+bool g_print_hot_methods = false;
+bool g_profile_opcodes = false;
+bool g_profile_opcode_cycles = false;
+const char *g_profile_opcodes_file = "opcode_profile.json";
+bool g_use_jit = JIT_SUPPORTED;
+bool g_print_compilation = false;
+
+// 主线程 C 栈的底，GC 保守扫描主线程的 C 栈到这里为止
+static void *mainStackBase = nullptr;
+
 void init_symbol();
 
 static void *gcLoop(void *arg)
 {
-    // todo
+    gc_loop();
     return nullptr;
 }
 
@@ -76,14 +101,42 @@ static void findJars(const char *path, vector<std::string> &result)
 
 static char main_class_name[FILENAME_MAX] = { 0 };
 
+/*
+ * 解析内存大小，比如 512k, 16m, 1g，没有单位时是字节数。
+ * 格式错误时返回 0.
+ */
+static size_t parseMemorySize(const char *s)
+{
+    char *end;
+    unsigned long long size = strtoull(s, &end, 10);
+    if (end == s)
+        return 0;
+
+    switch (*end) {
+        case 'k': case 'K': size *= 1024; end++; break;
+        case 'm': case 'M': size *= 1024*1024; end++; break;
+        case 'g': case 'G': size *= 1024*1024*1024; end++; break;
+        default: break;
+    }
+    return *end == 0 ? (size_t) size : 0;
+}
+
 void initJVM(int argc, char* argv[])
 {
+    if (mainStackBase == nullptr) {
+        mainStackBase = __builtin_frame_address(0);
+    }
+
 //    time_t time1;
 //    time(&time1);
 
     char bootstrap_classpath[PATH_MAX] = { 0 };
     char extension_classpath[PATH_MAX] = { 0 };
     char user_classpath[PATH_MAX] = { 0 };
+    size_t nursery_size = VM_NURSERY_SIZE;
+    size_t heap_initial = 0, heap_max = 0; // 0 表示没有指定
+    bool use_huge_pages = false;
+    int parallel_gc_threads = 0;
 
     // parse cmd arguments
     // 可执行程序的名字为 argv[0]，跳过。
@@ -100,6 +153,45 @@ void initJVM(int argc, char* argv[])
                     jvm_abort("缺少参数：%s\n", name);
                 }
                 strcpy(user_classpath, argv[i]);
+            } else if (strncmp(name, "-Xmn", 4) == 0) { // nursery size, 比如 -Xmn16m
+                nursery_size = parseMemorySize(name + 4);
+                if (nursery_size == 0) {
+                    jvm_abort("参数格式错误：%s\n", name);
+                }
+            } else if (strncmp(name, "-Xms", 4) == 0 || strncmp(name, "-Xmx", 4) == 0) { // heap size, 比如 -Xmx512m
+                size_t size = parseMemorySize(name + 4);
+                if (size == 0) {
+                    jvm_abort("参数格式错误：%s\n", name);
+                }
+                (name[3] == 's' ? heap_initial : heap_max) = size;
+            } else if (strcmp(name, "-XX:+UseTransparentHugePages") == 0) {
+                use_huge_pages = true;
+            } else if (strncmp(name, "-XX:ParallelGCThreads=", 22) == 0) {
+                parallel_gc_threads = atoi(name + 22);
+                if (parallel_gc_threads <= 0) {
+                    jvm_abort("参数格式错误：%s\n", name);
+                }
+            } else if (strcmp(name, "-XX:+PrintTLAB") == 0) {
+                g_print_tlab = true;
+            } else if (strcmp(name, "-XX:+PrintGC") == 0) {
+                g_print_gc = true;
+            } else if (strcmp(name, "-XX:+PrintInlineCaches") == 0) {
+                g_print_inline_caches = true;
+            } else if (strcmp(name, "-XX:+PrintHotMethods") == 0) {
+                g_print_hot_methods = true;
+            } else if (strcmp(name, "-XX:+ProfileOpcodes") == 0) {
+                g_profile_opcodes = true;
+            } else if (strcmp(name, "-XX:+ProfileOpcodeCycles") == 0) {
+                g_profile_opcodes = g_profile_opcode_cycles = true;
+            } else if (strncmp(name, "-XX:ProfileOpcodesFile=", 23) == 0) {
+                g_profile_opcodes_file = name + 23;
+                if (*g_profile_opcodes_file == 0) {
+                    jvm_abort("参数格式错误：%s\n", name);
+                }
+            } else if (strcmp(name, "-XX:+UseJIT") == 0 || strcmp(name, "-XX:-UseJIT") == 0) {
+                g_use_jit = name[4] == '+';
+            } else if (strcmp(name, "-XX:+PrintCompilation") == 0) {
+                g_print_compilation = true;
             } else {
                 jvm_abort("unknown 参数: %s\n", name);
             }
@@ -108,6 +200,24 @@ void initJVM(int argc, char* argv[])
         }
     }
 
+    if (heap_initial > 0 && heap_max > 0 && heap_initial > heap_max) {
+        jvm_abort("初始堆大小（-Xms）大于最大堆大小（-Xmx）\n");
+    }
+    if (heap_max == 0)
+        heap_max = heap_initial > VM_HEAP_MAX_SIZE ? heap_initial : VM_HEAP_MAX_SIZE;
+    if (heap_initial == 0)
+        heap_initial = heap_max < VM_HEAP_SIZE ? heap_max : VM_HEAP_SIZE;
+    if (g_profile_opcodes) {
+        // 编译后的代码执行的指令统计不到
+        g_use_jit = false;
+        opcode_profile_init();
+    }
+    g_heap_mgr.init(heap_initial, heap_max, use_huge_pages);
+    gc_init(nursery_size, parallel_gc_threads);
+    if (g_use_jit && !jit_init(VM_CODE_CACHE_SIZE)) {
+        g_use_jit = false;
+    }
+
     // 如果 main_class_name 有 .class 后缀，去掉后缀。
     char *p = strrchr(main_class_name, '.');
     if (p != nullptr && strcmp(p, ".class") == 0) {
@@ -186,7 +296,7 @@ void initJVM(int argc, char* argv[])
 //
 //    printf("init...: %lds\n", ((long)(time3)) - ((long)(time2)));
 
-    initMainThread();
+    initMainThread(mainStackBase);
 
 //    time_t time4;
 //    time(&time4);
@@ -215,6 +325,9 @@ void initJVM(int argc, char* argv[])
  */
 int runJVM(int argc, char* argv[])
 {
+    // 之后在主线程中执行的所有 Java 代码的 C 栈桢都在 runJVM 的栈桢之下
+    mainStackBase = __builtin_frame_address(0);
+
     time_t time1;
     time(&time1);
 
@@ -242,6 +355,7 @@ int runJVM(int argc, char* argv[])
     }
 
     createVMThread(gcLoop); // gc thread
+    gc_start_workers();
 
     // 开始在主线程中执行 main 方法
     TRACE("begin to execute main function.\n");
@@ -254,6 +368,28 @@ int runJVM(int argc, char* argv[])
     time_t time3;
     time(&time3);
 
+    if (g_print_tlab) {
+        print_tlab_stats();
+    }
+    if (g_print_gc) {
+        print_gc_stats();
+    }
+    if (g_print_inline_caches) {
+        print_inline_cache_stats();
+    }
+    if (g_print_hot_methods) {
+        print_hot_methods();
+    }
+    if (g_profile_opcodes) {
+        dump_opcode_profile();
+    }
+    if (g_print_compilation) {
+        print_jit_stats();
+    }
+#if PROFILE_NGRAMS
+    print_opcode_ngrams();
+#endif
+
 //    printf("init jvm: %lds\n", ((long)(time2)) - ((long)(time1)));
     printf("run jvm: %lds\n", ((long)(time3)) - ((long)(time1)));
     return 0;
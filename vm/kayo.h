@@ -19,9 +19,19 @@
 
 extern HeapMgr g_heap_mgr;
 
+class Nursery;
+class CardTable;
+class LargeObjectSpace;
+
+// 新生代、记录老年代中引用了新生代对象的卡表和大对象空间，见 heapmgr/gc.h
+extern Nursery g_nursery;
+extern CardTable g_card_table;
+extern LargeObjectSpace g_large_objects;
+
 class ClassLoader;
 class StrPool;
 struct Thread;
+class Class;
 
 
 // 启动类路径（bootstrap classpath）默认对应 jre/lib 目录，Java标准库（大部分在rt.jar里）位于该路径
@@ -49,6 +59,38 @@ extern Object *sysThreadGroup;
 // todo 所有线程
 extern std::vector<Thread *> g_all_threads;
 
+// 所有创建了的类，GC 从这里找到类的静态变量等 GC Roots
+// 加载类的线程可能与 GC、统计同时访问，添加和遍历时都要持有 g_all_classes_mutex
+extern std::vector<Class *> g_all_classes;
+extern pthread_mutex_t g_all_classes_mutex;
+
+// -XX:+PrintTLAB, 虚拟机退出时打印 TLAB 的分配统计
+extern bool g_print_tlab;
+
+// -XX:+PrintGC, 每次 GC 后打印一行，虚拟机退出时打印 GC 的统计
+extern bool g_print_gc;
+
+// -XX:+PrintInlineCaches, 虚拟机退出时打印每个调用点的内联缓存统计
+extern bool g_print_inline_caches;
+
+// -XX:+PrintHotMethods, 虚拟机退出时打印调用次数和向后跳转的次数最多的方法
+extern bool g_print_hot_methods;
+
+// -XX:+ProfileOpcodes, 统计每种指令的执行次数，见 OpcodeProfile.h
+extern bool g_profile_opcodes;
+
+// -XX:+ProfileOpcodeCycles, 同时统计每种指令占用的时钟周期，打开 -XX:+ProfileOpcodes
+extern bool g_profile_opcode_cycles;
+
+// -XX:ProfileOpcodesFile=<file>, 指令统计写入的文件，以 .csv 结尾时写 CSV，否则写 JSON
+extern const char *g_profile_opcodes_file;
+
+// -XX:+UseJIT/-XX:-UseJIT, 是否由 JIT 编译热点方法，平台支持时默认打开，见 jit.h
+extern bool g_use_jit;
+
+// -XX:+PrintCompilation, 编译每个方法时打印一行，虚拟机退出时打印 JIT 的统计
+extern bool g_print_compilation;
+
 /*
  * jvms规定函数最多有255个参数，this也算，long和double占两个长度
  */
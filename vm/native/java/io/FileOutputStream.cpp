@@ -63,7 +63,7 @@ static void writeBytes(Frame *frame)
     bool append = frame->getLocalAsBool(4);
 
     // todo
-    auto data = (jbyte *) b->data;
+    auto data = (jbyte *) b->elements();
     write_bytes(thisObj, data + off, len, append);
     /*
     fdObj := fosObj.GetFieldValue("fd~Ljava/io/FileDescriptor;").(*heap.Object)
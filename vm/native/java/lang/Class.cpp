@@ -567,7 +567,7 @@ static void getDeclaredFields0(Frame *frame)
                 (slot_t) g_str_pool->get(cls->fields[i]->name), // name
                 (slot_t) cls->fields[i]->getType(), // type
                 cls->fields[i]->accessFlags, /* modifiers */
-                (slot_t) cls->fields[i]->id, /* slot   todo */
+                (slot_t) cls->fields[i]->offset, /* slot: 实例变量的字节偏移，Unsafe.objectFieldOffset 返回它 */
                 (slot_t) nullptr, /* signature  todo */
                 (slot_t) nullptr, /* annotations  todo */
         });
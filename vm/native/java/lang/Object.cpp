@@ -12,7 +12,7 @@
 static void hashCode(Frame *frame)
 {
     jref _this = frame->getLocalAsRef(0);
-    frame->pushi((jint) (intptr_t) _this);
+    frame->pushi(_this->identityHashCode());
 }
 
 // protected native Object clone() throws CloneNotSupportedException;
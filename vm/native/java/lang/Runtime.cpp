@@ -6,6 +6,8 @@
 #include "../../registry.h"
 #include "../../../slot.h"
 #include "../../../rtda/thread/Frame.h"
+#include "../../../kayo.h"
+#include "../../../heapmgr/gc.h"
 
 // public native int availableProcessors();
 static void availableProcessors(Frame *frame)
@@ -19,25 +21,25 @@ static void availableProcessors(Frame *frame)
 // public native long freeMemory();
 static void freeMemory(Frame *frame)
 {
-    jvm_abort("freeMemory");
+    frame->pushl((jlong) (g_heap_mgr.freeBytes + g_nursery.freeBytes()));
 }
 
 // public native long totalMemory();
 static void totalMemory(Frame *frame)
 {
-    jvm_abort("totalMemory");
+    frame->pushl((jlong) (g_heap_mgr.capacity() + g_large_objects.committedBytes + g_nursery.capacity()));
 }
 
 // public native long maxMemory();
 static void maxMemory(Frame *frame)
 {
-    jvm_abort("maxMemory");
+    frame->pushl((jlong) (g_heap_mgr.maxCapacity() + g_nursery.capacity()));
 }
 
 // public native void gc();
 static void gc(Frame *frame)
 {
-    jvm_abort("gc");
+    gc_collect(true);
 }
 
 /* Wormhole for calling java.lang.ref.Finalizer.runFinalization */
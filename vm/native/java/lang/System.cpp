@@ -55,7 +55,7 @@ static void arraycopy(Frame *frame)
 static void identityHashCode(Frame *frame)
 {
     jref x = frame->getLocalAsRef(0);
-    frame->pushi((jint) (intptr_t) x);
+    frame->pushi(x != nullptr ? x->identityHashCode() : 0);
 }
 
 /*
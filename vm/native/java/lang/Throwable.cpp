@@ -5,6 +5,7 @@
 #include "../../registry.h"
 #include "../../../rtda/heap/Object.h"
 #include "../../../rtda/heap/StringObject.h"
+#include "../../../rtda/heap/ArrayObject.h"
 #include "../../../rtda/thread/Thread.h"
 #include "../../../utf8.h"
 #include "../../../symbol.h"
@@ -49,28 +50,36 @@ static void fillInStackTrace(Frame *frame)
         }
     }
 
-    auto trace = new vector<Object *>;
+    int depth = 0;
+    for (Frame *t = f; t != nullptr; t = t->prev)
+        depth++;
+
+    /*
+     * 栈信息保存在 Throwable 的 backtrace 字段中（private transient Object backtrace;），
+     * 这样 GC 可以追踪到它们。
+     * 先把数组赋给 backtrace，之后每新建一个对象都立即放入数组，
+     * 保证在后续分配对象触发 GC 时它们都是可达的。
+     */
+    auto trace = ArrayObject::newInst(java_lang_Object_array_class, depth);
+    _this->setFieldValue(S(backtrace), S(sig_java_lang_Object), (slot_t) trace);
 
     Class *c = loadSysClass(S(java_lang_StackTraceElement));
-    for (; f != nullptr; f = f->prev) {
+    for (int i = 0; f != nullptr; f = f->prev, i++) {
         Object *o = Object::newInst(c);
-        trace->push_back(o);
+        trace->set(i, o);
 
         // public StackTraceElement(String declaringClass, String methodName, String fileName, int lineNumber)
         // may be should call <init>, but 直接赋值 is also ok. todo
 
-        auto fileName = StringObject::newInst(f->method->clazz->sourceFileName);
-        auto className = StringObject::newInst(f->method->clazz->className);
-        auto methodName = StringObject::newInst(f->method->name);
-        int lineNumber = f->method->getLineNumber(f->reader.pc - 1); // todo why 减1？ 减去opcode的长度
-
-        o->setFieldValue("fileName", "Ljava/lang/String;", (slot_t) (fileName));
-        o->setFieldValue("declaringClass", "Ljava/lang/String;", (slot_t) className);
-        o->setFieldValue("methodName", "Ljava/lang/String;", (slot_t) methodName);
+        o->setFieldValue("fileName", "Ljava/lang/String;",
+                         (slot_t) StringObject::newInst(f->method->clazz->sourceFileName));
+        o->setFieldValue("declaringClass", "Ljava/lang/String;",
+                         (slot_t) StringObject::newInst(f->method->clazz->className));
+        o->setFieldValue("methodName", "Ljava/lang/String;",
+                         (slot_t) StringObject::newInst(f->method->name));
+        int lineNumber = f->method->getLineNumber(f->pc());
         o->setFieldValue("lineNumber", S(I), (slot_t) lineNumber);
     }
-
-    _this->extra = trace;
 }
 
 // native StackTraceElement getStackTraceElement(int index);
@@ -79,18 +88,18 @@ static void getStackTraceElement(Frame *frame)
     jref _this = frame->getLocalAsRef(0);
     jint index = frame->getLocalAsInt(1);
 
-    auto trace = (vector<Object *> *) _this->extra;
+    auto trace = _this->getInstFieldValue<ArrayObject *>(S(backtrace), S(sig_java_lang_Object));
     assert(trace != nullptr);
-    frame->pushr(trace->at(index));
+    frame->pushr(trace->get<jref>(index));
 }
 
 // native int getStackTraceDepth();
 static void getStackTraceDepth(Frame *frame)
 {
     jref _this = frame->getLocalAsRef(0);
-    auto trace = (vector<Object *> *) _this->extra;
+    auto trace = _this->getInstFieldValue<ArrayObject *>(S(backtrace), S(sig_java_lang_Object));
     assert(trace != nullptr);
-    frame->pushi(trace->size());
+    frame->pushi(trace->len);
 }
 
 void java_lang_Throwable_registerNatives()
@@ -7,6 +7,39 @@
 #include "../../../util/endianness.h"
 #include "../../../rtda/heap/ArrayObject.h"
 #include "../../../rtda/thread/Frame.h"
+#include "../../../heapmgr/gc.h"
+#include "../../../rtda/ma/Class.h"
+
+/*
+ * @o 中偏移为 @offset 的值的地址。
+ * 对象的偏移是实例变量的字节偏移（见 objectFieldOffset），数组的偏移是元素的下标（见 arrayIndexScale）。
+ */
+static void *valueAddress(jref o, jlong offset)
+{
+    if (o->isArray())
+        return ((ArrayObject *) o)->index((jint) offset);
+    assert(0 <= offset && offset < o->clazz->instFieldsSize);
+    return (u1 *) o->data() + offset;
+}
+
+// get*(Object o, long offset)
+template <typename T>
+static T getValue(Frame *frame, bool isVolatile)
+{
+    T *addr = (T *) valueAddress(frame->getLocalAsRef(1), frame->getLocalAsLong(2));
+    if (isVolatile)
+        __sync_synchronize();
+    return *addr;
+}
+
+// put*(Object o, long offset, T x)
+template <typename T>
+static void putValue(Frame *frame, T x, bool isVolatile)
+{
+    *(T *) valueAddress(frame->getLocalAsRef(1), frame->getLocalAsLong(2)) = x;
+    if (isVolatile)
+        __sync_synchronize();
+}
 
 /* todo
 http://www.docjar.com/docs/api/sun/misc/Unsafe.html#park%28boolean,%20long%29
@@ -53,15 +86,9 @@ static void compareAndSwapInt(Frame *frame)
     jint expected = frame->getLocalAsInt(4);
     jint x = frame->getLocalAsInt(5);
 
-    jint old;
-    if (o->isArray()) {
-        old = ((ArrayObject *) o)->get<jint>(offset);
-    } else {
-        assert(0 <= offset && offset < o->clazz->instFieldsCount);
-        old = o->data[offset]; //o->getInstFieldValue<jint>(offset);
-    }
+    auto addr = (jint *) valueAddress(o, offset);
 
-    bool b = __sync_bool_compare_and_swap(&old, expected, x);
+    bool b = __sync_bool_compare_and_swap(addr, expected, x);
     frame->pushi(b ? 1 : 0);
 }
 
@@ -73,18 +100,9 @@ static void compareAndSwapLong(Frame *frame)
     jlong expected = frame->getLocalAsLong(4);
     jlong x = frame->getLocalAsLong(6);
 
-    jlong old;
-    if (o->isArray()) {
-//        old = arrobj_get(jlong, o, offset);
-        ArrayObject *ao = dynamic_cast<ArrayObject *>(o);  // todo
-        old = ao->get<jlong>(offset);//arrobj_get(jint, o, offset);
-    } else {
-//        old = LSLOT(get_instance_field_value_by_id(o, offset));
-        assert(0 <= offset && offset < o->clazz->instFieldsCount);
-        old = *(jlong *)(o->data + offset);//o->getInstFieldValue<jlong>(offset);
-    }
+    auto addr = (jlong *) valueAddress(o, offset);
 
-    bool b = __sync_bool_compare_and_swap(&old, expected, x);
+    bool b = __sync_bool_compare_and_swap(addr, expected, x);
     frame->pushi(b ? 1 : 0);
 }
 
@@ -96,18 +114,37 @@ static void compareAndSwapObject(Frame *frame)
     jref expected = frame->getLocalAsRef(4);
     jref x = frame->getLocalAsRef(5);
 
-    jref old;
+    auto addr = (jref *) valueAddress(o, offset);
+
+    bool b = __sync_bool_compare_and_swap(addr, expected, x);
+    if (b) {
+        pre_write_barrier(expected); // 被覆盖掉的就是 expected
+        write_barrier(o, x);
+    }
+    frame->pushi(b ? 1 : 0);
+}
+
+/*
+ * putObject, putObjectVolatile and putOrderedObject 共用
+ */
+static void putObject0(Frame *frame, bool isVolatile)
+{
+    jref o = frame->getLocalAsRef(1); // first argument
+    jlong offset = frame->getLocalAsLong(2); // long 占两个Slot
+    jref x = frame->getLocalAsRef(4);
+
     if (o->isArray()) {
-        ArrayObject *ao = dynamic_cast<ArrayObject *>(o);  // todo
-        old = ao->get<jref>(offset);
-//        old = arrobj_get(jref, o, offset);
+        ((ArrayObject *) o)->set(offset, x); // set 中有写屏障
     } else {
-        assert(0 <= offset && offset < o->clazz->instFieldsCount);
-        old = *(jref *)(o->data + offset);//o->getInstFieldValue<jref>(offset);
+        auto addr = (jref *) valueAddress(o, offset);
+        pre_write_barrier(*addr);
+        *addr = x;
+        write_barrier(o, x);
     }
 
-    bool b = __sync_bool_compare_and_swap(&old, expected, x);
-    frame->pushi(b ? 1 : 0);
+    if (isVolatile) {
+        __sync_synchronize();
+    }
 }
 
 /*************************************    class    ************************************/
@@ -182,242 +219,217 @@ static void objectFieldOffset(Frame *frame)
 // public native boolean getBoolean(Object o, long offset);
 static void getBoolean(Frame *frame)
 {
-    jvm_abort("getBoolean");
+    frame->pushi(getValue<jbool>(frame, false));
 }
 
 // public native void putBoolean(Object o, long offset, boolean x);
 static void putBoolean(Frame *frame)
 {
-    jvm_abort("putBoolean");
+    putValue<jbool>(frame, (jbool) frame->getLocalAsInt(4), false);
 }
 
 // public native byte getByte(Object o, long offset);
 static void obj_getByte(Frame *frame)
 {
-    jvm_abort("obj_getByte");
+    frame->pushi(getValue<jbyte>(frame, false));
 }
 
 // public native void putByte(Object o, long offset, byte x);
 static void obj_putByte(Frame *frame)
 {
-    jvm_abort("obj_putByte");
+    putValue<jbyte>(frame, (jbyte) frame->getLocalAsInt(4), false);
 }
 
 // public native char getChar(Object o, long offset);
 static void obj_getChar(Frame *frame)
 {
-    jvm_abort("obj_getChar");
+    frame->pushi(getValue<jchar>(frame, false));
 }
 
 // public native void putChar(Object o, long offset, char x);
 static void obj_putChar(Frame *frame)
 {
-    jvm_abort("obj_putChar");
+    putValue<jchar>(frame, (jchar) frame->getLocalAsInt(4), false);
 }
 
 // public native short getShort(Object o, long offset);
 static void obj_getShort(Frame *frame)
 {
-    jvm_abort("obj_getShort");
+    frame->pushi(getValue<jshort>(frame, false));
 }
 
 // public native void putShort(Object o, long offset, short x);
 static void obj_putShort(Frame *frame)
 {
-    jvm_abort("obj_putShort");
+    putValue<jshort>(frame, frame->getLocalAsShort(4), false);
 }
 
 // public native int getInt(Object o, long offset);
 static void obj_getInt(Frame *frame)
 {
-    jvm_abort("obj_getInt");
+    frame->pushi(getValue<jint>(frame, false));
 }
 
 // public native void putInt(Object o, long offset, int x);
 static void obj_putInt(Frame *frame)
 {
-    jvm_abort("obj_putInt");
+    putValue<jint>(frame, frame->getLocalAsInt(4), false);
 }
 
 // public native long getLong(Object o, long offset);
 static void obj_getLong(Frame *frame)
 {
-    jvm_abort("obj_getLong");
+    frame->pushl(getValue<jlong>(frame, false));
 }
 
 // public native void putLong(Object o, long offset, long x);
 static void obj_putLong(Frame *frame)
 {
-    jvm_abort("obj_putLong");
+    putValue<jlong>(frame, frame->getLocalAsLong(4), false);
 }
 
 // public native float getFloat(Object o, long offset);
 static void obj_getFloat(Frame *frame)
 {
-    jvm_abort("obj_getFloat");
+    frame->pushf(getValue<jfloat>(frame, false));
 }
 
 // public native void putFloat(Object o, long offset, float x);
 static void obj_putFloat(Frame *frame)
 {
-    jvm_abort("obj_putFloat");
+    putValue<jfloat>(frame, frame->getLocalAsFloat(4), false);
 }
 
 // public native double getDouble(Object o, long offset);
 static void obj_getDouble(Frame *frame)
 {
-    jvm_abort("obj_getDouble");
+    frame->pushd(getValue<jdouble>(frame, false));
 }
 
 // public native void putDouble(Object o, long offset, double x);
 static void obj_putDouble(Frame *frame)
 {
-    jvm_abort("obj_putDouble");
+    putValue<jdouble>(frame, frame->getLocalAsDouble(4), false);
 }
 
 // public native Object getObject(Object o, long offset);
 static void getObject(Frame *frame)
 {
-    jvm_abort("getObject");
+    frame->pushr(getValue<jref>(frame, false));
 }
 
 // public native void putObject(Object o, long offset, Object x);
 static void putObject(Frame *frame)
 {
-    jvm_abort("putObject");
+    putObject0(frame, false);
 }
 
 // public native boolean getBooleanVolatile(Object o, long offset);
 static void getBooleanVolatile(Frame *frame)
 {
-    jvm_abort("getBooleanVolatile");
+    frame->pushi(getValue<jbool>(frame, true));
 }
 
 // public native byte getByteVolatile(Object o, long offset);
 static void getByteVolatile(Frame *frame)
 {
-    jvm_abort("getByteVolatile");
+    frame->pushi(getValue<jbyte>(frame, true));
 }
 
 // public native char getCharVolatile(Object o, long offset);
 static void getCharVolatile(Frame *frame)
 {
-    jvm_abort("getCharVolatile");
+    frame->pushi(getValue<jchar>(frame, true));
 }
 
 // public native short getShortVolatile(Object o, long offset);
 static void getShortVolatile(Frame *frame)
 {
-    jvm_abort("getShortVolatile");
+    frame->pushi(getValue<jshort>(frame, true));
 }
 
 // public native int getIntVolatile(Object o, long offset);
 static void getIntVolatile(Frame *frame)
 {
-    // todo Volatile
-    jref o = frame->getLocalAsRef(1); // first argument
-    jlong offset = frame->getLocalAsLong(2);
-
-    jint value;
-    if (o->isArray()) {
-        ArrayObject *ao = dynamic_cast<ArrayObject *>(o);  // todo
-        value = ao->get<jint>(offset);
-//        value = arrobj_get(jint, o, offset);  // todo
-    } else {
-        assert(0 <= offset && offset < o->clazz->instFieldsCount);
-        value = o->data[offset];//o->getInstFieldValue<jint>(offset);  // todo
-    }
-    frame->pushi(value);
+    frame->pushi(getValue<jint>(frame, true));
 }
 
 // public native long getLongVolatile(Object o, long offset);
 static void getLongVolatile(Frame *frame)
 {
-    jvm_abort("getLongVolatile");
+    frame->pushl(getValue<jlong>(frame, true));
 }
 
 // public native float getFloatVolatile(Object o, long offset);
 static void getFloatVolatile(Frame *frame)
 {
-    jvm_abort("getFloatVolatile");
+    frame->pushf(getValue<jfloat>(frame, true));
 }
 
 // public native double getDoubleVolatile(Object o, long offset);
 static void getDoubleVolatile(Frame *frame)
 {
-    jvm_abort("getDoubleVolatile");
+    frame->pushd(getValue<jdouble>(frame, true));
 }
 
 // public native void putIntVolatile(Object o, long offset, int x);
 static void putIntVolatile(Frame *frame)
 {
-    jvm_abort("putIntVolatile");
+    putValue<jint>(frame, frame->getLocalAsInt(4), true);
 }
 
 // public native void putBooleanVolatile(Object o, long offset, boolean x);
 static void putBooleanVolatile(Frame *frame)
 {
-    jvm_abort("putBooleanVolatile");
+    putValue<jbool>(frame, (jbool) frame->getLocalAsInt(4), true);
 }
 
 // public native void putByteVolatile(Object o, long offset, byte x);
 static void putByteVolatile(Frame *frame)
 {
-    jvm_abort("putByteVolatile");
+    putValue<jbyte>(frame, (jbyte) frame->getLocalAsInt(4), true);
 }
 
 // public native void putShortVolatile(Object o, long offset, short x);
 static void putShortVolatile(Frame *frame)
 {
-    jvm_abort("putShortVolatile");
+    putValue<jshort>(frame, frame->getLocalAsShort(4), true);
 }
 
 // public native void putCharVolatile(Object o, long offset, char x);
 static void putCharVolatile(Frame *frame)
 {
-    jvm_abort("putCharVolatile");
+    putValue<jchar>(frame, (jchar) frame->getLocalAsInt(4), true);
 }
 
 // public native void putLongVolatile(Object o, long offset, long x);
 static void putLongVolatile(Frame *frame)
 {
-    jvm_abort("putLongVolatile");
+    putValue<jlong>(frame, frame->getLocalAsLong(4), true);
 }
 
 // public native void putFloatVolatile(Object o, long offset, float x);
 static void putFloatVolatile(Frame *frame)
 {
-    jvm_abort("putFloatVolatile");
+    putValue<jfloat>(frame, frame->getLocalAsFloat(4), true);
 }
 
 // public native void putDoubleVolatile(Object o, long offset, double x);
 static void putDoubleVolatile(Frame *frame)
 {
-    jvm_abort("putDoubleVolatile");
+    putValue<jdouble>(frame, frame->getLocalAsDouble(4), true);
 }
 // -------------------------
 // public native Object getObjectVolatile(Object o, long offset);
 static void getObjectVolatile(Frame *frame)
 {
-    // todo Volatile
-    jref o = frame->getLocalAsRef(1); // first argument
-    jlong offset = frame->getLocalAsLong(2);
-
-    jref value;
-    if (o->isArray()) {
-        ArrayObject *ao = dynamic_cast<ArrayObject *>(o);  // todo
-        value = ao->get<jref>(offset);
-    } else {
-        assert(0 <= offset && offset < o->clazz->instFieldsCount);
-        value = *(jref *)(o->data + offset);//o->getInstFieldValue<jref>(offset);  // todo
-    }
-    frame->pushr(value);
+    frame->pushr(getValue<jref>(frame, true));
 }
 
 // public native void putObjectVolatile(Object o, long offset, Object x);
 static void putObjectVolatile(Frame *frame)
 {
-    jvm_abort("putObjectVolatile");
+    putObject0(frame, true);
 }
 
 // public native Object getOrderedObject(Object o, long offset);
@@ -429,7 +441,7 @@ static void getOrderedObject(Frame *frame)
 // public native void putOrderedObject(Object o, long offset, Object x);
 static void putOrderedObject(Frame *frame)
 {
-    jvm_abort("putOrderedObject");
+    putObject0(frame, false);
 }
 
 /** Ordered/Lazy version of {@link #putIntVolatile(Object, long, int)}  */
@@ -480,7 +492,7 @@ static void freeMemory(Frame *frame)
 // public native int addressSize();
 static void addressSize(Frame *frame)
 {
-    frame->pushi(sizeof(jlong)); // todo
+    frame->pushi(sizeof(void *));
 }
 
 // public native void putByte(long address, byte x);
@@ -32,10 +32,7 @@ static slot_t* convert_args(jref this_obj, Method *m, ArrayObject *args)
         auto o = args->get<jref>(i);
 
         if (clsobj->isPrimitive()) {
-            const slot_t *unbox = o->unbox();
-            result[k++] = *unbox;
-            if (strcmp(o->clazz->className, "long") == 0 || strcmp(o->clazz->className, "double") == 0) // category_two
-                result[k++] = *++unbox;
+            k += o->unbox(result + k); // category two 占两个 slot
         } else {
             RSLOT(result + k) = o;
             k++;
@@ -6,6 +6,7 @@
 #include <cassert>
 #include "ArrayObject.h"
 #include "../ma/ArrayClass.h"
+#include "../../heapmgr/TLAB.h"
 
 using namespace std;
 
@@ -15,8 +16,10 @@ ArrayObject *ArrayObject::newInst(ArrayClass *ac, jint arrLen)
     assert(strlen(ac->className) > 1);
     assert(ac->className[0] == '[');
     assert(ac->className[1] != '['); // 只能创建一维数组
-    size_t size = sizeof(ArrayObject) + ac->getEleSize()*arrLen;
-    return new(g_heap_mgr.get(size)) ArrayObject(ac, arrLen);
+    size_t size = ac->instanceSize + ac->eleSize*arrLen;
+    // 基本类型的数组不含引用，大的放在大对象空间中
+    void *p = ac->isPrimitiveArray() ? heap_alloc_no_refs(size) : heap_alloc(size);
+    return new(p) ArrayObject(ac, arrLen);
 }
 
 ArrayObject *ArrayObject::newInst(ArrayClass *ac, size_t arrDim, const size_t *arrLens)
@@ -29,8 +32,8 @@ ArrayObject *ArrayObject::newInst(ArrayClass *ac, size_t arrDim, const size_t *a
         count *= arrLens[i];
     }
 
-    size_t size = sizeof(ArrayObject) + ac->getEleSize()*count;
-    return new(g_heap_mgr.get(size)) ArrayObject(ac, arrDim, arrLens);
+    size_t size = ac->instanceSize + ac->eleSize*count;
+    return new(heap_alloc(size)) ArrayObject(ac, arrDim, arrLens);
 }
 
 void ArrayObject::operator delete(void *rawMemory,std::size_t size) throw()
@@ -44,8 +47,6 @@ ArrayObject::ArrayObject(ArrayClass *arrClass, jint arrLen): Object(arrClass), l
     assert(arrClass->isArray());
     assert(arrLen >= 0); // 长度为0的array是合法的
 
-    eleSize = arrClass->getEleSize();
-    data = (slot_t *) (this + 1); // todo data怎么办,这样不对
     // java 数组创建后要赋默认值，0, 0.0, false,'\0', NULL 之类的
     // heap 申请对象时已经清零了。
 }
@@ -59,9 +60,6 @@ ArrayObject::ArrayObject(ArrayClass *arrClass, size_t arr_dim, const size_t *arr
     assert(arrClass->isArray());
     assert(arr_dim >= 0); // todo 等于0合不合法?
 
-    eleSize = arrClass->getEleSize();
-    data = reinterpret_cast<slot_t *>(this + 1);  // todo data怎么办,这样不对
-
     /*
      * 多维数组是数组的数组
      * 先创建其第一维，第一维的每个元素也是一数组
@@ -96,7 +94,7 @@ void ArrayObject::copy(ArrayObject *dst, jint dst_pos, const ArrayObject *src, j
      * 首先确保src和dst都是数组，然后检查数组类型。
      * 如果两者都是引用数组，则可以拷贝，否则两者必须是相同类型的基本类型数组
      */
-    if (src->eleSize != dst->eleSize) {
+    if (src->clazz->eleSize != dst->clazz->eleSize) {
         // todo error  ArrayStoreException
         printvm("ArrayStoreException\n");
     }
@@ -109,12 +107,18 @@ void ArrayObject::copy(ArrayObject *dst, jint dst_pos, const ArrayObject *src, j
         raiseException(INDEX_OUT_OF_BOUNDS_EXCEPTION);
     }
 
-    memcpy(dst->index(dst_pos), src->index(src_pos), src->eleSize * len);
-}
+    bool refArray = dst->clazz->className[1] == 'L' || dst->clazz->className[1] == '[';
+    if (refArray && g_satb_active) {
+        // 被覆盖掉的元素
+        for (jint i = 0; i < len; i++)
+            pre_write_barrier(dst->get<jref>(dst_pos + i));
+    }
 
-size_t ArrayObject::size() const
-{
-    return sizeof(*this) + eleSize*len;;
+    memcpy(dst->index(dst_pos), src->index(src_pos), src->clazz->eleSize * len);
+
+    // 引用数组，逐个元素检查太慢，直接标记 dst 所在的卡
+    if (refArray && g_heap_mgr.contains(dst))
+        g_card_table.mark(dst);
 }
 
 string ArrayObject::toString() const
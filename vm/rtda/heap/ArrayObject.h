@@ -7,13 +7,17 @@
 
 #include <cstddef>
 #include <string>
+#include <type_traits>
 #include "Object.h"
 #include "../ma/Class.h"
+#include "../../heapmgr/gc.h"
 
-// Object of array
-class ArrayObject: public Object {
-    size_t eleSize; // 表示数组每个元素的大小 todo 这个值在 ArrayClass 中有，保存在这里为了方便
-
+/*
+ * Object of array
+ * 对象头之后是数组的长度，然后是数组元素，元素按 8 字节对齐（long, double）。
+ * 元素的大小保存在数组类中（Class::eleSize）。
+ */
+class alignas(8) ArrayObject: public Object {
     // 创建一维数组
     ArrayObject(ArrayClass *ac, jint arrLen);
 
@@ -36,16 +40,24 @@ public:
         return 0 <= index && index < len;
     }
 
+    void *elements() const { return (void *) (this + 1); }
+
     void *index(jint index0) const
     {
         assert(0 <= index0 && index0 < len);
-        return ((u1 *) (data)) + eleSize*index0;
+        return ((u1 *) elements()) + clazz->eleSize*index0;
     }
 
     template <typename T>
     void set(jint index0, T data)
     {
+        if constexpr (std::is_pointer<T>::value) {
+            pre_write_barrier(*(T *) index(index0));
+        }
         *(T *) index(index0) = data;
+        if constexpr (std::is_pointer<T>::value) {
+            write_barrier(this, data);
+        }
     }
 
     template <typename T>
@@ -55,8 +67,7 @@ public:
     }
 
     static void copy(ArrayObject *dst, jint dst_pos, const ArrayObject *src, jint src_pos, jint len);
-    size_t size() const override;
-    std::string toString() const override;
+    std::string toString() const;
 };
 
 #endif //JVM_ARROBJ_H
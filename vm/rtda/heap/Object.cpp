@@ -4,10 +4,14 @@
 
 #include <sstream>
 #include "../ma/Class.h"
+#include "../ma/ArrayClass.h"
 #include "Object.h"
 #include "../ma/Field.h"
 #include "../../symbol.h"
 #include "StringObject.h"
+#include "ArrayObject.h"
+#include "../../heapmgr/TLAB.h"
+#include "../../heapmgr/gc.h"
 
 using namespace std;
 
@@ -16,8 +20,7 @@ Object *Object::newInst(Class *c)
     if (c == java_lang_String) {
         return StringObject::newInst(""); // todo
     }
-    size_t size = sizeof(Object) + c->instFieldsCount * sizeof(slot_t);
-    return new(g_heap_mgr.get(size)) Object(c);
+    return new(heap_alloc(c->instanceSize)) Object(c);
 }
 
 void Object::operator delete(void *rawMemory,std::size_t size) throw()
@@ -28,7 +31,20 @@ void Object::operator delete(void *rawMemory,std::size_t size) throw()
 Object *Object::clone() const
 {
     size_t s = size();
-    return (Object *) memcpy(g_heap_mgr.get(s), this, s);
+    bool noRefs = clazz->isArray() && ((ArrayClass *) clazz)->isPrimitiveArray();
+    auto o = (Object *) memcpy(noRefs ? heap_alloc_no_refs(s) : heap_alloc(s), this, s);
+    o->markWord = 0; // 新对象有自己的 identity hash
+    if (clazz == java_lang_String)
+        StringObject::clearCache(o);
+    // 大对象直接在老年代中分配，拷贝过来的引用可能指向新生代
+    if (g_heap_mgr.contains(o))
+        g_card_table.mark(o);
+    return o;
+}
+
+void *Object::fieldAddress(const Field *f) const
+{
+    return (u1 *) data() + f->offset;
 }
 
 void Object::setFieldValue(Field *f, slot_t v)
@@ -37,10 +53,11 @@ void Object::setFieldValue(Field *f, slot_t v)
     assert(!f->isStatic());
 
     if (!f->categoryTwo) {
-        data[f->id] = v;
+        setFieldValue(f, &v);
     } else { // categoryTwo
-        data[f->id] = 0; // 高字节清零
-        data[f->id + 1] = v; // 低字节存值
+        slot_t value[2];
+        LSLOT(value) = (jlong) v;
+        setFieldValue(f, value);
     }
 }
 
@@ -48,9 +65,69 @@ void Object::setFieldValue(Field *f, const slot_t *value)
 {
     assert(f != nullptr && !f->isStatic() && value != nullptr);
 
-    data[f->id] = value[0];
-    if (f->categoryTwo) {
-        data[f->id + 1] = value[1];
+    void *p = fieldAddress(f);
+    switch (f->descriptor[0]) {
+        case 'Z':
+        case 'B':
+            *(jbyte *) p = (jbyte) ISLOT(value);
+            break;
+        case 'C':
+            *(jchar *) p = (jchar) ISLOT(value);
+            break;
+        case 'S':
+            *(jshort *) p = (jshort) ISLOT(value);
+            break;
+        case 'I':
+            *(jint *) p = ISLOT(value);
+            break;
+        case 'F':
+            *(jfloat *) p = FSLOT(value);
+            break;
+        case 'J':
+            *(jlong *) p = LSLOT(value);
+            break;
+        case 'D':
+            *(jdouble *) p = DSLOT(value);
+            break;
+        default: // reference
+            pre_write_barrier(*(jref *) p);
+            *(jref *) p = RSLOT(value);
+            write_barrier(this, RSLOT(value));
+            break;
+    }
+}
+
+int Object::getFieldValue(const Field *f, slot_t *value) const
+{
+    assert(f != nullptr && !f->isStatic() && value != nullptr);
+
+    const void *p = fieldAddress(f);
+    switch (f->descriptor[0]) {
+        case 'Z':
+        case 'B':
+            ISLOT(value) = *(const jbyte *) p;
+            return 1;
+        case 'C':
+            ISLOT(value) = *(const jchar *) p;
+            return 1;
+        case 'S':
+            ISLOT(value) = *(const jshort *) p;
+            return 1;
+        case 'I':
+            ISLOT(value) = *(const jint *) p;
+            return 1;
+        case 'F':
+            FSLOT(value) = *(const jfloat *) p;
+            return 1;
+        case 'J':
+            LSLOT(value) = *(const jlong *) p;
+            return 2;
+        case 'D':
+            DSLOT(value) = *(const jdouble *) p;
+            return 2;
+        default: // reference
+            RSLOT(value) = *(const jref *) p;
+            return 1;
     }
 }
 
@@ -66,7 +143,7 @@ void Object::setFieldValue(const char *name, const char *descriptor, const slot_
     setFieldValue(clazz->lookupInstField(name, descriptor), value);
 }
 
-const slot_t *Object::getInstFieldValue0(const char *name, const char *descriptor) const
+const void *Object::getInstFieldValue0(const char *name, const char *descriptor) const
 {
     assert(name != nullptr && descriptor != nullptr);
 
@@ -75,7 +152,27 @@ const slot_t *Object::getInstFieldValue0(const char *name, const char *descripto
         jvm_abort("error, %s, %s\n", name, descriptor); // todo
     }
 
-    return data + f->id;
+    return fieldAddress(f);
+}
+
+jint Object::identityHashCode()
+{
+    uintptr_t mark = __atomic_load_n(&markWord, __ATOMIC_RELAXED);
+    if ((mark >> HASH_SHIFT) == 0) {
+        // 对象在计算之前不会被移动（调用者的栈中有它的引用，新生代中它所在的块、老年代中它自己会被钉住），
+        // 多个线程同时计算的结果相同。之后 hash 随对象一起移动
+        uintptr_t h = ((uintptr_t) this / HEAP_ALIGN) & (((uintptr_t) 1 << HASH_BITS) - 1);
+        if (h == 0)
+            h = 1;
+        // mark word 的其他位可能同时被修改
+        while (!__atomic_compare_exchange_n(&markWord, &mark, mark | (h << HASH_SHIFT),
+                                            true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            if ((mark >> HASH_SHIFT) != 0)
+                break;
+        }
+        mark = __atomic_load_n(&markWord, __ATOMIC_RELAXED);
+    }
+    return (jint) (mark >> HASH_SHIFT);
 }
 
 bool Object::isInstanceOf(const Class *c) const
@@ -85,7 +182,7 @@ bool Object::isInstanceOf(const Class *c) const
     return clazz->isSubclassOf(c);
 }
 
-const slot_t *Object::unbox() const
+int Object::unbox(slot_t *value) const
 {
     if (clazz->isPrimitive()) {
         // value 的描述符就是基本类型的类名。比如，private final boolean value;
@@ -93,7 +190,7 @@ const slot_t *Object::unbox() const
         if (f == nullptr) {
             jvm_abort("error, %s, %s\n", S(value), clazz->className); // todo
         }
-        return data + f->id;
+        return getFieldValue(f, value);
 //        return getInstFieldValue(S(value), clazz->class_name);
     }
     // todo error!!!!!!!!
@@ -102,7 +199,16 @@ const slot_t *Object::unbox() const
 
 size_t Object::size() const
 {
-    return sizeof(*this) + clazz->instFieldsCount * sizeof(slot_t);
+    size_t s = clazz->instanceSize;
+    if (clazz->eleSize != 0)
+        s += clazz->eleSize * ((const ArrayObject *) this)->len;
+    return s;
+}
+
+void Object::destroy()
+{
+    if (clazz == java_lang_String)
+        ((StringObject *) this)->~StringObject();
 }
 
 bool Object::isArray() const
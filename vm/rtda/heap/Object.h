@@ -11,52 +11,62 @@
 class Class;
 class Field;
 
+/*
+ * 对象头只有两个字：mark word 和类指针（数组对象之后还有数组的长度，见 ArrayObject），
+ * 实例变量紧跟在对象头之后（data()）。
+ * 对象没有虚函数表，对象的大小由类决定（size），GC 回收对象时按类释放其在堆外持有的资源（destroy）。
+ *
+ * mark word 的布局（从低位到高位）：
+ *   lock:2     锁状态，还没有使用
+ *   forwarded:1  minor GC 已经把对象拷贝走了，清除低 3 位后就是新地址（对象按 HEAP_ALIGN 对齐）
+ *   gc:5       保留给 GC
+ *   hash       identity hash，32 位平台上只有 24 位
+ */
 class Object {
 protected:
     Object() { }
 
-    explicit Object(Class *c): clazz(c)
-    {
-        data = reinterpret_cast<slot_t *>(this + 1);
-    }
+    explicit Object(Class *c): clazz(c) { }
 
 public:
-    // 保存所有实例变量的值
-    // 包括此Object中定义的和继承来的。
-    // 特殊的，对于数组对象，保存数组的值
-    slot_t *data;
-    Class *clazz;
+    uintptr_t markWord = 0;
+    Class *clazz = nullptr;
+
+    static const uintptr_t LOCK_MASK = 0x3;
+    static const uintptr_t FORWARDED = 0x4;
+    static const int HASH_SHIFT = 8;
+    static const int HASH_BITS = sizeof(uintptr_t) * 8 - HASH_SHIFT < 31 ? sizeof(uintptr_t) * 8 - HASH_SHIFT : 31;
+
+    // 保存所有实例变量的值，包括此Object中定义的和继承来的。
+    slot_t *data() const { return (slot_t *) (this + 1); }
 
     static Object *newInst(Class *c);
     static void operator delete(void *rawMemory, std::size_t size) throw();
 
-    virtual size_t size() const;
+    // GC 回收对象时调用，释放对象在堆外持有的资源，比如 StringObject 缓存的 utf8 字符串
+    void destroy();
+
+    // 按类计算，见 Class::instanceSize
+    size_t size() const;
 
     bool isArray() const;
     Object *clone() const;
 
-    void setFieldValue(Field *f, slot_t v); // only for category one field
+    // 实例变量在对象中的地址，按 Field::width() 读写
+    void *fieldAddress(const Field *f) const;
+
+    /*
+     * 按照操作数栈中的格式读写实例变量的值：byte, boolean, char, short 在栈中扩展为 int，
+     * long 和 double 占两个 slot. 返回值的 slot 数。
+     */
+    int getFieldValue(const Field *f, slot_t *value) const;
+    void setFieldValue(Field *f, slot_t v); // category two 的 field 把 @v 作为 jlong
     void setFieldValue(Field *f, const slot_t *value);
     void setFieldValue(const char *name, const char *descriptor, slot_t v); // only for category one field
     void setFieldValue(const char *name, const char *descriptor, const slot_t *value);
 
-    // @id: id of the field
-//    template <typename T>
-//    T getInstFieldValue(int id) const
-//    {
-//        assert(0 <= id && id < clazz->instFieldsCount);
-//        return * (T *) (data + id);
-//    }
-//
-//    template <typename T>
-//    T getInstFieldValue(Field *f) const
-//    {
-//        assert(f != nullptr);
-//        return getInstFieldValue<T>(f->id);
-//    }
-
 private:
-    const slot_t *getInstFieldValue0(const char *name, const char *descriptor) const;
+    const void *getInstFieldValue0(const char *name, const char *descriptor) const;
 public:
     template <typename T>
     T getInstFieldValue(const char *name, const char *descriptor) const
@@ -67,12 +77,16 @@ public:
 
     bool isInstanceOf(const Class *c) const;
 
-    // 只适用于 primitive object
-    const slot_t *unbox() const;
+    // 只适用于 primitive object，把值按照操作数栈中的格式写入 @value，返回值的 slot 数
+    int unbox(slot_t *value) const;
 
-    virtual std::string toString() const;
+    /*
+     * Object.hashCode() 和 System.identityHashCode() 的值。
+     * 新生代的对象在 GC 时会移动，所以不能直接用地址，第一次调用时计算，之后保存在 mark word 中。
+     */
+    jint identityHashCode();
 
-    void *extra;
+    std::string toString() const;
 };
 
 #endif //JVM_JOBJECT_H
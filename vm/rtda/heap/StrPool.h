@@ -6,6 +6,7 @@
 #define JVM_STRPOOL_H
 
 #include <unordered_set>
+#include <vector>
 #include "Object.h"
 #include "StringObject.h"
 
@@ -42,6 +43,29 @@ public:
         assert(str != nullptr);
         return put(StringObject::newInst(str));
     }
+
+    /*
+     * 池中的字符串都是 GC Roots.
+     * @visit 的参数为 jref *，GC 可以通过它更新被移动了的字符串的地址，
+     * 有字符串被移动时重建整个池（字符串的内容没有变，hash 值也不变）。
+     */
+    template <typename Visitor>
+    void visitRefs(Visitor visit)
+    {
+        std::vector<StringObject *> all;
+        bool moved = false;
+        for (StringObject *so : pool) {
+            jref ref = so;
+            visit(&ref);
+            moved = moved || ref != so;
+            all.push_back((StringObject *) ref);
+        }
+
+        if (moved) {
+            pool.clear();
+            pool.insert(all.begin(), all.end());
+        }
+    }
 };
 
 #endif //JVM_STRPOOL_H
@@ -10,6 +10,7 @@
 #include "ArrayObject.h"
 #include "Object.h"
 #include "../../symbol.h"
+#include "../../heapmgr/TLAB.h"
 
 /*
  * jdk8下的一些测试：
@@ -38,8 +39,7 @@ using namespace std;
 
 StringObject *StringObject::newInst(const char *str)
 {
-    size_t size = sizeof(StringObject) + java_lang_String->instFieldsCount*sizeof(slot_t);
-    return new(g_heap_mgr.get(size)) StringObject(str);
+    return new(heap_alloc(java_lang_String->instanceSize)) StringObject(str);
 }
 
 void StringObject::operator delete(void *rawMemory, size_t size) throw()
@@ -51,17 +51,13 @@ StringObject::StringObject(const char *str): Object(java_lang_String)
 {
     assert(str != nullptr);
 
-    data = (slot_t *) (this + 1); // todo data怎么办,这样不对
-
     jchar *wstr = utf8_to_unicode(str);
-    len = wcslen(reinterpret_cast<const wchar_t *>(wstr)); // todo
+    jint len = wcslen(reinterpret_cast<const wchar_t *>(wstr)); // todo
     ArrayObject *jchars = ArrayObject::newInst(char_array_class, len);
     // 不要使用 wcscpy 直接字符串拷贝，
     // 因为 wcscpy 函数会自动添加字符串结尾 L'\0'，
     // 但 jchars 没有空间容纳字符串结尾符，因为 jchar 是字符数组，不是字符串
-    memcpy(jchars->data, wstr, sizeof(jchar) * len);
-
-    raw = reinterpret_cast<const jchar *>(jchars->data);
+    memcpy(jchars->elements(), wstr, sizeof(jchar) * len);
 
     clazz->clinit(); // todo
 
@@ -72,13 +68,19 @@ StringObject::StringObject(const char *str): Object(java_lang_String)
 
 const char *StringObject::getUtf8Value()
 {
+    const char *&utf8Value = utf8Cache();
     if (utf8Value == nullptr) {
         auto char_arr = getInstFieldValue<ArrayObject *>(S(value), S(array_C));
-        utf8Value = unicode_to_utf8(reinterpret_cast<const jchar *>(char_arr->data), char_arr->len);
+        utf8Value = unicode_to_utf8(reinterpret_cast<const jchar *>(char_arr->elements()), char_arr->len);
     }
     return utf8Value;
 }
 
+StringObject::~StringObject()
+{
+    delete[] utf8Cache();
+}
+
 string StringObject::toString() const
 {
     // todo
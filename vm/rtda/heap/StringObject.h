@@ -6,15 +6,23 @@
 #define JVM_STROBJ_H
 
 #include "Object.h"
+#include "../ma/Class.h"
 #include "../../utf8.h"
 
-// Object of java/lang/String
+/*
+ * Object of java/lang/String
+ * 缓存的 utf8 字符串保存在实例变量之后的一个隐藏的 slot 中（见 Class::instanceSize），对象头和普通对象一样。
+ */
 class StringObject: public Object {
-    const jchar *raw; // 保存字符串的值。
-    const char *utf8Value = nullptr; // cached utf8 value
-    jint len;
     explicit StringObject(const char *str);
 
+    const char *&utf8Cache() const
+    {
+        // 对齐后放在所有实例变量之后，见 Class::layoutFields
+        size_t off = (java_lang_String->instFieldsSize + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+        return *(const char **) ((u1 *) data() + off);
+    }
+
 public:
     const char *getUtf8Value();
 
@@ -22,9 +30,14 @@ public:
     static StringObject *newInst(const char *str);
     static void operator delete(void *rawMemory, std::size_t size) throw();
 
+    // 由 Object::destroy 调用
+    ~StringObject();
+
+    // clone 出来的字符串不能和原字符串共用缓存
+    static void clearCache(Object *o) { ((StringObject *) o)->utf8Cache() = nullptr; }
+
 //    bool operator<(const StringObject &right) const;
-//    virtual size_t size() const;
-    std::string toString() const override;
+    std::string toString() const;
 };
 
 #endif //JVM_STROBJ_H
@@ -4,6 +4,7 @@
 
 #include "ArrayClass.h"
 #include "PrimitiveClass.h"
+#include "../heap/ArrayObject.h"
 
 ArrayClass::ArrayClass(const char *className): Class(bootClassLoader, strdup(className))
 {
@@ -17,29 +18,29 @@ ArrayClass::ArrayClass(const char *className): Class(bootClassLoader, strdup(cla
     interfaces.push_back(java_lang_Cloneable);
     interfaces.push_back(java_io_Serializable);
 
+    // 判断数组单个元素的大小
+    // 除了基本类型的数组外，其他都是引用类型的数组
+    // 多维数组是数组的数组，也是引用类型的数组
+    eleSize = sizeof(jref);
+    char t = className[1]; // jump '['
+    if (t == 'Z') { eleSize = sizeof(jbool); }
+    else if (t == 'B') { eleSize = sizeof(jbyte); }
+    else if (t == 'C') { eleSize = sizeof(jchar); }
+    else if (t == 'S') { eleSize = sizeof(jshort); }
+    else if (t == 'I') { eleSize = sizeof(jint); }
+    else if (t == 'F') { eleSize = sizeof(jfloat); }
+    else if (t == 'J') { eleSize = sizeof(jlong); }
+    else if (t == 'D') { eleSize = sizeof(jdouble); }
+    instanceSize = sizeof(ArrayObject);
+
     createVtable();
+    createSuperTables();
 
     postInit();
 }
 
 size_t ArrayClass::getEleSize()
 {
-    if (eleSize == 0) {
-        // 判断数组单个元素的大小
-        // 除了基本类型的数组外，其他都是引用类型的数组
-        // 多维数组是数组的数组，也是引用类型的数组
-        eleSize = sizeof(jref);
-        char t = className[1]; // jump '['
-        if (t == 'Z') { eleSize = sizeof(jbool); }
-        else if (t == 'B') { eleSize = sizeof(jbyte); }
-        else if (t == 'C') { eleSize = sizeof(jchar); }
-        else if (t == 'S') { eleSize = sizeof(jshort); }
-        else if (t == 'I') { eleSize = sizeof(jint); }
-        else if (t == 'F') { eleSize = sizeof(jfloat); }
-        else if (t == 'J') { eleSize = sizeof(jlong); }
-        else if (t == 'D') { eleSize = sizeof(jdouble); }
-    }
-
     return eleSize;
 }
 
@@ -69,4 +70,29 @@ Class *ArrayClass::componentClass()
         compClass = loader->loadClass(buf);
         return compClass;
     }
-}
\ No newline at end of file
+}
+Class *ArrayClass::componentType()
+{
+    if (compType != nullptr)
+        return compType;
+
+    const char *compName = className + 1; // jump one '['
+    if (*compName == '[') { // 多维数组，元素是数组
+        compType = loader->loadClass(compName);
+    } else if (*compName != 'L') { // primitive type
+        compType = getPrimitiveClass(*compName);
+        assert(compType != nullptr);
+    } else {
+        compName++;
+        int last = strlen(compName) - 1;
+        assert(last > 0);
+        if (compName[last] != ';') {
+            raiseException(UNKNOWN_ERROR, className); // todo
+        }
+        char buf[last + 1];
+        strncpy(buf, compName, (size_t) last);
+        buf[last] = 0;
+        compType = loader->loadClass(buf);
+    }
+    return compType;
+}
@@ -11,8 +11,8 @@
  * Array Class 由vm生成。
  */
 class ArrayClass: public Class {
-    size_t eleSize = 0;
     Class *compClass = nullptr; // component class
+    Class *compType = nullptr;  // 去掉一层 '[' 的类型，见 componentType
 public:
     explicit ArrayClass(const char *className);
 
@@ -29,6 +29,13 @@ public:
      */
     Class *componentClass();
 
+    /*
+     * 数组元素的类型，只去掉一层 '['，
+     * 比如 [[I 的是 [I，[Ljava/lang/String; 的是 java/lang/String，[I 的是 int.
+     * （componentClass 去掉所有的 '['，[[I 的是 int）
+     */
+    Class *componentType();
+
     /*
       * 是否是基本类型的数组（当然是一维的）。
       * 基本类型
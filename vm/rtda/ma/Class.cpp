@@ -4,9 +4,12 @@
 
 #include <vector>
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 #include <sstream>
 #include "Class.h"
 #include "Field.h"
+#include "ArrayClass.h"
 #include "resolve.h"
 #include "../../interpreter/interpreter.h"
 #include "../../classfile/constant.h"
@@ -14,22 +17,66 @@
 
 using namespace std;
 
-void Class::calcFieldsId()
+/*
+ * 按宽度（8/4/2/1 字节）布局实例变量，计算它们相对于 Object::data() 的字节偏移。
+ * 父类的实例变量保持原来的位置；本类的实例变量从宽到窄依次放置，
+ * 每个变量先尝试填入父类留下的对齐空隙，放不下时对齐到其宽度后追加在末尾。
+ * 从宽到窄放置，所以本类内部只会在开头（对齐父类的末尾时）留下空隙。
+ */
+void Class::layoutFields()
 {
-    int insId = 0;
+    int end = 0;
     if (superClass != nullptr) {
-        insId = superClass->instFieldsCount; // todo 父类的私有变量是不是也算在了里面，不过问题不大，浪费点空间吧了
+        end = superClass->instFieldsSize;
+        fieldGaps = superClass->fieldGaps;
+        refFieldOffsets = superClass->refFieldOffsets;
     }
 
-    for(auto f : fields) {
-        if (!f->isStatic()) {
-            f->id = insId++;
-            if (f->categoryTwo)
-                insId++;
+    vector<Field *> instFields;
+    for (auto f : fields) {
+        if (!f->isStatic())
+            instFields.push_back(f);
+    }
+    // 同宽的变量保持声明的顺序
+    stable_sort(instFields.begin(), instFields.end(), [](Field *a, Field *b) { return a->width() > b->width(); });
+
+    for (auto f : instFields) {
+        int w = (int) f->width();
+        f->offset = -1;
+
+        for (auto it = fieldGaps.begin(); it != fieldGaps.end(); ++it) {
+            int gapBegin = it->first;
+            int gapEnd = it->first + it->second;
+            int off = (gapBegin + w - 1) / w * w;
+            if (off + w <= gapEnd) {
+                f->offset = off;
+                fieldGaps.erase(it);
+                if (off > gapBegin)
+                    fieldGaps.emplace_back(gapBegin, off - gapBegin);
+                if (off + w < gapEnd)
+                    fieldGaps.emplace_back(off + w, gapEnd - (off + w));
+                break;
+            }
         }
+
+        if (f->offset < 0) {
+            int off = (end + w - 1) / w * w;
+            if (off > end)
+                fieldGaps.emplace_back(end, off - end);
+            f->offset = off;
+            end = off + w;
+        }
+
+        if (f->descriptor[0] == 'L' || f->descriptor[0] == '[')
+            refFieldOffsets.push_back(f->offset);
     }
 
-    instFieldsCount = insId;
+    instFieldsSize = end;
+    instanceSize = sizeof(Object) + instFieldsSize;
+    // StringObject 缓存的 utf8 字符串，对齐后放在所有实例变量之后，见 StringObject::utf8Cache
+    if (utf8_equals(className, S(java_lang_String)))
+        instanceSize = sizeof(Object) + (instFieldsSize + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *)
+                       + sizeof(void *);
 }
 
 void Class::parseAttribute(BytecodeReader &r)
@@ -109,6 +156,33 @@ void Class::parseAttribute(BytecodeReader &r)
     }
 }
 
+/*
+ * 按名称和描述符匹配方法，代替两重循环中逐个 utf8_equals 的比较。
+ * 常量池中的 utf8 字符串大多已经驻留（save_utf8），utf8_equals 通常只需比较指针。
+ */
+struct MethodSignature {
+    const char *name;
+    const char *descriptor;
+
+    explicit MethodSignature(const Method *m): name(m->name), descriptor(m->descriptor) { }
+
+    bool operator==(const MethodSignature &other) const
+    {
+        return utf8_equals(name, other.name) && utf8_equals(descriptor, other.descriptor);
+    }
+};
+
+struct MethodSignatureHash {
+    size_t operator()(const MethodSignature &s) const
+    {
+        Utf8Hash hash;
+        return hash(s.name) * 31 + hash(s.descriptor);
+    }
+};
+
+template <typename T>
+using SignatureMap = unordered_map<MethodSignature, T, MethodSignatureHash>;
+
 void Class::createVtable()
 {
     assert(vtable.empty());
@@ -128,14 +202,17 @@ void Class::createVtable()
     // 将父类的vtable复制过来
     vtable.assign(superClass->vtable.begin(), superClass->vtable.end());
 
+    SignatureMap<int> slots(vtable.size() * 2);
+    for (size_t i = 0; i < vtable.size(); i++)
+        slots.emplace(MethodSignature(vtable[i]), (int) i);
+
     for (auto m : methods) {
         if (m->isVirtual()) {
-            auto iter = find_if(vtable.begin(), vtable.end(), [=](Method *m0){
-                return utf8_equals(m->name, m0->name) && utf8_equals(m->descriptor, m0->descriptor); });
-            if (iter != vtable.end()) {
+            auto iter = slots.find(MethodSignature(m));
+            if (iter != slots.end()) {
                 // 重写了父类的方法，更新
-                m->vtableIndex = (*iter)->vtableIndex;
-                *iter = m;
+                m->vtableIndex = iter->second;
+                vtable[iter->second] = m;
             } else {
                 // 子类定义了要给新方法，加到 vtable 后面
                 vtable.push_back(m);
@@ -145,17 +222,43 @@ void Class::createVtable()
     }
 }
 
-Class::ITable::ITable(const Class::ITable &itable)
-{
-    interfaces.assign(itable.interfaces.begin(), itable.interfaces.end());
-    methods.assign(itable.methods.begin(), itable.methods.end());
-}
-
-Class::ITable& Class::ITable::operator=(const Class::ITable &itable)
+/*
+ * 为接口方法 @m 选择实现（JVMS 5.4.6）：
+ * 1. 本类或父类中声明的同名同描述符的实例方法（@impls，即 vtable 中的方法）；
+ * 2. 否则在所有接口中同名同描述符的方法（@declared）里取最具体（maximally-specific）的那些，
+ *    如果其中恰好有一个 default 方法，就选择它，有多个时返回 ITable::CONFLICT；
+ * 3. 否则没有实现，返回 @m 本身（抽象方法），调用时抛出 AbstractMethodError.
+ */
+static Method *select_interface_method(Method *m,
+                                       const SignatureMap<Method *> &impls,
+                                       const SignatureMap<vector<Method *>> &declared)
 {
-    interfaces.assign(itable.interfaces.begin(), itable.interfaces.end());
-    methods.assign(itable.methods.begin(), itable.methods.end());
-    return *this;
+    MethodSignature sig(m);
+    auto impl = impls.find(sig);
+    if (impl != impls.end())
+        return impl->second;
+
+    auto iter = declared.find(sig);
+    if (iter == declared.end())
+        return m;
+
+    Method *selected = nullptr;
+    auto &candidates = iter->second;
+    for (Method *c : candidates) {
+        if (c->isAbstract())
+            continue;
+        // 被更具体的接口中的方法（包括重新声明的抽象方法）覆盖了
+        bool overridden = any_of(candidates.begin(), candidates.end(), [=](Method *c0) {
+            return c0->clazz != c->clazz && c0->clazz->isSubclassOf(c->clazz);
+        });
+        if (overridden)
+            continue;
+        if (selected != nullptr)
+            return Class::ITable::CONFLICT; // 有多个最具体的 default 方法
+        selected = c;
+    }
+
+    return selected != nullptr ? selected : m;
 }
 
 /*
@@ -164,62 +267,177 @@ Class::ITable& Class::ITable::operator=(const Class::ITable &itable)
  * vtable 无法解决多个对应接口的函数编号问题。
  * 而对继承一个类只能继承一个父亲，子类只要包含父类vtable，
  * 并且和父类的函数包含部分编号是一致的，就可以直接使用父类的函数编号找到对应的子类实现函数。
+ *
+ * 接口方法在接口内编号（Method::itableIndex），调用接口方法时先找到接口在 itable 中的位置，
+ * 再加上编号就是实现的位置，见 ITable::lookup.
  */
 void Class::createItable()
 {
     if (isInterface()) {
+        // 接口的实例方法（抽象方法和 default 方法）按声明的顺序编号
         int index = 0;
-        if (superClass != nullptr) {
-            itable = superClass->itable;
-            index = itable.methods.size();
-        }
         for (Method *m : methods) {
-            // todo default 方法怎么处理？进不进 itable？
-            // todo 调用 default 方法 生成什么调用指令？
-            m->itableIndex = index++;
-            itable.methods.push_back(m);
+            if (m->isVirtual()) {
+                m->itableIndex = index++;
+                itable.methods.push_back(m);
+            }
         }
         return;
     }
 
     /* parse non interface class */
 
+    // 实现的所有接口：父类实现的，本类直接实现的，以及它们的父接口
+    vector<Class *> all;
+    unordered_set<Class *> seen;
     if (superClass != nullptr) {
-        itable  = superClass->itable;
+        for (auto &p : superClass->itable.interfaces) {
+            all.push_back(p.first);
+            seen.insert(p.first);
+        }
+    }
+    vector<Class *> pending(interfaces.rbegin(), interfaces.rend());
+    while (!pending.empty()) {
+        Class *interface = pending.back();
+        pending.pop_back();
+        if (!seen.insert(interface).second)
+            continue; // 此接口已经在 itable.interfaces 中了
+        all.push_back(interface);
+        pending.insert(pending.end(), interface->interfaces.rbegin(), interface->interfaces.rend());
     }
 
-    // 遍历 itable.methods，检查有没有接口函数在本类中被重写了。
-    for (auto m : itable.methods) {
-        for (auto m0 : methods) {
-            if (utf8_equals(m->name, m0->name) && utf8_equals(m->descriptor, m0->descriptor)) {
-                m = m0; // 重写了接口方法，更新
-                break;
-            }
-        }
+    if (all.empty())
+        return;
+
+    SignatureMap<Method *> impls(vtable.size() * 2);
+    for (Method *m : vtable)
+        impls.emplace(MethodSignature(m), m);
+
+    SignatureMap<vector<Method *>> declared;
+    for (Class *interface : all) {
+        for (Method *m : interface->itable.methods)
+            declared[MethodSignature(m)].push_back(m);
     }
 
-    for (auto interface : interfaces) {
-        for (auto tmp : itable.interfaces) {
-            if (utf8_equals(tmp.first->className, interface->className)) {
-                // 此接口已经在 itable.interfaces 中了
-                goto next;
-            }
+    itable.interfaces.reserve(all.size());
+    for (Class *interface : all) {
+        itable.interfaces.emplace_back(interface, itable.methods.size());
+        for (Method *m : interface->itable.methods)
+            itable.methods.push_back(select_interface_method(m, impls, declared));
+    }
+
+    if (itable.interfaces.size() > VM_ITABLE_HASH_THRESHOLD)
+        itable.buildHash();
+}
+
+static u1 itable_conflict_marker;
+Method *const Class::ITable::CONFLICT = (Method *) &itable_conflict_marker;
+
+static inline size_t selector_hash(const Method *selector)
+{
+    return ((uintptr_t) selector >> 3) * 2654435761u;
+}
+
+Method *Class::ITable::lookup(const Method *selector) const
+{
+    assert(selector->clazz->isInterface() && selector->itableIndex >= 0);
+
+    if (!hashed.empty()) {
+        size_t mask = hashed.size() - 1;
+        for (size_t i = selector_hash(selector) & mask; hashed[i].first != nullptr; i = (i + 1) & mask) {
+            if (hashed[i].first == selector)
+                return hashed[i].second;
         }
+        return nullptr;
+    }
 
-        itable.interfaces.emplace_back(interface, itable.methods.size());
-        for (auto m : interface->methods) {
-            for (auto m0 : methods) {
-                if (utf8_equals(m->name, m0->name) && utf8_equals(m->descriptor, m0->descriptor)) {
-                    m = m0; // 重写了接口方法，更新
-                    break;
-                }
-            }
-            itable.methods.push_back(m);
+    for (auto &p : interfaces) {
+        if (p.first == selector->clazz)
+            return methods[p.second + selector->itableIndex];
+    }
+    return nullptr;
+}
+
+void Class::ITable::buildHash()
+{
+    // 装载因子不超过 1/2，总有空位，查找一定会结束
+    size_t capacity = 1;
+    while (capacity < methods.size() * 2)
+        capacity <<= 1;
+    hashed.assign(capacity, pair<const Method *, Method *>(nullptr, nullptr));
+
+    size_t mask = capacity - 1;
+    for (auto &p : interfaces) {
+        auto &selectors = p.first->itable.methods;
+        for (size_t k = 0; k < selectors.size(); k++) {
+            size_t i = selector_hash(selectors[k]) & mask;
+            while (hashed[i].first != nullptr)
+                i = (i + 1) & mask;
+            hashed[i] = { selectors[k], methods[p.second + k] };
         }
-next:;
     }
 }
 
+static inline size_t member_hash(const char *name, const char *descriptor)
+{
+    return (((uintptr_t) name >> 3) * 31 + ((uintptr_t) descriptor >> 3)) * 2654435761u;
+}
+
+template <typename T>
+void Class::MemberTable::build(const vector<T *> &members)
+{
+    if (members.empty())
+        return;
+
+    size_t capacity = 1;
+    while (capacity < members.size() * 2)
+        capacity <<= 1;
+    slots.assign(capacity, nullptr);
+
+    size_t mask = capacity - 1;
+    for (T *m : members) {
+        size_t i = member_hash(m->name, m->descriptor) & mask;
+        while (slots[i] != nullptr)
+            i = (i + 1) & mask;
+        slots[i] = m;
+    }
+}
+
+Member *Class::MemberTable::find(const char *name, const char *descriptor) const
+{
+    if (slots.empty())
+        return nullptr;
+
+    size_t mask = slots.size() - 1;
+    for (size_t i = member_hash(name, descriptor) & mask; slots[i] != nullptr; i = (i + 1) & mask) {
+        if (slots[i]->name == name && slots[i]->descriptor == descriptor)
+            return slots[i];
+    }
+    return nullptr;
+}
+
+size_t Class::MemberKeyHash::operator()(const pair<const char *, const char *> &key) const
+{
+    return member_hash(key.first, key.second);
+}
+
+void Class::createMemberTables()
+{
+    methodTable.build(methods);
+    fieldTable.build(fields);
+}
+
+/*
+ * 把 @name 和 @descriptor 换成驻留的字符串。
+ * 成员的名称和描述符都是驻留的，所以没有驻留的字符串不可能匹配任何成员，这时返回 false.
+ */
+static inline bool intern_member_key(const char *&name, const char *&descriptor)
+{
+    name = find_saved_utf8(name);
+    descriptor = find_saved_utf8(descriptor);
+    return name != nullptr && descriptor != nullptr;
+}
+
 const void Class::genPkgName()
 {
     char *tmp = strdup(className);
@@ -248,6 +466,9 @@ Class::Class(ClassLoader *loader, u1 *bytecode, size_t len)
     BytecodeReader r(bytecode, len);
 
     this->loader = loader;
+    pthread_mutex_lock(&g_all_classes_mutex);
+    g_all_classes.push_back(this);
+    pthread_mutex_unlock(&g_all_classes_mutex);
 
     auto magic = r.readu4();
     if (magic != 0xcafebabe) {
@@ -273,8 +494,9 @@ Class::Class(ClassLoader *loader, u1 *bytecode, size_t len)
 
     // init constant pool
     u2 cp_count = r.readu2();
-    cp.type = new u1[cp_count];
-    cp.info = new slot_t[cp_count];
+    cp.type = new u1[cp_count]();
+    cp.info = new slot_t[cp_count]();
+    cp.count = cp_count;
 
     // constant pool 从 1 开始计数，第0位无效
     CP_TYPE(cp, 0) = CONSTANT_Invalid;
@@ -393,7 +615,7 @@ Class::Class(ClassLoader *loader, u1 *bytecode, size_t len)
             fields[lastField--] = f;
     }
 
-    calcFieldsId();
+    layoutFields();
 
     // parse methods
     u2 methodsCount = r.readu2();
@@ -412,6 +634,8 @@ Class::Class(ClassLoader *loader, u1 *bytecode, size_t len)
 
     createVtable(); // todo 接口有没有必要创建 vtable
     createItable();
+    createSuperTables();
+    createMemberTables();
 
     postInit();
 }
@@ -419,10 +643,13 @@ Class::Class(ClassLoader *loader, u1 *bytecode, size_t len)
 void Class::postInit()
 {
     if (java_lang_Class != nullptr) {
+        // 实例变量保存在 mirrorFields 中，已经清零了
+        if (java_lang_Class->instFieldsSize > (int) sizeof(mirrorFields)) {
+            jvm_abort("java/lang/Class has %d bytes of instance fields, more than VM_CLASS_MIRROR_SLOTS slots\n",
+                      java_lang_Class->instFieldsSize);
+        }
+        assert(data() == mirrorFields);
         clazz = java_lang_Class;
-        // new 空间的同时必须清零。
-        // Java 要求类的属性有初始值。
-        data = new slot_t[java_lang_Class->instFieldsCount]();
     }
 }
 
@@ -458,23 +685,42 @@ void Class::clinit()
     }
 }
 
-Field *Class::lookupField(const char *name, const char *descriptor)
+Field *Class::findField(const char *name, const char *descriptor)
 {
-    for (auto f : fields) {
-        if (utf8_equals(f->name, name) && utf8_equals(f->descriptor, descriptor))
-            return f;
-    }
-
-    // todo 在父类中查找
-    struct Field *field;
-    if (superClass != nullptr) {
-        if ((field = superClass->lookupField(name, descriptor)) != nullptr)
-            return field;
-    }
+    auto field = static_cast<Field *>(fieldTable.find(name, descriptor));
+    if (field != nullptr)
+        return field;
+
+    auto key = make_pair(name, descriptor);
+    pthread_mutex_lock(&inheritedMutex);
+    auto iter = inheritedFields.find(key);
+    bool cached = iter != inheritedFields.end();
+    if (cached)
+        field = iter->second;
+    pthread_mutex_unlock(&inheritedMutex);
+    if (cached)
+        return field;
+
+    // 在父类中查找
+    if (superClass != nullptr)
+        field = superClass->findField(name, descriptor);
+
+    // 在父接口中查找
+    for (size_t i = 0; field == nullptr && i < interfaces.size(); i++)
+        field = interfaces[i]->findField(name, descriptor);
+
+    pthread_mutex_lock(&inheritedMutex);
+    inheritedFields.emplace(key, field);
+    pthread_mutex_unlock(&inheritedMutex);
+    return field;
+}
 
-    // todo 在父接口中查找
-    for (auto c : interfaces) {
-        if ((field = c->lookupField(name, descriptor)) != nullptr)
+Field *Class::lookupField(const char *name, const char *descriptor)
+{
+    const char *n = name, *d = descriptor;
+    if (intern_member_key(n, d)) {
+        Field *field = findField(n, d);
+        if (field != nullptr)
             return field;
     }
 
@@ -505,33 +751,21 @@ Field *Class::lookupInstField(const char *name, const char *descriptor)
 
 Method *Class::getDeclaredMethod(const char *name, const char *descriptor)
 {
-    for (auto m : methods) {
-        if (utf8_equals(m->name, name) && utf8_equals(m->descriptor, descriptor))
-            return m;
-    }
-
-    return nullptr;
-
+    if (!intern_member_key(name, descriptor))
+        return nullptr;
+    return static_cast<Method *>(methodTable.find(name, descriptor));
 }
 
 Method *Class::getDeclaredStaticMethod(const char *name, const char *descriptor)
 {
-    for (auto m : methods) {
-        if (m->isStatic() && utf8_equals(m->name, name) && utf8_equals(m->descriptor, descriptor))
-            return m;
-    }
-
-    return nullptr;
+    Method *m = getDeclaredMethod(name, descriptor);
+    return m != nullptr && m->isStatic() ? m : nullptr;
 }
 
 Method *Class::getDeclaredInstMethod(const char *name, const char *descriptor)
 {
-    for (auto m : methods) {
-        if (!m->isStatic() && utf8_equals(m->name, name) && utf8_equals(m->descriptor, descriptor))
-            return m;
-    }
-
-    return nullptr;
+    Method *m = getDeclaredMethod(name, descriptor);
+    return m != nullptr && !m->isStatic() ? m : nullptr;
 }
 
 vector<Method *> Class::getDeclaredMethods(const char *name, bool public_only)
@@ -557,22 +791,42 @@ vector<Method *> Class::getConstructors(bool public_only)
     return getDeclaredMethods(S(object_init), public_only);
 }
 
-Method *Class::lookupMethod(const char *name, const char *descriptor)
+Method *Class::findMethod(const char *name, const char *descriptor)
 {
-    Method *method = getDeclaredMethod(name, descriptor);
-    if (method != nullptr) {
+    auto method = static_cast<Method *>(methodTable.find(name, descriptor));
+    if (method != nullptr)
         return method;
-    }
 
-    // todo 在父类中查找
-    if (superClass != nullptr) {
-        if ((method = superClass->lookupMethod(name, descriptor)) != nullptr)
-            return method;
-    }
+    auto key = make_pair(name, descriptor);
+    pthread_mutex_lock(&inheritedMutex);
+    auto iter = inheritedMethods.find(key);
+    bool cached = iter != inheritedMethods.end();
+    if (cached)
+        method = iter->second;
+    pthread_mutex_unlock(&inheritedMutex);
+    if (cached)
+        return method;
 
-    // todo 在父接口中查找
-    for (auto c : interfaces) {
-        if ((method = c->lookupMethod(name, descriptor)) != nullptr)
+    // 在父类中查找
+    if (superClass != nullptr)
+        method = superClass->findMethod(name, descriptor);
+
+    // 在父接口中查找
+    for (size_t i = 0; method == nullptr && i < interfaces.size(); i++)
+        method = interfaces[i]->findMethod(name, descriptor);
+
+    pthread_mutex_lock(&inheritedMutex);
+    inheritedMethods.emplace(key, method);
+    pthread_mutex_unlock(&inheritedMutex);
+    return method;
+}
+
+Method *Class::lookupMethod(const char *name, const char *descriptor)
+{
+    const char *n = name, *d = descriptor;
+    if (intern_member_key(n, d)) {
+        Method *method = findMethod(n, d);
+        if (method != nullptr)
             return method;
     }
 
@@ -600,20 +854,55 @@ Method *Class::lookupInstMethod(const char *name, const char *descriptor)
     return m;
 }
 
-bool Class::isSubclassOf(const Class *father) const
+/*
+ * 在 superClass 和 interfaces 确定之后调用
+ */
+void Class::createSuperTables()
 {
-    if (this == father)
-        return true;
+    int depth = inheritedDepth();
+    bool primary = !isInterface() && !isArray() && depth < VM_PRIMARY_SUPERS_DISPLAY;
+    superCheckDepth = primary ? depth : VM_PRIMARY_SUPERS_DISPLAY;
+
+    // 主父类沿用父类的 display，再加上本类自己
+    if (superClass != nullptr)
+        copy(superClass->superDisplay, superClass->superDisplay + VM_PRIMARY_SUPERS_DISPLAY, superDisplay);
+    if (primary)
+        superDisplay[depth] = this;
+
+    // 次父类：父类的、直接实现的接口的，以及本类自己
+    auto add = [this](const Class *c) {
+        if (find(secondarySupers.begin(), secondarySupers.end(), c) == secondarySupers.end())
+            secondarySupers.push_back(c);
+    };
+    if (!primary)
+        add(this);
+    if (superClass != nullptr) {
+        for (auto c : superClass->secondarySupers)
+            add(c);
+    }
+    for (auto interface : interfaces) {
+        if (interface == nullptr)
+            continue; // 启动时 java/lang/Cloneable 等加载之前创建的数组类
+        for (auto c : interface->secondarySupers)
+            add(c);
+    }
+}
 
-    if (superClass != nullptr && superClass->isSubclassOf(father))
-        return true;
+bool Class::isSecondarySubclassOf(const Class *father) const
+{
+    bool found = find(secondarySupers.begin(), secondarySupers.end(), father) != secondarySupers.end();
 
-    for (auto c : interfaces) {
-        if (c->isSubclassOf(father))
-            return true;
+    // 数组的协变：元素都是引用类型时，按元素类型（去掉一层 '['）判断，
+    // 比如 String[] 是 Object[] 的子类，int[][] 也是 Object[] 的子类，但 String[] 不是 Object[][] 的子类
+    if (!found && isArray() && father->isArray()) {
+        Class *c = ((ArrayClass *) this)->componentType();
+        Class *fc = ((ArrayClass *) father)->componentType();
+        found = !c->isPrimitive() && !fc->isPrimitive() && c->isSubclassOf(fc);
     }
 
-    return false;
+    if (found)
+        __atomic_store_n(&superDisplay[VM_PRIMARY_SUPERS_DISPLAY], father, __ATOMIC_RELAXED);
+    return found;
 }
 
 int Class::inheritedDepth() const
@@ -7,7 +7,9 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <cassert>
+#include <pthread.h>
 #include <cstring>
 #include "../../jtypes.h"
 #include "../../loader/ClassLoader.h"
@@ -17,14 +19,25 @@
 #include "../../loader/bootstrap_class_loader.h"
 #include "ConstantPool.h"
 #include "../heap/Object.h"
+#include "../../config.h"
 
 class Field;
 class Method;
+struct Member;
 class BytecodeReader;
 class ArrayClass;
 
+/*
+ * 类对象的对象头和 java/lang/Class 的实例变量。
+ * 类对象不在 Java 堆中，但和普通对象一样，实例变量紧跟在对象头之后（Object::data），
+ * 所以作为 Class 的第一个基类。
+ */
+struct ClassMirror: public Object {
+    slot_t mirrorFields[VM_CLASS_MIRROR_SLOTS] = { };
+};
+
 // java/lang/Class
-struct Class: public Object, public Access {
+struct Class: public ClassMirror, public Access {
     ConstantPool cp;
 
     // Object of java/lang/Class of this class
@@ -36,7 +49,13 @@ struct Class: public Object, public Access {
     // 必须是全限定类名
     const char *className;
 
-    int objectSize;
+    /*
+     * 对象的大小由类决定（见 Object::size）：
+     * 非数组类的实例为 instanceSize（对象头加上所有的实例变量），
+     * 数组为 instanceSize（数组的对象头）加上 eleSize * 数组长度。
+     */
+    size_t instanceSize = 0;
+    size_t eleSize = 0; // 数组元素的大小，非数组类为 0
 
     // 如果类没有<clinit>方法，是不是inited直接职位true  todo
     bool inited = false; // 此类是否被初始化过了（是否调用了<clinit>方法）。
@@ -98,25 +117,88 @@ struct Class: public Object, public Access {
     std::vector<Field *> fields;
     u2 publicFieldsCount = 0;
 
-    // instFieldsCount 有可能大于 fieldsCount，因为 instFieldsCount 包含了继承过来的 field.
-    // 类型二统计为两个数量
-    int instFieldsCount = 0;
+    // 所有实例变量（包括继承来的）占用的字节数，即最后一个实例变量的末尾相对于 Object::data() 的偏移
+    int instFieldsSize = 0;
+
+    // 布局实例变量时留下的对齐空隙（偏移，字节数），子类的实例变量优先填入其中
+    std::vector<std::pair<int, int>> fieldGaps;
+
+    // 所有引用类型的实例变量的偏移（包括继承来的），GC 时用来遍历对象引用的其他对象
+    std::vector<int> refFieldOffsets;
 
     // vtable 只保存虚方法。
     // 该类所有函数自有函数（除了private, static, final, abstract）和 父类的函数虚拟表。
     std::vector<Method *> vtable;
 
+    /*
+     * 接口方法表。
+     * 接口的每个实例方法有一个接口内的编号（Method::itableIndex）；
+     * 类的 itable 包含它实现的所有接口（包括父类和父接口实现的），
+     * 每个接口的方法的实现按编号连续存放在 methods 中，起始位置记在 interfaces 中。
+     * 没有实现的方法存放接口中的抽象方法本身，调用时抛出 AbstractMethodError.
+     */
     struct ITable {
         std::vector<std::pair<Class *, size_t /* offset */>> interfaces;
         std::vector<Method *> methods;
 
-        ITable() = default;
-        ITable(const ITable &itable);
-        ITable& operator=(const ITable &itable);
+        /*
+         * 实现的接口超过 VM_ITABLE_HASH_THRESHOLD 个时，
+         * 建立以接口方法（selector）为键的开放地址哈希表，查找时不必线性的搜索 interfaces.
+         * 大小为 2 的幂，空位的键为 nullptr.
+         */
+        std::vector<std::pair<const Method *, Method *>> hashed;
+
+        /*
+         * 接口方法有多个最具体的 default 方法时，methods 中存放此标记，调用时抛出 IncompatibleClassChangeError.
+         * 标记不是真正的方法，不能访问它的成员。
+         */
+        static Method *const CONFLICT;
+
+        /*
+         * 查找接口方法 @selector 的实现，
+         * 没有实现 @selector 所属的接口时返回 nullptr.
+         */
+        Method *lookup(const Method *selector) const;
+
+        void buildHash();
     };
 
     ITable itable;
 
+    /*
+     * 子类型检查（isSubclassOf）用的表，在 createSuperTables 中创建。
+     *
+     * 不是接口和数组、继承深度小于 VM_PRIMARY_SUPERS_DISPLAY 的类是主父类（primary super），
+     * superDisplay[d] 是本类继承深度为 d 的主父类祖先（包括本类自己），没有的位置为 nullptr，
+     * 判断本类是否是主父类 T 的子类只需比较 superDisplay[T 的深度] == T.
+     *
+     * 其他的类（接口、数组、继承太深的类）是次父类（secondary super），本类所有的次父类（包括本类自己）
+     * 存放在 secondarySupers 中，线性查找，最近一次查找成功的缓存在 superDisplay[VM_PRIMARY_SUPERS_DISPLAY] 中。
+     * superCheckDepth 是本类作为父类时在 superDisplay 中比较的位置，
+     * 所以不论主父类还是次父类，常见的检查都是一次读取和比较。
+     */
+    mutable const Class *superDisplay[VM_PRIMARY_SUPERS_DISPLAY + 1] = { };
+    int superCheckDepth = VM_PRIMARY_SUPERS_DISPLAY;
+    std::vector<const Class *> secondarySupers;
+
+    /*
+     * 本类定义的成员（methods, fields）以（名称，描述符）为键的开放地址哈希表，在 createMemberTables 中创建。
+     * 成员的名称和描述符都来自常量池，已经驻留（save_utf8），所以键就是两个指针，比较时不需要 strcmp.
+     * 大小为 2 的幂，装载因子不超过 1/2，空位为 nullptr.
+     */
+    struct MemberTable {
+        std::vector<Member *> slots;
+
+        template <typename T>
+        void build(const std::vector<T *> &members);
+
+        // @name 和 @descriptor 必须是驻留的字符串，没有时返回 nullptr
+        Member *find(const char *name, const char *descriptor) const;
+    };
+
+    MemberTable methodTable;
+    MemberTable fieldTable;
+
 //    struct bootstrap_methods_attribute *bootstrap_methods_attribute;
 
     struct {
@@ -132,8 +214,24 @@ struct Class: public Object, public Access {
     std::vector<BootstrapMethod> bootstrapMethods;
 
 private:
-    // 计算字段的个数，同时给它们编号
-    void calcFieldsId();
+    struct MemberKeyHash {
+        size_t operator()(const std::pair<const char *, const char *> &key) const;
+    };
+
+    /*
+     * lookupField, lookupMethod 在父类和接口中查找的结果，包括没有找到的（值为 nullptr），键是驻留的（名称，描述符）。
+     * 类创建后成员和继承关系都不再改变，缓存不需要失效。
+     */
+    std::unordered_map<std::pair<const char *, const char *>, Field *, MemberKeyHash> inheritedFields;
+    std::unordered_map<std::pair<const char *, const char *>, Method *, MemberKeyHash> inheritedMethods;
+    pthread_mutex_t inheritedMutex = PTHREAD_MUTEX_INITIALIZER;
+
+    // 不抛出异常的 lookupField, lookupMethod，@name 和 @descriptor 是驻留的字符串，没有找到时返回 nullptr
+    Field *findField(const char *name, const char *descriptor);
+    Method *findMethod(const char *name, const char *descriptor);
+
+    // 计算实例变量的偏移和实例的大小
+    void layoutFields();
     void parseAttribute(BytecodeReader &r);
 
     // 根据类名生成包名
@@ -141,10 +239,17 @@ private:
 
 protected:
     Class(ClassLoader *loader, const char *className)
-            : className(className), loader(loader) { }
+            : className(className), loader(loader)
+    {
+        pthread_mutex_lock(&g_all_classes_mutex);
+        g_all_classes.push_back(this);
+        pthread_mutex_unlock(&g_all_classes_mutex);
+    }
 
     void createVtable();
     void createItable();
+    void createSuperTables();
+    void createMemberTables();
 
 public:
     Class(ClassLoader *loader, u1 *bytecode, size_t len);
@@ -187,7 +292,23 @@ public:
     std::vector<Method *> getConstructors(bool public_only);
 
     bool isAccessibleTo(const Class *visitor) const;
-    bool isSubclassOf(const Class *father) const;
+
+    // 本类是否是 @father 的子类（包括本类自己、实现的接口和数组的协变）
+    bool isSubclassOf(const Class *father) const
+    {
+        const Class *c = __atomic_load_n(&superDisplay[father->superCheckDepth], __ATOMIC_RELAXED);
+        if (c == father)
+            return true;
+        if (father->superCheckDepth < VM_PRIMARY_SUPERS_DISPLAY)
+            return false; // 主父类只可能在 display 中的这个位置
+        return isSecondarySubclassOf(father);
+    }
+
+private:
+    // 查找 secondarySupers，成功时更新缓存
+    bool isSecondarySubclassOf(const Class *father) const;
+
+public:
 
     bool isArray() const;
     bool isPrimitive() const
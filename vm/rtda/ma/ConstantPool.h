@@ -9,8 +9,9 @@
 #include "../../util/BytecodeReader.h"
 
 struct ConstantPool {
-    u1 *type;
-    slot_t *info;
+    u1 *type = nullptr;
+    slot_t *info = nullptr;
+    u2 count = 0;
 };
 
 // Macros for accessing constant pool entries
@@ -76,6 +76,26 @@ Class *Field::getType()
     return type;
 }
 
+size_t Field::width() const
+{
+    switch (descriptor[0]) {
+        case 'Z':
+        case 'B':
+            return sizeof(jbyte);
+        case 'C':
+        case 'S':
+            return sizeof(jshort);
+        case 'I':
+        case 'F':
+            return sizeof(jint);
+        case 'J':
+        case 'D':
+            return sizeof(jlong);
+        default: // 'L' or '['
+            return sizeof(jref);
+    }
+}
+
 string Field::toString() const
 {
     ostringstream oss;
@@ -34,7 +34,8 @@ public:
             slot_t data[2] = { 0, 0 };
         } staticValue;
 
-        int id = 0;
+        // 实例变量相对于 Object::data() 的字节偏移，见 Class::layoutFields
+        int offset = 0;
     };
 
     // 如果field的值已经在常量池中了，@constant_value_index 表示值在常量池中的索引。
@@ -51,6 +52,9 @@ public:
 public:
     Field(Class *c, BytecodeReader &r);
     Class *getType();
+
+    // 实例变量在对象中占用的字节数：Z/B 1, C/S 2, I/F 4, J/D 8, 引用 sizeof(jref)
+    size_t width() const;
     std::string toString() const;
 };
 
@@ -3,7 +3,10 @@
  */
 
 #include <sstream>
+#include <algorithm>
 #include "Method.h"
+#include "Class.h"
+#include "../../kayo.h"
 #include "../heap/Object.h"
 #include "../heap/ArrayObject.h"
 #include "../../symbol.h"
@@ -186,6 +189,34 @@ void Method::calArgsSlotsCount()
     }
 }
 
+/*
+ * 给每个 invokevirtual 和 invokeinterface 调用点分配一个内联缓存，
+ * 并把调用指令的操作数由常量池下标改写为缓存的下标，见 InlineCache.
+ */
+void Method::createInlineCaches()
+{
+    assert(inlineCaches == nullptr);
+
+    for (size_t pc = 0; pc < codeLen; pc += bytecode_length(code, pc)) {
+        if (code[pc] == OPC_INVOKEVIRTUAL || code[pc] == OPC_INVOKEINTERFACE)
+            inlineCachesCount++;
+    }
+    if (inlineCachesCount == 0)
+        return;
+
+    inlineCaches = new InlineCache[inlineCachesCount];
+    u2 i = 0;
+    for (size_t pc = 0; pc < codeLen; pc += bytecode_length(code, pc)) {
+        if (code[pc] == OPC_INVOKEVIRTUAL || code[pc] == OPC_INVOKEINTERFACE) {
+            inlineCaches[i].pc = (u2) pc;
+            inlineCaches[i].cpIndex = (u2) (code[pc + 1] << 8 | code[pc + 2]);
+            code[pc + 1] = (u1) (i >> 8);
+            code[pc + 2] = (u1) i;
+            i++;
+        }
+    }
+}
+
 /*
  * 解析方法的 code 属性
  */
@@ -194,8 +225,10 @@ void Method::parseCodeAttr(BytecodeReader &r)
     maxStack = r.readu2();
     maxLocals = r.readu2();
     codeLen = r.readu4();
-    code = r.currPos();
-    r.skip(codeLen);
+    // 调用指令的操作数会被改写为内联缓存的下标，所以拷贝一份，不直接指向 class 文件
+    code = new u1[codeLen];
+    r.readBytes(code, codeLen);
+    createInlineCaches();
 
     // parse exception tables
     int exception_tables_count = r.readu2();
@@ -417,4 +450,36 @@ string Method::toString() const
         oss << "(native)";
     oss << ": "  << clazz->className << "~" << name << "~" << descriptor;
     return oss.str();
-}
\ No newline at end of file
+}
+
+vector<Method *> hottest_methods(size_t n)
+{
+    vector<Method *> methods;
+    pthread_mutex_lock(&g_all_classes_mutex);
+    for (Class *c : g_all_classes) {
+        for (Method *m : c->methods) {
+            if (m->hotness() > 0)
+                methods.push_back(m);
+        }
+    }
+    pthread_mutex_unlock(&g_all_classes_mutex);
+
+    n = min(n, methods.size());
+    partial_sort(methods.begin(), methods.begin() + n, methods.end(),
+                 [](const Method *a, const Method *b) { return a->hotness() > b->hotness(); });
+    methods.resize(n);
+    return methods;
+}
+
+void print_hot_methods()
+{
+    static const char *states[] = { "interpreted", "compiled", "not compilable" };
+
+    printf("Hot methods:\n");
+    printf("  %12s %12s  %-14s method\n", "invocations", "backedges", "state");
+    for (Method *m : hottest_methods(VM_PRINT_HOT_METHODS_TOP)) {
+        printf("  %12llu %12llu  %-14s %s.%s%s\n",
+               (unsigned long long) m->invocationCount, (unsigned long long) m->backedgeCount,
+               m->isNative() ? "native" : states[m->jitState], m->clazz->className, m->name, m->descriptor);
+    }
+}
@@ -13,6 +13,9 @@
 #include "../../native/registry.h"
 #include "../../utf8.h"
 #include "../../symbol.h"
+#include "../../interpreter/InlineCache.h"
+#include "../../interpreter/ThreadedCode.h"
+#include "../../jit/jit.h"
 
 
 class ArrayObject;
@@ -22,6 +25,9 @@ class Method: public Member {
     Class *returnType = nullptr;     // java/lang/Class
     ArrayObject *exceptionTypes = nullptr; // [Ljava/lang/Class;
 
+    // parameterTypes and exceptionTypes 是 GC Roots，GC 移动了它们之后需要更新
+    friend void gc_visit_method(Method *m, void (*visit)(Object **ref));
+
 public:
     int vtableIndex = -1;
     int itableIndex = -1;
@@ -35,6 +41,36 @@ public:
     u1 *code = nullptr;
     size_t codeLen = 0;
 
+    // invokevirtual 和 invokeinterface 调用点的内联缓存，调用指令的操作数是缓存的下标
+    InlineCache *inlineCaches = nullptr;
+    u2 inlineCachesCount = 0;
+
+    // 第一次执行时由 code 翻译而来，见 ThreadedCode
+    ThreadedCode *threadedCode = nullptr;
+
+    /*
+     * 方法的调用次数和向后跳转（循环）的次数，解释执行和编译后的代码都计数，只增不减。
+     * 多线程时不加锁，是近似值。分层、快速化、JIT 等都以此为触发条件（见 hotness），
+     * 不要另外计数。-XX:+PrintHotMethods 在虚拟机退出时打印最热的方法。
+     */
+    u8 invocationCount = 0;
+    u8 backedgeCount = 0;
+
+    // -XX:+ProfileOpcodes 时此方法中每种指令的执行次数，按操作码索引，第一次执行时分配，见 OpcodeProfile.h
+    u8 *opcodeCounts = nullptr;
+
+    // 上次（重新）开始为 JIT 计数时的 hotness()，达到 jitCountBase + VM_JIT_THRESHOLD 后编译，见 jit.h
+    u8 jitCountBase = 0;
+
+    // 编译后的代码的入口，没有编译时为 nullptr
+    JitEntry jitEntry = nullptr;
+    // 线索码的每个单元在编译后的代码中的位置（相对于 jitEntry），按单元索引，
+    // 这条指令没有编译时为 JIT_NOT_RESUMABLE，在发布 jitEntry 之前写好，见 jit_resume_point
+    u4 *jitResumeOffsets = nullptr;
+    JitState jitState = JIT_INTERPRETED;
+    // 上次回收代码缓存以来是否执行过编译后的代码，见 jit_sweep_code_cache
+    bool jitUsed = false;
+
     native_method_t nativeMethod = nullptr; // present only if native
 #if 0
     // 此方法可能会抛出的受检异常
@@ -57,6 +93,7 @@ public:
 private:
     void calArgsSlotsCount();
     void parseCodeAttr(BytecodeReader &r);
+    void createInlineCaches();
 
 public:
     Method(Class *c, BytecodeReader &r);
@@ -111,11 +148,33 @@ private:
     std::vector<ExceptionTable> exceptionTables;
 
 public:
+    // 方法的热度：调用次数和向后跳转的次数之和
+    u8 hotness() const
+    {
+        return invocationCount + backedgeCount;
+    }
+
     ~Method()
     {
+        delete[] code;
+        delete[] inlineCaches;
+        delete threadedCode;
+        delete[] opcodeCounts;
+        if (jitEntry != nullptr)
+            jit_release(this);
         for (auto &t : exceptionTables)
             delete t.catchType;
     }
 };
 
+/*
+ * 按热度（Method::hotness）从高到低返回所有已加载的类中最热的 @n 个方法，不包括从未执行过的方法
+ */
+std::vector<Method *> hottest_methods(size_t n);
+
+/*
+ * 打印最热的 VM_PRINT_HOT_METHODS_TOP 个方法（-XX:+PrintHotMethods）
+ */
+void print_hot_methods();
+
 #endif //JVM_JMETHOD_H
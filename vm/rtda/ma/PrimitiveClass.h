@@ -19,6 +19,7 @@ public:
         superClass = java_lang_Object;
 
         createVtable();
+        createSuperTables();
 
         postInit();
     }
@@ -9,7 +9,7 @@
 using namespace std;
 
 Frame::Frame(Method *m, bool vm_invoke, Frame *prev)
-        : method(m), reader(m->code, m->codeLen), vm_invoke(vm_invoke), prev(prev)
+        : method(m), vm_invoke(vm_invoke), prev(prev)
 {
     locals = reinterpret_cast<slot_t *>(this + 1);
     stack = locals + m->maxLocals;
@@ -27,6 +27,14 @@ bool Frame::objectAccessible(jref obj)
     return false;
 }
 
+size_t Frame::pc() const
+{
+    // ip 指向下一个单元，前一个单元属于正在执行的指令
+    if (ip == nullptr || ip == method->threadedCode->cells)
+        return 0;
+    return method->threadedCode->pcOf(ip - 1);
+}
+
 size_t Frame::size(const Method *m)
 {
     return sizeof(Frame) + (m->maxStack*sizeof(slot_t)) + (m->maxLocals*sizeof(slot_t));
@@ -39,6 +47,6 @@ string Frame::toString()
     if (method->isNative())
         oss << "(native)";
     oss << method->clazz->className << "~" << method->name << "~" << method->descriptor;
-    oss << ", pc = " << reader.pc;
+    oss << ", pc = " << pc();
     return oss.str();
 }
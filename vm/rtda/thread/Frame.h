@@ -11,7 +11,12 @@
 
 struct Frame {
     Method *method;
-    BytecodeReader reader;
+
+    /*
+     * 线索码中下一个要执行的单元（见 ThreadedCode），开始执行此 frame 时设置。
+     * 执行中的位置保存在解释器的局部变量中，调用其他方法或者执行可能调用 Java 代码的慢速路径之前才写回。
+     */
+    Cell *ip = nullptr;
 
     /*
      * this frame 执行的函数是否由虚拟机调用
@@ -79,6 +84,9 @@ struct Frame {
 
     bool objectAccessible(jref obj);
 
+    // 正在执行的指令在字节码中的 pc，用于查找异常处理表和行号表
+    size_t pc() const;
+
     static size_t size(const Method *m);
     std::string toString();
 };
@@ -13,6 +13,7 @@
 #include "../../kayo.h"
 #include "../ma/Class.h"
 #include "../ma/Field.h"
+#include "../../heapmgr/gc.h"
 
 #if TRACE_THREAD
 #define TRACE PRINT_TRACE
@@ -22,9 +23,20 @@
 
 // Thread specific key holding a Thread
 static pthread_key_t thread_key;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
 
+static void create_thread_key()
+{
+    pthread_key_create(&thread_key, nullptr);
+}
+
+/*
+ * 在主线程创建之前也可能调用此函数（比如加载类时分配对象），
+ * 所以要保证 thread_key 此时已经创建了，此时返回 nullptr.
+ */
 Thread *thread_self()
 {
+    pthread_once(&thread_key_once, create_thread_key);
     return (Thread *) pthread_getspecific(thread_key);
 }
 
@@ -36,14 +48,13 @@ static inline void set_thread_self(Thread *thread)
 static Field *eetopField;
 static Method *runMethod;
 
-Thread *initMainThread()
+Thread *initMainThread(void *cstackBase)
 {
-    pthread_key_create(&thread_key, nullptr);
-
     eetopField = java_lang_Thread->lookupInstField("eetop", S(J));
     runMethod = java_lang_Thread->lookupInstMethod(S(run), S(___V));
 
     auto mainThread = new Thread(pthread_self());
+    mainThread->cstackBase = cstackBase;
 
     java_lang_Thread->clinit();
 
@@ -81,9 +92,13 @@ static Thread *createThread(void *(*start)(void *), void *args)
         raiseException(INTERNAL_ERROR, "create Thread failed");
     }
 
-    while (newThread == nullptr) { // 等待子线程设置 newThread 的值。
-        pthread_cond_wait(&innerCond, &innerMutex);
-    }
+    // 等待子线程设置 newThread 的值。
+    // 子线程创建 Thread 时会分配对象，可能触发 GC，所以等待期间不能阻止 GC
+    gc_do_blocking([](void *) {
+        while (newThread == nullptr) {
+            pthread_cond_wait(&innerCond, &innerMutex);
+        }
+    }, nullptr);
     newThread->pid = pid;
     pthread_mutex_unlock(&innerMutex);
     pthread_mutex_unlock(&mutex);
@@ -97,6 +112,7 @@ Thread *createVMThread(void *(*start)(void *))
     return createThread([](void *args) {
         pthread_mutex_lock(&innerMutex);
         newThread = new Thread();
+        newThread->cstackBase = __builtin_frame_address(0);
         pthread_mutex_unlock(&innerMutex);
         pthread_cond_signal(&innerCond);
 
@@ -111,11 +127,14 @@ Thread *createCustomerThread(Object *jThread)
     return createThread([](void *args) {
         pthread_mutex_lock(&innerMutex);
         auto __jThread = (jref) args;
-        newThread = new Thread(__jThread);
+        Thread *self = newThread = new Thread(__jThread);
+        self->cstackBase = __builtin_frame_address(0);
         pthread_mutex_unlock(&innerMutex);
         pthread_cond_signal(&innerCond);
 
-        return (void *) execJavaFunc(runMethod, __jThread);
+        execJavaFunc(runMethod, __jThread);
+        gc_unregister_thread(self);
+        return (void *) nullptr;
     }, jThread);
 }
 
@@ -129,7 +148,7 @@ Thread::Thread(Object *jThread0, jint priority): jThread(jThread0)
     assert(MIN_PRIORITY <= priority && priority <= MAX_PRIORITY);
 
     set_thread_self(this);
-    g_all_threads.push_back(this);
+    gc_register_thread(this);
 
     if (jThread == nullptr)
         jThread = Object::newInst(java_lang_Thread);
@@ -150,8 +169,9 @@ void Thread::bind(Object *jThread0)
 Thread *Thread::from(Object *jThread0)
 {
     assert(jThread0 != nullptr);
-    assert(0 <= eetopField->id && eetopField->id < jThread0->clazz->instFieldsCount);
-    return *(Thread **)(jThread0->data + eetopField->id);//jThread0->getInstFieldValue<Thread *>(eetopField);
+    assert(0 <= eetopField->offset && eetopField->offset < jThread0->clazz->instFieldsSize);
+    // eetop 是 long 类型的变量，Thread::bind 中把指针作为 jlong 写入
+    return (Thread *) (intptr_t) *(jlong *) jThread0->fieldAddress(eetopField);
 }
 
 void Thread::setThreadGroupAndName(Object *threadGroup, const char *threadName)
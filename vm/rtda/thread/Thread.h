@@ -5,9 +5,11 @@
 #ifndef JVM_JTHREAD_H
 #define JVM_JTHREAD_H
 
+#include <vector>
 #include <pthread.h>
 #include "../../config.h"
 #include "../../jtypes.h"
+#include "../../heapmgr/TLAB.h"
 
 class Object;
 class ClassLoader;
@@ -97,6 +99,16 @@ public:
     u1 vmStack[VM_STACK_SIZE]; // 虚拟机栈，一个线程只有一个虚拟机栈
     Frame *topFrame = nullptr;
 
+    TLAB tlab;
+
+    // 以下用于 GC 的 stop-the-world，在 GC 的锁内访问
+    bool atSafepoint = false;   // 线程停在了 safepoint，或者处于不访问 Java 堆的阻塞区域
+    void *cstackBase = nullptr; // C 栈的底（高地址），为 nullptr 时 GC 不扫描此线程的 C 栈
+    void *cstackTop = nullptr;  // 线程暂停时 C 栈的栈顶，GC 保守的扫描 [cstackTop, cstackBase)
+
+    // 并发标记期间被此线程覆盖掉的老年代对象的引用（SATB 写屏障），只有此线程写入，GC 在暂停时取走
+    std::vector<Object *> satbBuffer;
+
     explicit Thread(pthread_t pid, Object *jThread = nullptr, jint priority = NORM_PRIORITY);
     explicit Thread(Object *jThread = nullptr, jint priority = NORM_PRIORITY);
 
@@ -105,7 +117,10 @@ public:
     bool isAlive();
 };
 
-Thread *initMainThread();
+/*
+ * @cstackBase: 主线程 C 栈的底，比所有会引用 Java 对象的 C 栈桢都高即可
+ */
+Thread *initMainThread(void *cstackBase);
 Thread *createVMThread(void *(*start)(void *));
 Thread *createCustomerThread(Object *jThread);
 
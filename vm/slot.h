@@ -37,10 +37,17 @@ struct Slot {//jbyte jbool  jchar  jshort  jint jlong jfloat jdouble jref
 };
 #endif
 
-// 一个slot_t类型必须可以容纳jbool, jbyte, jchar, jshort，jint，jfloat, jref称为类型一
-// jlong, jdouble 称为类型二，占两个slot
+/*
+ * 一个slot_t类型必须可以容纳jbool, jbyte, jchar, jshort，jint，jfloat, jref称为类型一
+ * jlong, jdouble 称为类型二，在局部变量表和操作数栈中占两个slot（class 文件中的局部变量下标和 max_stack 按此计算），
+ * 值总是从第一个 slot 开始存放（见 LSLOT, DSLOT）：
+ * 32 位虚拟机中值跨越两个 slot；64 位虚拟机中值完整的保存在第一个 slot 中，第二个 slot 只占位，不读也不写。
+ */
 typedef intptr_t slot_t;
 
+// 一个 slot 是否可以容纳 jlong 和 jdouble
+#define SLOT_HOLDS_CATEGORY_TWO (sizeof(slot_t) >= sizeof(jlong))
+
 #define ISLOT(slot_point) (* (jint *) (slot_point))
 #define FSLOT(slot_point) (* (jfloat *) (slot_point))
 #define LSLOT(slot_point) (* (jlong *) (slot_point))
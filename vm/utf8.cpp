@@ -5,25 +5,33 @@
 #include <cstring>
 #include <cassert>
 #include <unordered_set>
+#include <pthread.h>
 #include "utf8.h"
 
 using namespace std;
 
 static unordered_set<const char *, Utf8Hash, Utf8Comparator> utf8Set;
 
+// 加载类的线程插入字符串的同时，其他线程在查找类的成员时查找字符串，查找远多于插入，用读写锁
+static pthread_rwlock_t utf8SetLock = PTHREAD_RWLOCK_INITIALIZER;
+
 const char *save_utf8(const char *utf8)
 {
     assert(utf8 != nullptr);
-    return *utf8Set.insert(utf8).first;
+    pthread_rwlock_wrlock(&utf8SetLock);
+    const char *saved = *utf8Set.insert(utf8).first;
+    pthread_rwlock_unlock(&utf8SetLock);
+    return saved;
 }
 
 const char *find_saved_utf8(const char *utf8)
 {
     assert(utf8 != nullptr);
+    pthread_rwlock_rdlock(&utf8SetLock);
     auto iter = utf8Set.find(utf8);
-    if (iter == utf8Set.end())
-        return nullptr;
-    return *iter;
+    const char *saved = iter == utf8Set.end() ? nullptr : *iter;
+    pthread_rwlock_unlock(&utf8SetLock);
+    return saved;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
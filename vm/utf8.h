@@ -11,6 +11,7 @@
 /*
  * save a utf8 string.
  * @utf8 必须是可持久存在的，不能是临时变量等等。
+ * 两个函数都可以在多个线程中同时调用。
  */
 const char *save_utf8(const char *utf8);
 const char *find_saved_utf8(const char *utf8);